@@ -0,0 +1,195 @@
+#include <benchmark/benchmark.h>
+#include "../src/core/bitset_filter.h"
+#include "../src/core/roaring_filter.h"
+#include "../src/core/workload.h"
+#include <thread>
+
+// Filtered HNSW search from many threads against one index and one filter.
+// Each query gets its own predicate from makeQuery, so nothing is shared
+// mutably; items_per_second is the aggregate QPS and should scale with threads.
+// The Batch benchmarks hand whole batches to searchKnnBatch instead, which
+// spreads them over its own worker threads. Points and queries come from a
+// filtering::Workload, with queries of every locality.
+
+const size_t NUM_QUERIES = 1000;
+const size_t K = 10;
+
+filtering::WorkloadOptions workloadOptions() {
+    filtering::WorkloadOptions options;
+    options.dim = 32;
+    options.num_points = 20000;
+    options.num_attributes = 100;
+    options.attributes_per_point = 10;
+    return options;
+}
+
+struct SharedIndex {
+    filtering::Workload workload{workloadOptions()};
+    hnswlib::L2Space space{workload.dim()};
+    hnswlib::HierarchicalNSW<float> index{&space, workload.size()};
+    filtering::BitsetFilter bitset_filter;
+    filtering::RoaringFilter roaring_filter;
+    std::vector<std::vector<float>> queries;
+    std::vector<std::vector<unsigned int>> query_attributes;
+
+    SharedIndex() {
+        for (size_t i = 0; i < workload.size(); i++) {
+            index.addPoint(workload.vector(i), i);
+        }
+        bitset_filter.addPoints(workload.attributeBatch());
+        roaring_filter.addPoints(workload.attributeBatch());
+        bitset_filter.alignWith(index);
+        roaring_filter.alignWith(index);
+
+        // One attribute per query, the three localities in equal parts
+        std::vector<filtering::QueryClass> mix(3);
+        mix[0].locality = filtering::QueryLocality::Correlated;
+        mix[1].locality = filtering::QueryLocality::Uncorrelated;
+        mix[2].locality = filtering::QueryLocality::AntiCorrelated;
+        for (auto& query : workload.generateQueries(mix, NUM_QUERIES)) {
+            queries.push_back(std::move(query.vector));
+            query_attributes.push_back(std::move(query.attributes));
+        }
+    }
+};
+
+// Built once, on first use, and only read afterwards, except by the
+// single-threaded VisitedSetSearch which switches the visited set
+static SharedIndex& mutableSharedIndex() {
+    static SharedIndex shared;
+    return shared;
+}
+
+static const SharedIndex& sharedIndex() {
+    return mutableSharedIndex();
+}
+
+template <typename Filter, typename Query>
+static void runConcurrentSearch(benchmark::State& state, const Filter& filter) {
+    const SharedIndex& shared = sharedIndex();
+    size_t q = state.thread_index();
+
+    for (auto _ : state) {
+        Query query = filter.makeQuery(shared.query_attributes[q % NUM_QUERIES]);
+        filtering::InternalIdFilter<Query> internal_filter(query, shared.index);
+        benchmark::DoNotOptimize(shared.index.searchKnn(shared.queries[q % NUM_QUERIES].data(), K, &internal_filter));
+        q += state.threads();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_ConcurrentBitsetSearch(benchmark::State& state) {
+    runConcurrentSearch<filtering::BitsetFilter, filtering::BitsetQuery>(state, sharedIndex().bitset_filter);
+}
+
+static void BM_ConcurrentRoaringSearch(benchmark::State& state) {
+    runConcurrentSearch<filtering::RoaringFilter, filtering::RoaringQuery>(state, sharedIndex().roaring_filter);
+}
+
+static void BM_ConcurrentUnfilteredSearch(benchmark::State& state) {
+    const SharedIndex& shared = sharedIndex();
+    size_t q = state.thread_index();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(shared.index.searchKnn(shared.queries[q % NUM_QUERIES].data(), K));
+        q += state.threads();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Args: VisitedSetMode, ef. Unfiltered, where a small ef touches a sliver of
+// the dense visited array
+static void BM_VisitedSetSearch(benchmark::State& state) {
+    SharedIndex& shared = mutableSharedIndex();
+    shared.index.setVisitedSetMode(static_cast<hnswlib::VisitedSetMode>(state.range(0)));
+    shared.index.setEf(state.range(1));
+    size_t q = 0;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(shared.index.searchKnn(shared.queries[q % NUM_QUERIES].data(), K));
+        q++;
+    }
+
+    shared.index.setVisitedSetMode(hnswlib::VisitedSetMode::Auto);
+    shared.index.setEf(10);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Args: batch size, worker threads
+static void BM_BatchUnfilteredSearch(benchmark::State& state) {
+    const SharedIndex& shared = sharedIndex();
+    const size_t batch_size = state.range(0);
+    std::vector<const void*> batch;
+    size_t q = 0;
+
+    for (auto _ : state) {
+        batch.clear();
+        for (size_t i = 0; i < batch_size; i++, q++) batch.push_back(shared.queries[q % NUM_QUERIES].data());
+        benchmark::DoNotOptimize(shared.index.searchKnnBatch(batch, K, {}, state.range(1)));
+    }
+
+    state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+static void BM_BatchRoaringSearch(benchmark::State& state) {
+    const SharedIndex& shared = sharedIndex();
+    const size_t batch_size = state.range(0);
+    std::vector<const void*> batch;
+    std::vector<filtering::RoaringQuery> queries;
+    std::vector<filtering::InternalIdFilter<filtering::RoaringQuery>> filters;
+    std::vector<filtering::InternalIdFilter<filtering::RoaringQuery>*> filter_ptrs;
+    size_t q = 0;
+
+    for (auto _ : state) {
+        batch.clear();
+        queries.clear();
+        filters.clear();
+        filter_ptrs.clear();
+        for (size_t i = 0; i < batch_size; i++, q++) {
+            batch.push_back(shared.queries[q % NUM_QUERIES].data());
+            queries.push_back(shared.roaring_filter.makeQuery(shared.query_attributes[q % NUM_QUERIES]));
+        }
+        filters.reserve(batch_size);
+        for (auto& query : queries) {
+            filters.emplace_back(query, shared.index);
+            filter_ptrs.push_back(&filters.back());
+        }
+        benchmark::DoNotOptimize(shared.index.searchKnnBatch(batch, K, filter_ptrs, state.range(1)));
+    }
+
+    state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+void RegisterBenchmarks() {
+    const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    benchmark::RegisterBenchmark("ConcurrentUnfilteredSearch", BM_ConcurrentUnfilteredSearch)
+        ->ThreadRange(1, max_threads)
+        ->UseRealTime();
+    benchmark::RegisterBenchmark("ConcurrentBitsetSearch", BM_ConcurrentBitsetSearch)
+        ->ThreadRange(1, max_threads)
+        ->UseRealTime();
+    benchmark::RegisterBenchmark("ConcurrentRoaringSearch", BM_ConcurrentRoaringSearch)
+        ->ThreadRange(1, max_threads)
+        ->UseRealTime();
+    auto* visited_set = benchmark::RegisterBenchmark("VisitedSetSearch", BM_VisitedSetSearch);
+    for (auto mode : {hnswlib::VisitedSetMode::Dense, hnswlib::VisitedSetMode::Compact}) {
+        for (int ef : {10, 50, 200}) visited_set->Args({static_cast<int>(mode), ef});
+    }
+    auto* batch_unfiltered = benchmark::RegisterBenchmark("BatchUnfilteredSearch", BM_BatchUnfilteredSearch);
+    auto* batch_roaring = benchmark::RegisterBenchmark("BatchRoaringSearch", BM_BatchRoaringSearch);
+    for (auto* batch : {batch_unfiltered, batch_roaring}) {
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            batch->Args({64, threads})->Args({256, threads});
+        }
+        batch->UseRealTime();
+    }
+}
+
+int main(int argc, char** argv) {
+    RegisterBenchmarks();
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include <benchmark/benchmark.h>
+#include "../src/core/datasets.h"
+#include "../src/core/index_builder.h"
+#include "../src/core/roaring_filter.h"
+#include "../src/core/workload.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+// Index construction and filtered search on dataset files, loaded through
+// the memory-mapped readers in datasets.h and streamed into
+// ParallelIndexBuilder batch by batch. Flags, after the benchmark ones:
+//   --base=PATH              base vectors (.fvecs, .bvecs, .ivecs, .fbin, .u8bin, .ibin)
+//   --queries=PATH           query vectors, same formats
+//   --ground_truth=PATH      .ivecs or .ibin k-NN labels per query (first K used)
+//   --base_attributes=PATH   .spmat attributes of the base points
+//   --query_attributes=PATH  .spmat attributes each query requires (an empty
+//                            row searches unfiltered)
+//   --max_queries=N          queries to run (default 1000)
+// Without --base, a synthetic workload is written to the temp directory and
+// used instead. Without --ground_truth, it is computed by an
+// exact filtered scan of the base vectors.
+
+const size_t K = 10;
+const size_t BUILD_BATCH = 10000;
+
+struct DatasetPaths {
+    std::string base;
+    std::string queries;
+    std::string ground_truth;
+    std::string base_attributes;
+    std::string query_attributes;
+    size_t max_queries = 1000;
+};
+
+static DatasetPaths& datasetPaths() {
+    static DatasetPaths paths;
+    return paths;
+}
+
+// Synthetic workload (see workload.h) in the dataset formats: clustered
+// vectors, Zipfian attributes correlated to the clusters, and a query mix of
+// correlated, anti-correlated and unfiltered queries
+static void writeSyntheticDataset(DatasetPaths& paths) {
+    const auto dir = std::filesystem::temp_directory_path();
+    paths.base = (dir / "synthetic_base.fvecs").string();
+    paths.queries = (dir / "synthetic_queries.fvecs").string();
+    paths.base_attributes = (dir / "synthetic_base.spmat").string();
+    paths.query_attributes = (dir / "synthetic_queries.spmat").string();
+    paths.ground_truth.clear();
+
+    filtering::WorkloadOptions options;
+    options.num_points = 20000;
+    options.num_attributes = 200;
+    options.cluster_correlation = 0.8;
+    filtering::Workload workload(options);
+    std::vector<filtering::QueryClass> mix(3);
+    mix[0].min_selectivity = mix[1].min_selectivity = 0.005;
+    mix[0].max_selectivity = mix[1].max_selectivity = 0.05;
+    mix[0].locality = filtering::QueryLocality::Correlated;
+    mix[1].locality = filtering::QueryLocality::AntiCorrelated;
+    mix[2].num_attributes = 0;
+    mix[2].weight = 0.2;
+    auto queries = workload.generateQueries(mix, 200);
+
+    auto write = [&](const std::string& vectors_path, const std::string& attributes_path, size_t count,
+                     const std::function<const float*(size_t)>& vector,
+                     const std::function<std::vector<unsigned int>(size_t)>& attributes) {
+        std::ofstream out(vectors_path, std::ios::binary);
+        const int32_t d = workload.dim();
+        std::vector<int64_t> offsets{0};
+        std::vector<int32_t> indices;
+        for (size_t i = 0; i < count; i++) {
+            out.write((const char*) &d, sizeof(d));
+            out.write((const char*) vector(i), workload.dim() * sizeof(float));
+            for (unsigned int attr : attributes(i)) indices.push_back(attr);
+            offsets.push_back(indices.size());
+        }
+        std::vector<float> values(indices.size(), 1.0f);
+        std::ofstream matrix(attributes_path, std::ios::binary);
+        int64_t header[3] = {int64_t(count), int64_t(options.num_attributes), int64_t(indices.size())};
+        matrix.write((const char*) header, sizeof(header));
+        matrix.write((const char*) offsets.data(), offsets.size() * sizeof(int64_t));
+        matrix.write((const char*) indices.data(), indices.size() * sizeof(int32_t));
+        matrix.write((const char*) values.data(), values.size() * sizeof(float));
+    };
+    write(paths.base, paths.base_attributes, workload.size(),
+          [&](size_t i) { return workload.vector(i); }, [&](size_t i) { return workload.attributes(i); });
+    write(paths.queries, paths.query_attributes, queries.size(),
+          [&](size_t q) { return queries[q].vector.data(); }, [&](size_t q) { return queries[q].attributes; });
+}
+
+struct DatasetFixture {
+    filtering::VectorFile base;
+    filtering::VectorFile queries;
+    std::unique_ptr<filtering::AttributeMatrixFile> base_attributes;
+    std::unique_ptr<filtering::AttributeMatrixFile> query_attributes;
+    hnswlib::L2Space space;
+    std::unique_ptr<hnswlib::HierarchicalNSW<float>> index;
+    std::unique_ptr<filtering::RoaringFilter> filter;
+    std::vector<hnswlib::labeltype> labels;
+    std::vector<float> query_data;
+    std::vector<std::vector<hnswlib::labeltype>> ground_truth;
+    size_t num_queries;
+
+    explicit DatasetFixture(const DatasetPaths& paths)
+        : base(paths.base), queries(paths.queries), space(base.dim()) {
+        if (queries.dim() != base.dim()) {
+            throw std::runtime_error("Queries and base vectors differ in dimension");
+        }
+        if (!paths.base_attributes.empty()) {
+            base_attributes.reset(new filtering::AttributeMatrixFile(paths.base_attributes));
+            if (base_attributes->numPoints() != base.size()) {
+                throw std::runtime_error("Base attributes and base vectors differ in size");
+            }
+        }
+        if (!paths.query_attributes.empty()) {
+            query_attributes.reset(new filtering::AttributeMatrixFile(paths.query_attributes));
+        }
+        labels.resize(base.size());
+        for (size_t i = 0; i < labels.size(); i++) labels[i] = i;
+        num_queries = std::min(paths.max_queries, queries.size());
+        query_data.resize(num_queries * base.dim());
+        queries.copyRows(0, num_queries, query_data.data());
+    }
+
+    const float* query(size_t q) const { return query_data.data() + q * base.dim(); }
+
+    std::vector<unsigned int> queryAttributes(size_t q) const {
+        return query_attributes && q < query_attributes->numPoints() ? query_attributes->row(q)
+                                                                     : std::vector<unsigned int>();
+    }
+
+    // Streams the base file into a fresh index in BUILD_BATCH sized batches.
+    // Float rows are inserted straight from the mapping; other component
+    // types are converted one batch at a time.
+    filtering::BuildReport build() {
+        index.reset(new hnswlib::HierarchicalNSW<float>(&space, BUILD_BATCH, 16, 200));
+        filter.reset(new filtering::RoaringFilter());
+        filtering::ParallelIndexBuilder<float> builder(*index, filter.get());
+        std::vector<float> converted;
+        for (size_t begin = 0; begin < base.size(); begin += BUILD_BATCH) {
+            const size_t end = std::min(base.size(), begin + BUILD_BATCH);
+            filtering::AttributeBatch attributes;
+            if (base_attributes) attributes = base_attributes->batch(labels.data() + begin, begin, end);
+            const filtering::AttributeBatch* batch_attributes = base_attributes ? &attributes : nullptr;
+            if (base.elementType() == filtering::ElementType::Float32) {
+                builder.add(base.row(begin), labels.data() + begin, end - begin, batch_attributes, base.stride());
+            } else {
+                converted.resize((end - begin) * base.dim());
+                base.copyRows(begin, end, converted.data());
+                builder.add(converted.data(), labels.data() + begin, end - begin, batch_attributes);
+            }
+        }
+        return builder.totals();
+    }
+
+    void ensureBuilt() {
+        if (!index) build();
+    }
+
+    void loadGroundTruth(const std::string& path) {
+        filtering::VectorFile truth(path);
+        if (truth.elementType() != filtering::ElementType::Int32 || truth.size() < num_queries) {
+            throw std::runtime_error("Ground truth needs int32 labels for every query: " + path);
+        }
+        ground_truth.resize(num_queries);
+        for (size_t q = 0; q < num_queries; q++) {
+            const int32_t* row = static_cast<const int32_t*>(truth.row(q));
+            ground_truth[q].assign(row, row + std::min(K, truth.dim()));
+        }
+    }
+
+    // Exact filtered k-NN by one pass over the base file per query block,
+    // so that memory stays at one converted batch
+    void computeGroundTruth() {
+        std::vector<filtering::RoaringQuery> filters;
+        for (size_t q = 0; q < num_queries; q++) filters.push_back(filter->makeQuery(queryAttributes(q)));
+        std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>> nearest(num_queries);
+        auto dist_func = space.get_dist_func();
+        void* dist_param = space.get_dist_func_param();
+        std::vector<float> rows;
+        for (size_t begin = 0; begin < base.size(); begin += BUILD_BATCH) {
+            const size_t end = std::min(base.size(), begin + BUILD_BATCH);
+            rows.resize((end - begin) * base.dim());
+            base.copyRows(begin, end, rows.data());
+            for (size_t q = 0; q < num_queries; q++) {
+                const bool filtered = !queryAttributes(q).empty();
+                for (size_t i = begin; i < end; i++) {
+                    if (filtered && !filters[q].matches(i)) continue;
+                    float dist = dist_func(query(q), rows.data() + (i - begin) * base.dim(), dist_param);
+                    if (nearest[q].size() < K || dist < nearest[q].top().first) {
+                        nearest[q].emplace(dist, i);
+                        if (nearest[q].size() > K) nearest[q].pop();
+                    }
+                }
+            }
+        }
+        ground_truth.resize(num_queries);
+        for (size_t q = 0; q < num_queries; q++) {
+            for (; !nearest[q].empty(); nearest[q].pop()) ground_truth[q].push_back(nearest[q].top().second);
+        }
+    }
+
+    void ensureGroundTruth(const DatasetPaths& paths) {
+        if (!ground_truth.empty()) return;
+        ensureBuilt();
+        if (!paths.ground_truth.empty()) {
+            loadGroundTruth(paths.ground_truth);
+        } else {
+            computeGroundTruth();
+        }
+    }
+};
+
+static DatasetFixture& datasetFixture() {
+    static DatasetFixture shared(datasetPaths());
+    return shared;
+}
+
+static void BM_Build(benchmark::State& state) {
+    DatasetFixture& shared = datasetFixture();
+    filtering::BuildReport report{};
+    for (auto _ : state) {
+        report = shared.build();
+    }
+    state.counters["points"] = report.points_inserted;
+    state.counters["points_per_second"] = report.points_per_second;
+    state.counters["resizes"] = report.index_resizes;
+    state.SetItemsProcessed(state.iterations() * shared.base.size());
+}
+
+// Args: ef
+static void BM_Search(benchmark::State& state) {
+    DatasetFixture& shared = datasetFixture();
+    shared.ensureGroundTruth(datasetPaths());
+    const size_t ef = state.range(0);
+    shared.index->setEf(ef);
+
+    size_t q = 0, found = 0, expected = 0;
+    for (auto _ : state) {
+        const size_t i = q++ % shared.num_queries;
+        auto attributes = shared.queryAttributes(i);
+        filtering::RoaringQuery query = shared.filter->makeQuery(attributes);
+        filtering::InternalIdFilter<filtering::RoaringQuery> internal_filter(query, *shared.index);
+        auto result = shared.index->searchKnn(shared.query(i), K, attributes.empty() ? nullptr : &internal_filter);
+        const auto& truth = shared.ground_truth[i];
+        expected += truth.size();
+        for (; !result.empty(); result.pop()) {
+            found += std::count(truth.begin(), truth.end(), result.top().second);
+        }
+    }
+
+    state.counters["recall"] = expected ? double(found) / expected : 0.0;
+    state.counters["ef"] = ef;
+    state.SetItemsProcessed(state.iterations());
+}
+
+void RegisterBenchmarks() {
+    benchmark::RegisterBenchmark("Build", BM_Build)
+        ->Iterations(1)
+        ->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+    for (int64_t ef : {10, 20, 40, 80, 160, 320}) {
+        benchmark::RegisterBenchmark("Search", BM_Search)
+            ->Arg(ef)
+            ->Unit(benchmark::kMicrosecond);
+    }
+}
+
+// Takes the dataset flags out of argv; returns false on an unknown flag
+static bool parseDatasetFlags(int argc, char** argv, DatasetPaths& paths) {
+    const std::pair<const char*, std::string*> flags[] = {
+        {"--base=", &paths.base},
+        {"--queries=", &paths.queries},
+        {"--ground_truth=", &paths.ground_truth},
+        {"--base_attributes=", &paths.base_attributes},
+        {"--query_attributes=", &paths.query_attributes},
+    };
+    for (int i = 1; i < argc; i++) {
+        bool known = false;
+        for (const auto& flag : flags) {
+            if (strncmp(argv[i], flag.first, strlen(flag.first)) == 0) {
+                *flag.second = argv[i] + strlen(flag.first);
+                known = true;
+            }
+        }
+        if (strncmp(argv[i], "--max_queries=", 14) == 0) {
+            paths.max_queries = std::stoul(argv[i] + 14);
+            known = true;
+        }
+        if (!known) {
+            std::cerr << "Unknown flag: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    ::benchmark::Initialize(&argc, argv);
+    DatasetPaths& paths = datasetPaths();
+    if (!parseDatasetFlags(argc, argv, paths)) return 1;
+    if (paths.base.empty()) {
+        writeSyntheticDataset(paths);
+    } else if (paths.queries.empty()) {
+        std::cerr << "--queries is required with --base" << std::endl;
+        return 1;
+    }
+    RegisterBenchmarks();
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
\ No newline at end of file
@@ -2,7 +2,7 @@
 #include "../src/core/naive_filter.h"
 #include "../src/core/bitset_filter.h"
 #include "../src/core/roaring_filter.h"
-#include <random>
+#include "../src/core/workload.h"
 #include <string>
 
 enum class Scenario {
@@ -26,43 +26,45 @@ const ScenarioParams SCENARIOS[] = {
 class FilterBenchmark : public benchmark::Fixture {
 protected:
     std::vector<hnswlib::labeltype> points;
-    std::mt19937 gen;
-    std::uniform_int_distribution<unsigned int> dis_attr;
+    // Drawn from the workload, so the attributes follow its Zipfian
+    // popularity; the pair is held together by at least one point
+    std::vector<unsigned int> single_query;
+    std::vector<unsigned int> pair_query;
     
     filtering::NaiveFilter naive_filter;
     filtering::BitsetFilter bitset_filter;
     filtering::RoaringFilter roaring_filter;
     
     void SetUp(const benchmark::State& state) {
-        gen.seed(42);
         int scenario_idx = state.range(1);
         const auto& scenario = SCENARIOS[scenario_idx];
         
-        dis_attr = std::uniform_int_distribution<unsigned int>(0, scenario.total_attributes - 1);
-        points.resize(state.range(0));
+        filtering::WorkloadOptions options;
+        options.dim = 1;  // Only the attributes are used
+        options.num_points = state.range(0);
+        options.num_attributes = scenario.total_attributes;
+        options.attributes_per_point = scenario.attrs_per_point;
+        filtering::Workload workload(options);
         
-        for (size_t i = 0; i < points.size(); i++) {
-            points[i] = i;
-            std::vector<bool> used_attrs(scenario.total_attributes, false);
-            
-            for (size_t j = 0; j < scenario.attrs_per_point; j++) {
-                unsigned int attr;
-                do {
-                    attr = dis_attr(gen);
-                } while (used_attrs[attr]);
-                
-                used_attrs[attr] = true;
-                naive_filter.addAttribute(i, attr);
-                bitset_filter.addAttribute(i, attr);
-                roaring_filter.addAttribute(i, attr);
-            }
-        }
+        // The fixture is shared by all argument pairs of a benchmark, so start from empty filters
+        naive_filter = filtering::NaiveFilter();
+        bitset_filter = filtering::BitsetFilter({}, scenario.total_attributes);
+        roaring_filter = filtering::RoaringFilter();
+        naive_filter.addPoints(workload.attributeBatch());
+        bitset_filter.addPoints(workload.attributeBatch());
+        roaring_filter.addPoints(workload.attributeBatch());
+        points = workload.labels();
+        
+        std::vector<filtering::QueryClass> mix(1);
+        single_query = workload.generateQueries(mix, 1)[0].attributes;
+        mix[0].num_attributes = 2;
+        pair_query = workload.generateQueries(mix, 1)[0].attributes;
     }
 };
 
 // Naive Filter Benchmarks
 BENCHMARK_DEFINE_F(FilterBenchmark, NaiveFilterSingle)(benchmark::State& state) {
-    std::vector<unsigned int> query_attrs = {dis_attr(gen)};
+    std::vector<unsigned int> query_attrs = single_query;
     naive_filter.setQueryAttributes(query_attrs);
     
     for (auto _ : state) {
@@ -77,7 +79,7 @@ BENCHMARK_DEFINE_F(FilterBenchmark, NaiveFilterSingle)(benchmark::State& state)
 
 // Bitset Filter Benchmarks
 BENCHMARK_DEFINE_F(FilterBenchmark, BitsetFilterSingle)(benchmark::State& state) {
-    std::vector<unsigned int> query_attrs = {dis_attr(gen)};
+    std::vector<unsigned int> query_attrs = single_query;
     bitset_filter.setQueryAttributes(query_attrs);
     
     for (auto _ : state) {
@@ -92,7 +94,7 @@ BENCHMARK_DEFINE_F(FilterBenchmark, BitsetFilterSingle)(benchmark::State& state)
 
 // Roaring Filter Benchmarks
 BENCHMARK_DEFINE_F(FilterBenchmark, RoaringFilterSingle)(benchmark::State& state) {
-    std::vector<unsigned int> query_attrs = {dis_attr(gen)};
+    std::vector<unsigned int> query_attrs = single_query;
     roaring_filter.setQueryAttributes(query_attrs);
     
     for (auto _ : state) {
@@ -107,7 +109,7 @@ BENCHMARK_DEFINE_F(FilterBenchmark, RoaringFilterSingle)(benchmark::State& state
 
 // Multi-attribute benchmarks
 BENCHMARK_DEFINE_F(FilterBenchmark, NaiveFilterMulti)(benchmark::State& state) {
-    std::vector<unsigned int> query_attrs = {dis_attr(gen), dis_attr(gen)};
+    std::vector<unsigned int> query_attrs = pair_query;
     naive_filter.setQueryAttributes(query_attrs);
     
     for (auto _ : state) {
@@ -121,7 +123,7 @@ BENCHMARK_DEFINE_F(FilterBenchmark, NaiveFilterMulti)(benchmark::State& state) {
 }
 
 BENCHMARK_DEFINE_F(FilterBenchmark, BitsetFilterMulti)(benchmark::State& state) {
-    std::vector<unsigned int> query_attrs = {dis_attr(gen), dis_attr(gen)};
+    std::vector<unsigned int> query_attrs = pair_query;
     bitset_filter.setQueryAttributes(query_attrs);
     
     for (auto _ : state) {
@@ -135,7 +137,7 @@ BENCHMARK_DEFINE_F(FilterBenchmark, BitsetFilterMulti)(benchmark::State& state)
 }
 
 BENCHMARK_DEFINE_F(FilterBenchmark, RoaringFilterMulti)(benchmark::State& state) {
-    std::vector<unsigned int> query_attrs = {dis_attr(gen), dis_attr(gen)};
+    std::vector<unsigned int> query_attrs = pair_query;
     roaring_filter.setQueryAttributes(query_attrs);
     
     for (auto _ : state) {
@@ -148,37 +150,82 @@ BENCHMARK_DEFINE_F(FilterBenchmark, RoaringFilterMulti)(benchmark::State& state)
     state.SetLabel(SCENARIOS[state.range(1)].name);
 }
 
-// Register all benchmarks
-void RegisterBenchmarks() {
+// Materialized roaring queries: posting lists are intersected once in setQueryAttributes
+BENCHMARK_DEFINE_F(FilterBenchmark, RoaringMaterializedSingle)(benchmark::State& state) {
+    std::vector<unsigned int> query_attrs = single_query;
+    roaring_filter.setQueryMode(filtering::QueryMode::Materialized);
+    roaring_filter.setQueryAttributes(query_attrs);
+    
+    for (auto _ : state) {
+        for (auto point : points) {
+            benchmark::DoNotOptimize(roaring_filter(point));
+        }
+    }
+    
+    state.SetItemsProcessed(state.iterations() * points.size());
+    state.SetLabel(SCENARIOS[state.range(1)].name);
+}
+
+BENCHMARK_DEFINE_F(FilterBenchmark, RoaringMaterializedMulti)(benchmark::State& state) {
+    std::vector<unsigned int> query_attrs = pair_query;
+    roaring_filter.setQueryMode(filtering::QueryMode::Materialized);
+    roaring_filter.setQueryAttributes(query_attrs);
+    
+    for (auto _ : state) {
+        for (auto point : points) {
+            benchmark::DoNotOptimize(roaring_filter(point));
+        }
+    }
+    
+    state.SetItemsProcessed(state.iterations() * points.size());
+    state.SetLabel(SCENARIOS[state.range(1)].name);
+}
+
+// Every (size, scenario) pair. BENCHMARK_REGISTER_F declares a static, so it
+// must run once per benchmark with all argument pairs applied, not in a loop.
+static void AllSizesAndScenarios(benchmark::internal::Benchmark* b) {
     std::vector<int64_t> sizes = {8, 64, 512, 4096, 8192, 16384};
     
     for (int64_t scenario_idx = 0; scenario_idx < 3; scenario_idx++) {
         for (auto size : sizes) {
-            // Single attribute queries
-            BENCHMARK_REGISTER_F(FilterBenchmark, NaiveFilterSingle)
-                ->Args({size, scenario_idx})
-                ->Unit(benchmark::kMicrosecond);
-            BENCHMARK_REGISTER_F(FilterBenchmark, BitsetFilterSingle)
-                ->Args({size, scenario_idx})
-                ->Unit(benchmark::kMicrosecond);
-            BENCHMARK_REGISTER_F(FilterBenchmark, RoaringFilterSingle)
-                ->Args({size, scenario_idx})
-                ->Unit(benchmark::kMicrosecond);
-            
-            // Multi attribute queries
-            BENCHMARK_REGISTER_F(FilterBenchmark, NaiveFilterMulti)
-                ->Args({size, scenario_idx})
-                ->Unit(benchmark::kMicrosecond);
-            BENCHMARK_REGISTER_F(FilterBenchmark, BitsetFilterMulti)
-                ->Args({size, scenario_idx})
-                ->Unit(benchmark::kMicrosecond);
-            BENCHMARK_REGISTER_F(FilterBenchmark, RoaringFilterMulti)
-                ->Args({size, scenario_idx})
-                ->Unit(benchmark::kMicrosecond);
+            b->Args({size, scenario_idx});
         }
     }
 }
 
+// Register all benchmarks
+void RegisterBenchmarks() {
+    // Single attribute queries
+    BENCHMARK_REGISTER_F(FilterBenchmark, NaiveFilterSingle)
+        ->Apply(AllSizesAndScenarios)
+        ->Unit(benchmark::kMicrosecond);
+    BENCHMARK_REGISTER_F(FilterBenchmark, BitsetFilterSingle)
+        ->Apply(AllSizesAndScenarios)
+        ->Unit(benchmark::kMicrosecond);
+    BENCHMARK_REGISTER_F(FilterBenchmark, RoaringFilterSingle)
+        ->Apply(AllSizesAndScenarios)
+        ->Unit(benchmark::kMicrosecond);
+    
+    // Multi attribute queries
+    BENCHMARK_REGISTER_F(FilterBenchmark, NaiveFilterMulti)
+        ->Apply(AllSizesAndScenarios)
+        ->Unit(benchmark::kMicrosecond);
+    BENCHMARK_REGISTER_F(FilterBenchmark, BitsetFilterMulti)
+        ->Apply(AllSizesAndScenarios)
+        ->Unit(benchmark::kMicrosecond);
+    BENCHMARK_REGISTER_F(FilterBenchmark, RoaringFilterMulti)
+        ->Apply(AllSizesAndScenarios)
+        ->Unit(benchmark::kMicrosecond);
+
+    // Materialized roaring queries
+    BENCHMARK_REGISTER_F(FilterBenchmark, RoaringMaterializedSingle)
+        ->Apply(AllSizesAndScenarios)
+        ->Unit(benchmark::kMicrosecond);
+    BENCHMARK_REGISTER_F(FilterBenchmark, RoaringMaterializedMulti)
+        ->Apply(AllSizesAndScenarios)
+        ->Unit(benchmark::kMicrosecond);
+}
+
 int main(int argc, char** argv) {
     RegisterBenchmarks();
     ::benchmark::Initialize(&argc, argv);
@@ -0,0 +1,340 @@
+#include <benchmark/benchmark.h>
+#include "../src/core/attribute_links.h"
+#include "../src/core/partitioned_index.h"
+#include "../src/core/workload.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// End-to-end filtered k-NN search: HierarchicalNSW with a roaring filter on
+// a clustered workload with Zipfian attributes correlated to the clusters
+// (see workload.h). Query sets are drawn per selectivity range and query
+// locality; ground truth is a BruteforceSearch under the same filter.
+//
+//   FilteredSearch   searchKnn swept over ef and search threads
+//   TraversalSearch  one ef, with and without attribute links
+//                    (addAttributeLinks), per hnswlib::FilterTraversal
+//   PartitionSearch  the query attribute's own partition, unfiltered
+//
+// Counters:
+//   recall       recall@K against the exact filtered result
+//   dist_comps   distance computations per query, upper layers included
+//   visited      base-layer nodes marked visited, per query
+//                (FilteredSearch only)
+//   selectivity  mean fraction of points matching the query filters
+//   locality     a filtering::QueryLocality: 0 correlated, 1 uncorrelated,
+//                2 anti-correlated (the filter's matches are far away)
+// items_per_second is the aggregate QPS over all threads. Run with
+// --benchmark_format=json (or --benchmark_out) and pass the file to
+// visualize_results.py for the FilteredSearch recall/QPS plots.
+
+const size_t NUM_QUERIES = 200;
+const size_t K = 10;
+
+// Ranges for the fraction of points a query's attribute matches
+const std::pair<double, double> SELECTIVITY_RANGES[] = {
+    {0.0005, 0.002}, {0.002, 0.01}, {0.01, 0.05}, {0.05, 0.3}, {0.3, 0.7}};
+const size_t NUM_SELECTIVITIES = 5;
+// Ranges whose attributes get a partition in PartitionSearch
+const size_t FIRST_PARTITIONED_RANGE = 3;
+const size_t NUM_LOCALITIES = 3;
+const char* const LOCALITY_NAMES[] = {"correlated", "uncorrelated", "anti-correlated"};
+const char* const TRAVERSAL_NAMES[] = {"score all", "allowed subgraph", "two-hop"};
+
+filtering::WorkloadOptions workloadOptions() {
+    filtering::WorkloadOptions options;
+    options.dim = 32;
+    options.num_points = 20000;
+    options.num_clusters = 50;
+    options.num_attributes = 1000;
+    // Skewed enough for the most popular attribute to cover about half the points
+    options.attributes_per_point = 6;
+    options.zipf_exponent = 1.4;
+    options.cluster_correlation = 0.8;
+    return options;
+}
+
+struct QuerySet {
+    std::vector<filtering::WorkloadQuery> queries;
+    // Exact filtered k-NN labels per query, from BruteforceSearch
+    std::vector<std::vector<hnswlib::labeltype>> ground_truth;
+    double mean_selectivity = 0.0;
+};
+
+struct SearchFixture {
+    filtering::Workload workload{workloadOptions()};
+    hnswlib::L2Space space{workload.dim()};
+    hnswlib::HierarchicalNSW<float> index{&space, workload.size(), 16, 200};
+    filtering::RoaringFilter filter;
+    // By selectivity range and locality
+    std::vector<std::vector<QuerySet>> query_sets;
+    // Per query averages of the search metrics, by query set and ef
+    std::map<std::pair<size_t, size_t>, std::pair<double, double>> search_metrics;
+    std::mutex search_metrics_lock;
+    // Built on first use by PartitionSearch
+    std::unique_ptr<filtering::PartitionedIndex<float>> partitioned;
+    // Built on first use by TraversalSearch
+    std::unique_ptr<hnswlib::HierarchicalNSW<float>> linked;
+
+    SearchFixture() {
+        insertPoints(index);
+        filter.addPoints(workload.attributeBatch());
+        filter.alignWith(index);
+        hnswlib::BruteforceSearch<float> bruteforce(&space, workload.size());
+        for (size_t i = 0; i < workload.size(); i++) {
+            bruteforce.addPoint(workload.vector(i), i);
+        }
+
+        query_sets.resize(NUM_SELECTIVITIES);
+        for (size_t range = 0; range < NUM_SELECTIVITIES; range++) {
+            for (size_t locality = 0; locality < NUM_LOCALITIES; locality++) {
+                filtering::QueryClass query_class;
+                query_class.min_selectivity = SELECTIVITY_RANGES[range].first;
+                query_class.max_selectivity = SELECTIVITY_RANGES[range].second;
+                query_class.locality = filtering::QueryLocality(locality);
+                QuerySet set;
+                set.queries = workload.generateQueries({query_class}, NUM_QUERIES, 7 + range * NUM_LOCALITIES + locality);
+                for (const auto& query : set.queries) {
+                    filtering::RoaringQuery roaring_query = filter.makeQuery(query.attributes);
+                    filtering::QueryFilter<filtering::RoaringQuery> label_filter(roaring_query);
+                    std::vector<hnswlib::labeltype> truth;
+                    for (auto result = bruteforce.searchKnn(query.vector.data(), K, &label_filter); !result.empty();
+                         result.pop()) {
+                        truth.push_back(result.top().second);
+                    }
+                    set.ground_truth.push_back(truth);
+                    set.mean_selectivity += query.selectivity / NUM_QUERIES;
+                }
+                query_sets[range].push_back(std::move(set));
+            }
+        }
+    }
+
+    // Every workload point in label order, so internal id == label
+    void insertPoints(hnswlib::HierarchicalNSW<float>& target) {
+        for (size_t i = 0; i < workload.size(); i++) {
+            target.addPoint(workload.vector(i), i);
+        }
+    }
+
+    // The same graph as index, built the same way so the filter's slots are
+    // its internal ids too, plus attribute links
+    hnswlib::HierarchicalNSW<float>& linkedIndex() {
+        if (!linked) {
+            linked.reset(new hnswlib::HierarchicalNSW<float>(&space, workload.size(), 16, 200));
+            insertPoints(*linked);
+            filtering::addAttributeLinks(*linked, filter);
+        }
+        return *linked;
+    }
+
+    // Distance computations and visited nodes per query, measured once per
+    // query set and ef outside the timed loops, through the same searchKnn path
+    // at the index's current ef
+    std::pair<double, double> searchMetrics(size_t range, size_t locality, size_t ef) {
+        std::unique_lock<std::mutex> lock(search_metrics_lock);
+        auto cached = search_metrics.find({range * NUM_LOCALITIES + locality, ef});
+        if (cached != search_metrics.end()) return cached->second;
+
+        hnswlib::SearchStats stats;
+        for (const auto& query_data : query_sets[range][locality].queries) {
+            filtering::RoaringQuery query = filter.makeQuery(query_data.attributes);
+            filtering::InternalIdFilter<filtering::RoaringQuery> internal_filter(query, index);
+            index.searchKnnWithFilter(query_data.vector.data(), K, &internal_filter,
+                                      hnswlib::FilterTraversal::ScoreAll, &stats);
+        }
+        std::pair<double, double> metrics(double(stats.distance_computations) / NUM_QUERIES,
+                                          double(stats.visited) / NUM_QUERIES);
+        search_metrics[{range * NUM_LOCALITIES + locality, ef}] = metrics;
+        return metrics;
+    }
+
+    // Partitions for every query attribute of the partitioned ranges
+    filtering::PartitionedIndex<float>& partitions() {
+        if (!partitioned) {
+            partitioned.reset(new filtering::PartitionedIndex<float>(&space, index, filter));
+            for (size_t range = FIRST_PARTITIONED_RANGE; range < NUM_SELECTIVITIES; range++) {
+                for (const auto& set : query_sets[range]) {
+                    for (const auto& query : set.queries) {
+                        if (!partitioned->isPartitioned(query.attributes[0])) {
+                            partitioned->addPartition(query.attributes[0]);
+                        }
+                    }
+                }
+            }
+        }
+        return *partitioned;
+    }
+};
+
+static SearchFixture& searchFixture() {
+    static SearchFixture shared;
+    return shared;
+}
+
+// Results of the query that are among its exact nearest neighbours
+static size_t countFound(std::priority_queue<std::pair<float, hnswlib::labeltype>> result,
+                         const std::vector<hnswlib::labeltype>& truth) {
+    size_t found = 0;
+    for (; !result.empty(); result.pop()) {
+        found += std::count(truth.begin(), truth.end(), result.top().second);
+    }
+    return found;
+}
+
+static void setSearchCounters(benchmark::State& state, const QuerySet& set, size_t locality, size_t ef,
+                              size_t found, size_t expected) {
+    state.counters["recall"] = benchmark::Counter(expected ? double(found) / expected : 0.0,
+                                                  benchmark::Counter::kAvgThreads);
+    state.counters["selectivity"] = benchmark::Counter(set.mean_selectivity, benchmark::Counter::kAvgThreads);
+    state.counters["locality"] = benchmark::Counter(locality, benchmark::Counter::kAvgThreads);
+    state.counters["ef"] = benchmark::Counter(ef, benchmark::Counter::kAvgThreads);
+    state.SetItemsProcessed(state.iterations());
+}
+
+static std::string setLabel(const QuerySet& set, size_t locality) {
+    return std::to_string(set.mean_selectivity * 100) + "% matching, " + LOCALITY_NAMES[locality];
+}
+
+// Args: selectivity range (see SELECTIVITY_RANGES), locality (a
+// filtering::QueryLocality), ef
+static void BM_FilteredSearch(benchmark::State& state) {
+    SearchFixture& shared = searchFixture();
+    const size_t range = state.range(0);
+    const size_t locality = state.range(1);
+    const size_t ef = state.range(2);
+    const QuerySet& set = shared.query_sets[range][locality];
+    // The other threads only read ef once the timed loop has started
+    if (state.thread_index() == 0) {
+        shared.index.setEf(ef);
+    }
+
+    size_t q = state.thread_index(), found = 0, expected = 0;
+    for (auto _ : state) {
+        const auto& query_data = set.queries[q % NUM_QUERIES];
+        filtering::RoaringQuery query = shared.filter.makeQuery(query_data.attributes);
+        filtering::InternalIdFilter<filtering::RoaringQuery> internal_filter(query, shared.index);
+        const auto& truth = set.ground_truth[q % NUM_QUERIES];
+        found += countFound(shared.index.searchKnn(query_data.vector.data(), K, &internal_filter), truth);
+        expected += truth.size();
+        q += state.threads();
+    }
+
+    // After the timed loop, once ef is set for every thread
+    auto metrics = shared.searchMetrics(range, locality, ef);
+    setSearchCounters(state, set, locality, ef, found, expected);
+    state.counters["dist_comps"] = benchmark::Counter(metrics.first, benchmark::Counter::kAvgThreads);
+    state.counters["visited"] = benchmark::Counter(metrics.second, benchmark::Counter::kAvgThreads);
+    state.SetLabel(setLabel(set, locality));
+}
+
+// Args: selectivity range, locality, ef, attribute links on/off, traversal
+// (a hnswlib::FilterTraversal)
+static void BM_TraversalSearch(benchmark::State& state) {
+    SearchFixture& shared = searchFixture();
+    const size_t range = state.range(0);
+    const size_t locality = state.range(1);
+    const size_t ef = state.range(2);
+    const auto traversal = static_cast<hnswlib::FilterTraversal>(state.range(4));
+    const QuerySet& set = shared.query_sets[range][locality];
+    hnswlib::HierarchicalNSW<float>& index = state.range(3) ? shared.linkedIndex() : shared.index;
+    index.setEf(ef);
+
+    size_t q = 0, found = 0, expected = 0;
+    hnswlib::SearchStats stats;
+    for (auto _ : state) {
+        const auto& query_data = set.queries[q];
+        filtering::RoaringQuery query = shared.filter.makeQuery(query_data.attributes);
+        filtering::InternalIdFilter<filtering::RoaringQuery> internal_filter(query, index);
+        const auto& truth = set.ground_truth[q];
+        found += countFound(index.searchKnnWithFilter(query_data.vector.data(), K, &internal_filter, traversal,
+                                                      &stats),
+                            truth);
+        expected += truth.size();
+        q = (q + 1) % NUM_QUERIES;
+    }
+
+    setSearchCounters(state, set, locality, ef, found, expected);
+    state.counters["dist_comps"] = double(stats.distance_computations) / state.iterations();
+    state.SetLabel(setLabel(set, locality) + ", " + TRAVERSAL_NAMES[state.range(4)] +
+                   (state.range(3) ? ", attribute links" : ""));
+}
+
+// Args: selectivity range (FIRST_PARTITIONED_RANGE or later), locality, ef
+static void BM_PartitionSearch(benchmark::State& state) {
+    SearchFixture& shared = searchFixture();
+    const size_t range = state.range(0);
+    const size_t locality = state.range(1);
+    const size_t ef = state.range(2);
+    const QuerySet& set = shared.query_sets[range][locality];
+    filtering::PartitionedIndex<float>& partitioned = shared.partitions();
+    partitioned.setEf(ef);
+
+    size_t q = 0, found = 0, expected = 0;
+    hnswlib::SearchStats stats;
+    for (auto _ : state) {
+        const auto& query_data = set.queries[q];
+        const auto& partition = *partitioned.partition(query_data.attributes[0]);
+        const auto& truth = set.ground_truth[q];
+        found += countFound(partition.searchKnnWithFilter(query_data.vector.data(), K,
+                                                          (hnswlib::BaseFilterFunctor*) nullptr,
+                                                          hnswlib::FilterTraversal::ScoreAll, &stats),
+                            truth);
+        expected += truth.size();
+        q = (q + 1) % NUM_QUERIES;
+    }
+
+    size_t partition_bytes = 0;
+    for (const auto& partition_stats : partitioned.partitionStats()) partition_bytes += partition_stats.memory_bytes;
+    setSearchCounters(state, set, locality, ef, found, expected);
+    state.counters["dist_comps"] = double(stats.distance_computations) / state.iterations();
+    state.counters["partitions_MB"] = partition_bytes / 1e6;
+    state.SetLabel(setLabel(set, locality) + ", own partition");
+}
+
+void RegisterBenchmarks() {
+    const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int64_t range = 0; range < int64_t(NUM_SELECTIVITIES); range++) {
+        for (int64_t locality = 0; locality < int64_t(NUM_LOCALITIES); locality++) {
+            for (int64_t ef : {10, 20, 40, 80, 160, 320}) {
+                benchmark::RegisterBenchmark("FilteredSearch", BM_FilteredSearch)
+                    ->Args({range, locality, ef})
+                    ->ThreadRange(1, max_threads)
+                    ->UseRealTime()
+                    ->Unit(benchmark::kMicrosecond);
+            }
+        }
+    }
+
+    // Filters whose matches are scattered or far away, where the traversal matters
+    const int64_t score_all = int64_t(hnswlib::FilterTraversal::ScoreAll);
+    const int64_t allowed_subgraph = int64_t(hnswlib::FilterTraversal::AllowedSubgraph);
+    const int64_t two_hop = int64_t(hnswlib::FilterTraversal::TwoHop);
+    for (int64_t range = 0; range < int64_t(NUM_SELECTIVITIES); range++) {
+        for (int64_t locality : {int64_t(filtering::QueryLocality::Uncorrelated),
+                                 int64_t(filtering::QueryLocality::AntiCorrelated)}) {
+            for (int64_t ef : {10, 40}) {
+                for (auto links_traversal : {std::make_pair(0, score_all), std::make_pair(1, score_all),
+                                             std::make_pair(1, allowed_subgraph), std::make_pair(0, two_hop)}) {
+                    benchmark::RegisterBenchmark("TraversalSearch", BM_TraversalSearch)
+                        ->Args({range, locality, ef, links_traversal.first, links_traversal.second})
+                        ->Unit(benchmark::kMicrosecond);
+                }
+                if (range >= int64_t(FIRST_PARTITIONED_RANGE)) {
+                    benchmark::RegisterBenchmark("PartitionSearch", BM_PartitionSearch)
+                        ->Args({range, locality, ef})
+                        ->Unit(benchmark::kMicrosecond);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    RegisterBenchmarks();
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include <benchmark/benchmark.h>
+#include "../src/core/bitset_filter.h"
+#include "../src/core/roaring_filter.h"
+#include "../src/core/index_builder.h"
+#include "../src/core/workload.h"
+#include <string>
+#include <thread>
+
+// Building a filter from scratch: one addAttribute call per (point, attribute)
+// pair, against a single addPoints call on the same data in CSR form. The
+// attributes come from a filtering::Workload, with Zipfian popularity.
+// items_per_second counts (point, attribute) pairs.
+
+struct IngestionScenario {
+    size_t num_points;
+    size_t total_attributes;
+    size_t attrs_per_point;
+    std::string name;
+};
+
+const IngestionScenario INGESTION_SCENARIOS[] = {
+    {100000, 1000, 50, "Dense"},
+    {10000, 100000, 50, "Sparse"}  // Bitset rows are 12.5 KB here
+};
+
+filtering::WorkloadOptions ingestionOptions(const IngestionScenario& scenario) {
+    filtering::WorkloadOptions options;
+    options.dim = 1;  // Only the attributes are ingested
+    options.num_points = scenario.num_points;
+    options.num_attributes = scenario.total_attributes;
+    options.attributes_per_point = scenario.attrs_per_point;
+    return options;
+}
+
+static const filtering::Workload& ingestionWorkload(size_t scenario_idx) {
+    static const filtering::Workload workloads[] = {filtering::Workload(ingestionOptions(INGESTION_SCENARIOS[0])),
+                                                    filtering::Workload(ingestionOptions(INGESTION_SCENARIOS[1]))};
+    return workloads[scenario_idx];
+}
+
+// (point, attribute) pairs in a batch
+static size_t numPairs(const filtering::AttributeBatch& batch) {
+    return batch.offsets[batch.num_points] - batch.offsets[0];
+}
+
+template <typename Filter>
+static Filter makeFilter(const IngestionScenario& scenario);
+
+template <>
+filtering::BitsetFilter makeFilter<filtering::BitsetFilter>(const IngestionScenario& scenario) {
+    return filtering::BitsetFilter({}, scenario.total_attributes);
+}
+
+template <>
+filtering::RoaringFilter makeFilter<filtering::RoaringFilter>(const IngestionScenario&) {
+    return filtering::RoaringFilter();
+}
+
+// Args: scenario
+template <typename Filter>
+static void BM_PerCallIngestion(benchmark::State& state) {
+    const auto& scenario = INGESTION_SCENARIOS[state.range(0)];
+    const filtering::AttributeBatch batch = ingestionWorkload(state.range(0)).attributeBatch();
+
+    for (auto _ : state) {
+        Filter filter = makeFilter<Filter>(scenario);
+        for (size_t i = 0; i < batch.num_points; i++) {
+            for (size_t j = batch.offsets[i]; j < batch.offsets[i + 1]; j++) {
+                filter.addAttribute(batch.labels[i], batch.attributes[j]);
+            }
+        }
+        benchmark::DoNotOptimize(filter.getAttributeCardinality(0));
+    }
+
+    state.SetItemsProcessed(state.iterations() * numPairs(batch));
+    state.SetLabel(scenario.name);
+}
+
+// Args: scenario, threads
+template <typename Filter>
+static void BM_BulkIngestion(benchmark::State& state) {
+    const auto& scenario = INGESTION_SCENARIOS[state.range(0)];
+    const filtering::AttributeBatch batch = ingestionWorkload(state.range(0)).attributeBatch();
+
+    for (auto _ : state) {
+        Filter filter = makeFilter<Filter>(scenario);
+        filter.addPoints(batch, state.range(1));
+        benchmark::DoNotOptimize(filter.getAttributeCardinality(0));
+    }
+
+    state.SetItemsProcessed(state.iterations() * numPairs(batch));
+    state.SetLabel(scenario.name);
+}
+
+// Args: threads
+// Graph and attributes built together, as a nightly rebuild would
+static void BM_ParallelIndexBuild(benchmark::State& state) {
+    const auto& scenario = INGESTION_SCENARIOS[0];
+    static const filtering::Workload workload = [&] {
+        filtering::WorkloadOptions options = ingestionOptions(scenario);
+        options.dim = 32;
+        options.num_points = 20000;
+        return filtering::Workload(options);
+    }();
+
+    filtering::BuildOptions options;
+    options.num_threads = state.range(0);
+    filtering::AttributeBatch batch = workload.attributeBatch();
+
+    for (auto _ : state) {
+        hnswlib::L2Space space(workload.dim());
+        hnswlib::HierarchicalNSW<float> index(&space, workload.size());
+        filtering::BitsetFilter filter({}, scenario.total_attributes);
+        filtering::ParallelIndexBuilder<float> builder(index, &filter, options);
+        benchmark::DoNotOptimize(builder.add(workload.vectors().data(), workload.labels().data(), workload.size(),
+                                             &batch));
+    }
+
+    state.SetItemsProcessed(state.iterations() * workload.size());
+}
+
+void RegisterBenchmarks() {
+    const int64_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int64_t scenario_idx = 0; scenario_idx < 2; scenario_idx++) {
+        benchmark::RegisterBenchmark("BitsetPerCallIngestion", BM_PerCallIngestion<filtering::BitsetFilter>)
+            ->Args({scenario_idx})
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark("RoaringPerCallIngestion", BM_PerCallIngestion<filtering::RoaringFilter>)
+            ->Args({scenario_idx})
+            ->Unit(benchmark::kMillisecond);
+        for (int64_t threads = 1; threads <= max_threads; threads *= 2) {
+            benchmark::RegisterBenchmark("BitsetBulkIngestion", BM_BulkIngestion<filtering::BitsetFilter>)
+                ->Args({scenario_idx, threads})
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+            benchmark::RegisterBenchmark("RoaringBulkIngestion", BM_BulkIngestion<filtering::RoaringFilter>)
+                ->Args({scenario_idx, threads})
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+        }
+    }
+    for (int64_t threads = 1; threads <= max_threads; threads *= 2) {
+        benchmark::RegisterBenchmark("ParallelIndexBuild", BM_ParallelIndexBuild)
+            ->Args({threads})
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+    }
+}
+
+int main(int argc, char** argv) {
+    RegisterBenchmarks();
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
\ No newline at end of file
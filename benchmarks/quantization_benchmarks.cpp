@@ -0,0 +1,169 @@
+#include <benchmark/benchmark.h>
+#include "../external/hnswlib/hnswlib.h"
+#include "../src/core/workload.h"
+#include <map>
+#include <memory>
+
+// Float32 index against SQ8 and PQ indexes of the same points, searched with
+// and without re-ranking the top candidates by float distance. index_MB is
+// HierarchicalNSW::memoryUsage; recall is against an exact float scan.
+
+const size_t DIM = 128;
+const size_t NUM_POINTS = 20000;
+const size_t NUM_QUERIES = 200;
+const size_t K = 10;
+const size_t EF = 64;
+const size_t PQ_TRAINING_POINTS = 5000;
+
+// Points spread over a few hundred gaussian clusters; no attributes
+filtering::WorkloadOptions workloadOptions() {
+    filtering::WorkloadOptions options;
+    options.dim = DIM;
+    options.num_points = NUM_POINTS;
+    options.num_clusters = 256;
+    options.center_range = 1.0f;
+    options.cluster_stddev = 0.2f;
+    options.num_attributes = 0;
+    return options;
+}
+
+struct QuantizationFixture {
+    filtering::Workload workload{workloadOptions()};
+    const std::vector<float>& vectors{workload.vectors()};
+    std::vector<float> queries;
+    std::vector<std::vector<hnswlib::labeltype>> ground_truth;
+    hnswlib::L2Space float_space{DIM};
+    hnswlib::SQ8Space sq8_space;
+    hnswlib::HierarchicalNSW<float> float_index{&float_space, NUM_POINTS};
+    hnswlib::HierarchicalNSW<float> sq8_index{&sq8_space, NUM_POINTS};
+    std::vector<unsigned char> query_codes;
+    // PQ indexes by number of subspaces
+    std::map<size_t, std::unique_ptr<hnswlib::PQSpace>> pq_spaces;
+    std::map<size_t, std::unique_ptr<hnswlib::HierarchicalNSW<float>>> pq_indexes;
+
+    QuantizationFixture() : sq8_space(hnswlib::SQ8Space::train(DIM, vectors.data(), NUM_POINTS)) {
+        std::vector<filtering::QueryClass> unfiltered(1);
+        unfiltered[0].num_attributes = 0;
+        for (const auto& query : workload.generateQueries(unfiltered, NUM_QUERIES)) {
+            queries.insert(queries.end(), query.vector.begin(), query.vector.end());
+        }
+
+        std::vector<unsigned char> code(sq8_space.get_data_size());
+        for (size_t i = 0; i < NUM_POINTS; i++) {
+            float_index.addPoint(vectors.data() + i * DIM, i);
+            sq8_space.encode(vectors.data() + i * DIM, code.data());
+            sq8_index.addPoint(code.data(), i);
+        }
+        float_index.setEf(EF);
+        sq8_index.setEf(EF);
+
+        query_codes.resize(NUM_QUERIES * sq8_space.get_data_size());
+        for (size_t q = 0; q < NUM_QUERIES; q++) {
+            sq8_space.encode(query(q), query_codes.data() + q * sq8_space.get_data_size());
+            ground_truth.push_back(workload.exactKnn(query(q), {}, K));
+        }
+    }
+
+    const float* query(size_t q) const { return queries.data() + q * DIM; }
+
+    hnswlib::HierarchicalNSW<float>& pqIndex(size_t m) {
+        if (!pq_indexes.count(m)) {
+            pq_spaces[m].reset(new hnswlib::PQSpace(
+                hnswlib::PQSpace::train(DIM, m, vectors.data(), PQ_TRAINING_POINTS)));
+            pq_indexes[m].reset(new hnswlib::HierarchicalNSW<float>(pq_spaces[m].get(), NUM_POINTS));
+            std::vector<unsigned char> code(pq_spaces[m]->get_data_size());
+            for (size_t i = 0; i < NUM_POINTS; i++) {
+                pq_spaces[m]->encode(vectors.data() + i * DIM, code.data());
+                pq_indexes[m]->addPoint(code.data(), i);
+            }
+            pq_indexes[m]->setEf(EF);
+        }
+        return *pq_indexes[m];
+    }
+};
+
+static QuantizationFixture& fixture() {
+    static QuantizationFixture shared;
+    return shared;
+}
+
+static double recallOf(std::priority_queue<std::pair<float, hnswlib::labeltype>> result,
+                       const std::vector<hnswlib::labeltype>& truth) {
+    size_t found = 0;
+    for (; !result.empty(); result.pop()) {
+        found += std::count(truth.begin(), truth.end(), result.top().second);
+    }
+    return double(found) / truth.size();
+}
+
+static void BM_FloatSearch(benchmark::State& state) {
+    auto& f = fixture();
+    size_t q = 0;
+    double recall = 0;
+    for (auto _ : state) {
+        auto result = f.float_index.searchKnn(f.query(q), K);
+        recall += recallOf(result, f.ground_truth[q]);
+        q = (q + 1) % NUM_QUERIES;
+    }
+    state.counters["recall"] = recall / state.iterations();
+    state.counters["index_MB"] = f.float_index.memoryUsage() / 1e6;
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Args: candidates re-ranked by float distance, as a multiple of K (0: none)
+static void BM_SQ8Search(benchmark::State& state) {
+    auto& f = fixture();
+    const size_t rerank = state.range(0);
+    auto vector_of = [&](hnswlib::labeltype label) { return f.vectors.data() + label * DIM; };
+    size_t q = 0;
+    double recall = 0;
+    for (auto _ : state) {
+        const unsigned char* code = f.query_codes.data() + q * f.sq8_space.get_data_size();
+        auto result = rerank ? hnswlib::rerankL2(f.sq8_index.searchKnn(code, rerank * K), f.query(q), DIM, K, vector_of)
+                             : f.sq8_index.searchKnn(code, K);
+        recall += recallOf(result, f.ground_truth[q]);
+        q = (q + 1) % NUM_QUERIES;
+    }
+    state.counters["recall"] = recall / state.iterations();
+    state.counters["index_MB"] = f.sq8_index.memoryUsage() / 1e6;
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Args: number of subspaces, candidates re-ranked as a multiple of K (0: none)
+static void BM_PQSearch(benchmark::State& state) {
+    auto& f = fixture();
+    const size_t m = state.range(0);
+    const size_t rerank = state.range(1);
+    auto& index = f.pqIndex(m);
+    auto& space = *f.pq_spaces[m];
+    auto vector_of = [&](hnswlib::labeltype label) { return f.vectors.data() + label * DIM; };
+    size_t q = 0;
+    double recall = 0;
+    for (auto _ : state) {
+        auto table = space.makeQuery(f.query(q));
+        auto result = rerank ? hnswlib::rerankL2(index.searchKnn(table.data(), rerank * K), f.query(q), DIM, K, vector_of)
+                             : index.searchKnn(table.data(), K);
+        recall += recallOf(result, f.ground_truth[q]);
+        q = (q + 1) % NUM_QUERIES;
+    }
+    state.counters["recall"] = recall / state.iterations();
+    state.counters["index_MB"] = index.memoryUsage() / 1e6;
+    state.SetItemsProcessed(state.iterations());
+}
+
+void RegisterBenchmarks() {
+    benchmark::RegisterBenchmark("FloatSearch", BM_FloatSearch)->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark("SQ8Search", BM_SQ8Search)
+        ->Arg(0)->Arg(2)->Arg(4)
+        ->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark("PQSearch", BM_PQSearch)
+        ->Args({16, 0})->Args({16, 4})->Args({32, 0})->Args({32, 4})
+        ->Unit(benchmark::kMicrosecond);
+}
+
+int main(int argc, char** argv) {
+    RegisterBenchmarks();
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
\ No newline at end of file
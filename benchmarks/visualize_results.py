@@ -1,22 +1,102 @@
 import pandas as pd
 import matplotlib.pyplot as plt
 import json
+import re
 import sys
 
+# QueryLocality values in filtered_search_benchmarks' locality counter
+LOCALITY_NAMES = ['correlated', 'uncorrelated', 'anti-correlated']
+
+def create_search_visualizations(benchmarks):
+    # One record per FilteredSearch run; the traversal and partition runs and
+    # aggregates of repetitions are skipped
+    records = []
+    for benchmark in benchmarks:
+        if benchmark.get('run_type', 'iteration') != 'iteration':
+            continue
+        if not benchmark['name'].startswith('FilteredSearch/'):
+            continue
+        records.append({
+            'Selectivity': benchmark['selectivity'],
+            'Locality': LOCALITY_NAMES[int(benchmark.get('locality', 1))],
+            'ef': int(benchmark['ef']),
+            'Threads': benchmark.get('threads', 1),
+            'QPS': benchmark['items_per_second'],
+            'Recall': benchmark['recall'],
+            'DistComps': benchmark['dist_comps'],
+            'Visited': benchmark['visited'],
+        })
+
+    df = pd.DataFrame(records).sort_values(['Locality', 'Selectivity', 'Threads', 'ef'])
+    single = df[df['Threads'] == df['Threads'].min()]
+
+    fig, axes = plt.subplots(1, 3, figsize=(18, 6))
+    fig.suptitle('Filtered Search: Recall vs Throughput', fontsize=16)
+
+    # 1. Recall/QPS trade-off over ef, one curve per selectivity and locality (Left)
+    for (locality, selectivity), data in single.groupby(['Locality', 'Selectivity']):
+        axes[0].plot(data['Recall'], data['QPS'], marker='o', label=f'{selectivity:.1%} {locality}')
+    axes[0].set_title('QPS vs Recall@k (single thread)')
+    axes[0].set_xlabel('Recall@k')
+    axes[0].set_ylabel('Queries per Second')
+    axes[0].set_yscale('log')
+    axes[0].grid(True)
+    axes[0].legend(title='Selectivity, locality')
+
+    # 2. Work per query (Middle)
+    for (locality, selectivity), data in single.groupby(['Locality', 'Selectivity']):
+        axes[1].plot(data['Recall'], data['DistComps'], marker='o', label=f'{selectivity:.1%} {locality}')
+    axes[1].set_title('Distance Computations vs Recall@k')
+    axes[1].set_xlabel('Recall@k')
+    axes[1].set_ylabel('Distance computations per query')
+    axes[1].set_yscale('log')
+    axes[1].grid(True)
+    axes[1].legend(title='Selectivity, locality')
+
+    # 3. Thread scaling at the largest ef (Right)
+    largest_ef = df[df['ef'] == df['ef'].max()]
+    for (locality, selectivity), data in largest_ef.groupby(['Locality', 'Selectivity']):
+        axes[2].plot(data['Threads'], data['QPS'], marker='o', label=f'{selectivity:.1%} {locality}')
+    axes[2].set_title(f'QPS vs Threads (ef={df["ef"].max()})')
+    axes[2].set_xlabel('Threads')
+    axes[2].set_ylabel('Queries per Second')
+    axes[2].grid(True)
+    axes[2].legend(title='Selectivity, locality')
+
+    plt.tight_layout(rect=[0, 0.03, 1, 0.95])
+    plt.savefig('search_recall_qps.png', dpi=300, bbox_inches='tight')
+
+    summary = df.set_index(['Locality', 'Selectivity', 'ef', 'Threads']).round(3)
+    summary.to_csv('search_summary.csv')
+    print("\nSearch Benchmark Summary:")
+    print(summary)
+    print("\nResults saved as search_recall_qps.png and search_summary.csv")
+
 def create_visualizations(json_file):
     # Read data
     with open(json_file) as f:
         data = json.load(f)
 
+    # Output of filtered_search_benchmarks
+    if any('selectivity' in benchmark for benchmark in data['benchmarks']):
+        create_search_visualizations(data['benchmarks'])
+        return
+
+    if not any(benchmark['name'].startswith('FilterBenchmark/') for benchmark in data['benchmarks']):
+        print(f"{json_file} has no filter or filtered search benchmarks to plot")
+        sys.exit(1)
+
     # Process into DataFrame
     records = []
     for benchmark in data['benchmarks']:
+        if not benchmark['name'].startswith('FilterBenchmark/'):
+            continue
         name_parts = benchmark['name'].split('/')
         method = name_parts[0]
         test_type = name_parts[1]
         size = int(name_parts[2])
         records.append({
-            'Method': test_type.replace('FilterSingle', '').replace('FilterMulti', ''),
+            'Method': re.sub(r'(Filter)?(Single|Multi)$', '', test_type),
             'Type': 'Single' if 'Single' in test_type else 'Multi',
             'Size': size,
             'Time_us': benchmark['cpu_time'],
@@ -1,8 +1,8 @@
 #include <iostream>
-#include <random>
 #include <chrono>
 #include <iomanip>
 #include "../src/core/bitset_filter.h"
+#include "../src/core/workload.h"
 #include "../external/hnswlib/hnswlib.h"
 
 void printPoint(const float* point, size_t dim) {
@@ -32,39 +32,24 @@ void runBitsetHNSWExample() {
     hnswlib::L2Space space(dim);
     auto* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, num_points);
     
-    // Initialize random generators
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis_vec(-1.0, 1.0);  // For vector components
-    std::uniform_int_distribution<> dis_attr(0, num_attributes-1);  // For attributes
+    // Clustered vectors with Zipfian attributes that follow the clusters
+    filtering::WorkloadOptions options;
+    options.dim = dim;
+    options.num_points = num_points;
+    options.num_clusters = 20;
+    options.center_range = 1.0f;
+    options.cluster_stddev = 0.2f;
+    options.num_attributes = num_attributes;
+    options.attributes_per_point = attrs_per_point;
+    filtering::Workload workload(options);
 
     // Create filter
     filtering::BitsetFilter filter;
     
-    // Generate and add points
-    std::vector<std::vector<float>> points(num_points, std::vector<float>(dim));
-    
     std::cout << "Adding points and attributes...\n";
+    filter.addPoints(workload.attributeBatch());
     for (size_t i = 0; i < num_points; i++) {
-        // Generate random vector
-        for (size_t j = 0; j < dim; j++) {
-            points[i][j] = dis_vec(gen);
-        }
-        
-        // Add point to HNSW
-        alg_hnsw->addPoint(points[i].data(), i);
-        
-        // Add random attributes
-        std::vector<bool> used_attrs(num_attributes, false);
-        for (size_t j = 0; j < attrs_per_point; j++) {
-            unsigned int attr;
-            do {
-                attr = dis_attr(gen);
-            } while (used_attrs[attr]);
-            
-            used_attrs[attr] = true;
-            filter.addAttribute(i, attr);
-        }
+        alg_hnsw->addPoint(workload.vector(i), i);
         
         if (i % 1000 == 0) {
             std::cout << "Processed " << i << " points\n";
@@ -76,20 +61,24 @@ void runBitsetHNSWExample() {
     const size_t num_queries = 5;
     
     // Let's try different attribute combinations
-    std::vector<std::vector<unsigned int>> query_attributes = {
-        {0},                    // Single attribute
-        {0, 1},                // Two attributes
-        {0, 1, 2},             // Three attributes
-        {num_attributes - 1},   // Last attribute
-        {}                      // No attributes (should return nothing)
-    };
+    std::vector<filtering::QueryClass> query_classes(num_queries);
+    query_classes[0].min_selectivity = 0.05;  // Single popular attribute
+    query_classes[1].num_attributes = 2;      // Two attributes
+    query_classes[2].num_attributes = 3;      // Three attributes
+    query_classes[3].max_selectivity = 0.02;  // Rare attribute, matches far from the query
+    query_classes[3].locality = filtering::QueryLocality::AntiCorrelated;
+    query_classes[4].num_attributes = 0;      // No attributes (should return nothing)
+
+    std::vector<std::vector<unsigned int>> query_attributes;
+    std::vector<std::vector<float>> query_vectors;
+    for (size_t i = 0; i < num_queries; i++) {
+        auto generated = workload.generateQueries({query_classes[i]}, 1, i);
+        query_attributes.push_back(generated[0].attributes);
+        query_vectors.push_back(generated[0].vector);
+    }
     
     for (size_t i = 0; i < num_queries; i++) {
-        // Generate random query vector
-        std::vector<float> query(dim);
-        for (size_t j = 0; j < dim; j++) {
-            query[j] = dis_vec(gen);
-        }
+        const std::vector<float>& query = query_vectors[i];
         
         // Set query attributes
         filter.setQueryAttributes(query_attributes[i]);
@@ -115,16 +104,54 @@ void runBitsetHNSWExample() {
         while (!result.empty()) {
             auto& top_result = result.top();
             std::cout << "Point " << top_result.second << " (distance: " << top_result.first << "): ";
-            printPoint(points[top_result.second].data(), dim);
+            printPoint(workload.vector(top_result.second), dim);
             std::cout << "\n";
             result.pop();
         }
     }
     
+    // Compare the label-based filter path with the internal-id path
+    std::cout << "\nComparing filter paths...\n";
+    filter.alignWith(*alg_hnsw);
+    filtering::InternalIdFilter<filtering::BitsetFilter> internal_filter(filter, *alg_hnsw);
+
+    const size_t num_repeats = 50;
+    std::vector<std::vector<float>> bench_queries;
+    for (const auto& generated : workload.generateQueries({query_classes[4]}, num_repeats)) {
+        bench_queries.push_back(generated.vector);
+    }
+
+    double label_path_ms = 0;
+    double internal_path_ms = 0;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < num_queries; i++) {
+        filter.setQueryAttributes(query_attributes[i]);
+        for (const auto& q : bench_queries) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto by_label = alg_hnsw->searchKnn(q.data(), k, &filter);
+            auto mid = std::chrono::high_resolution_clock::now();
+            auto by_internal_id = alg_hnsw->searchKnnWithFilter(q.data(), k, &internal_filter);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            label_path_ms += std::chrono::duration<double, std::milli>(mid - start).count();
+            internal_path_ms += std::chrono::duration<double, std::milli>(end - mid).count();
+            if (by_label.size() != by_internal_id.size()) {
+                mismatches++;
+            }
+        }
+    }
+    const size_t num_runs = num_queries * num_repeats;
+    std::cout << "Label-based path: " << label_path_ms / num_runs << "ms per query\n"
+              << "Internal-id path: " << internal_path_ms / num_runs << "ms per query\n"
+              << "Speedup: " << label_path_ms / internal_path_ms << "x\n"
+              << "Result size mismatches: " << mismatches << "\n";
+
     // Print performance metrics
+    auto check_latency = filter.metrics().histogram(filtering::FilterOp::Query);
     std::cout << "\nPerformance Metrics:\n"
-              << "Average filter operation time: " << filter.getAverageOperationTimeMs() << "ms\n"
-              << "Total filter operations: " << filter.getTotalOperations() << "\n";
+              << "Sampled filter checks: " << check_latency.count() << "\n"
+              << "Filter check latency: mean " << check_latency.meanNs() << "ns, p50 <= "
+              << check_latency.percentileNs(50) << "ns, p99 <= " << check_latency.percentileNs(99) << "ns\n";
     
     delete alg_hnsw;
 }
@@ -1,7 +1,8 @@
 #include <iostream>
-#include <random>
 #include <chrono>
 #include "../src/core/naive_filter.h"
+#include "../src/core/index_builder.h"
+#include "../src/core/workload.h"
 #include "../external/hnswlib/hnswlib.h"
 
 void runHNSWExample() {
@@ -9,63 +10,53 @@ void runHNSWExample() {
     const size_t dim = 16;
     const size_t num_points = 10000;
     const size_t num_attributes = 1000;
-    const size_t max_attributes_per_point = 50;
+    const size_t attributes_per_point = 25;
     
     // Initialize HNSW index
     hnswlib::L2Space space(dim);
     auto* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, num_points);
     
-    // Initialize random number generators
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis_real(0, 1);
-    std::uniform_int_distribution<> dis_attr(0, num_attributes-1);
-    std::uniform_int_distribution<> dis_count(1, max_attributes_per_point);
+    // Clustered points with Zipfian attributes that follow the clusters; the
+    // workload keeps the points back to back and their attributes in CSR form
+    filtering::WorkloadOptions options;
+    options.dim = dim;
+    options.num_points = num_points;
+    options.num_attributes = num_attributes;
+    options.attributes_per_point = attributes_per_point;
+    filtering::Workload workload(options);
     
     // Create filter
     filtering::NaiveFilter filter;
     
-    // Generate and add points
-    std::vector<std::vector<float>> points(num_points, std::vector<float>(dim));
-    
+    // Insert vectors on all cores, then load the attributes on all cores
     std::cout << "Adding points and attributes...\n";
-    for (size_t i = 0; i < num_points; i++) {
-        // Generate random vector
-        for (size_t j = 0; j < dim; j++) {
-            points[i][j] = dis_real(gen);
-        }
-        
-        // Add point to HNSW
-        alg_hnsw->addPoint(points[i].data(), i);
-        
-        // Add random attributes
-        int num_attrs = dis_count(gen);
-        for (int j = 0; j < num_attrs; j++) {
-            filter.addAttribute(i, dis_attr(gen));
-        }
-        
-        if (i % 1000 == 0) {
-            std::cout << "Processed " << i << " points\n";
-        }
-    }
+    filtering::BuildOptions build_options;
+    build_options.progress_interval = 2000;
+    build_options.on_progress = [](const filtering::BuildProgress& progress) {
+        std::cout << "Processed " << progress.points_inserted << " points ("
+                  << static_cast<size_t>(progress.points_per_second) << " points/s)\n";
+    };
+    filtering::ParallelIndexBuilder<float> builder(*alg_hnsw, &filter, build_options);
+    filtering::AttributeBatch batch = workload.attributeBatch();
+    auto build = builder.add(workload.vectors().data(), workload.labels().data(), num_points, &batch);
+    std::cout << "Built in " << build.elapsed_seconds * 1000 << "ms\n";
     
     // Run queries with filter
     std::cout << "\nRunning queries...\n";
     const size_t num_queries = 100;
     const size_t k = 10;  // number of nearest neighbors
     
-    std::vector<unsigned int> query_attrs = {0, 1};  // Look for points with attributes 0 AND 1
-    filter.setQueryAttributes(query_attrs);
+    // Points with both of two attributes, near a random cluster
+    std::vector<filtering::QueryClass> mix(1);
+    mix[0].num_attributes = 2;
+    auto queries = workload.generateQueries(mix, num_queries);
     
     double total_query_time = 0;
     size_t total_results = 0;
     
     for (size_t i = 0; i < num_queries; i++) {
-        // Generate random query point
-        std::vector<float> query(dim);
-        for (size_t j = 0; j < dim; j++) {
-            query[j] = dis_real(gen);
-        }
+        const std::vector<float>& query = queries[i].vector;
+        filter.setQueryAttributes(queries[i].attributes);
         
         auto start = std::chrono::high_resolution_clock::now();
         auto result = alg_hnsw->searchKnn(query.data(), k, &filter);
@@ -81,8 +72,10 @@ void runHNSWExample() {
     std::cout << "\nResults:\n";
     std::cout << "Average query time: " << total_query_time / num_queries << "ms\n";
     std::cout << "Average results per query: " << static_cast<double>(total_results) / num_queries << "\n";
-    std::cout << "Filter average operation time: " << filter.getAverageOperationTimeMs() << "ms\n";
-    std::cout << "Total filter operations: " << filter.getTotalOperations() << "\n";
+    auto check_latency = filter.metrics().histogram(filtering::FilterOp::Query);
+    std::cout << "Sampled filter checks: " << check_latency.count() << "\n";
+    std::cout << "Filter check latency: mean " << check_latency.meanNs() << "ns, p99 <= "
+              << check_latency.percentileNs(99) << "ns\n";
     
     delete alg_hnsw;
 }
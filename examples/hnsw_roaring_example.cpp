@@ -1,8 +1,9 @@
 #include <iostream>
-#include <random>
 #include <chrono>
 #include <iomanip>
 #include "../src/core/roaring_filter.h"
+#include "../src/core/query_planner.h"
+#include "../src/core/workload.h"
 #include "../external/hnswlib/hnswlib.h"
 
 void printPoint(const float* point, size_t dim) {
@@ -31,42 +32,27 @@ void runRoaringHNSWExample() {
     // Initialize HNSW index
     hnswlib::L2Space space(dim);
     auto* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, num_points);
-    
-    // Initialize random generators
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis_vec(-1.0, 1.0);
-    std::uniform_int_distribution<> dis_attr(0, num_attributes-1);
+
+    // Clustered vectors with Zipfian attributes that follow the clusters
+    filtering::WorkloadOptions options;
+    options.dim = dim;
+    options.num_points = num_points;
+    options.num_clusters = 100;
+    options.num_attributes = num_attributes;
+    options.attributes_per_point = attrs_per_point;
+    options.cluster_correlation = 0.5;
+    std::cout << "Generating workload...\n";
+    filtering::Workload workload(options);
 
     // Create filter
     filtering::RoaringFilter filter;
     
-    // Generate and add points
-    std::vector<std::vector<float>> points(num_points, std::vector<float>(dim));
-    
     std::cout << "Adding points and attributes...\n";
     auto start_build = std::chrono::high_resolution_clock::now();
     
+    filter.addPoints(workload.attributeBatch());
     for (size_t i = 0; i < num_points; i++) {
-        // Generate random vector
-        for (size_t j = 0; j < dim; j++) {
-            points[i][j] = dis_vec(gen);
-        }
-        
-        // Add point to HNSW
-        alg_hnsw->addPoint(points[i].data(), i);
-        
-        // Add random attributes
-        std::vector<bool> used_attrs(num_attributes, false);
-        for (size_t j = 0; j < attrs_per_point; j++) {
-            unsigned int attr;
-            do {
-                attr = dis_attr(gen);
-            } while (used_attrs[attr]);
-            
-            used_attrs[attr] = true;
-            filter.addAttribute(i, attr);
-        }
+        alg_hnsw->addPoint(workload.vector(i), i);
         
         if (i % 10000 == 0) {
             std::cout << "Processed " << i << " points\n";
@@ -77,27 +63,34 @@ void runRoaringHNSWExample() {
     double build_time = std::chrono::duration<double>(end_build - start_build).count();
     std::cout << "Build time: " << build_time << " seconds\n";
     
-    // Run queries with different attribute combinations
+    // Run queries with different attribute combinations and localities
     std::cout << "\nRunning queries...\n";
     const size_t num_queries = 5;
     
-    std::vector<std::vector<unsigned int>> query_attributes = {
-        {0},                        // Single attribute
-        {0, 1},                    // Two attributes
-        {0, 1, 2},                 // Three attributes
-        {num_attributes - 1},       // Last attribute
-        {}                         // No attributes
-    };
+    std::vector<filtering::QueryClass> query_classes(num_queries);
+    query_classes[0].min_selectivity = 0.01;   // Single attribute, matches near the query
+    query_classes[0].locality = filtering::QueryLocality::Correlated;
+    query_classes[1].num_attributes = 2;       // Two attributes
+    query_classes[1].min_selectivity = 0.01;
+    query_classes[2].num_attributes = 3;       // Three attributes
+    query_classes[2].min_selectivity = 0.01;
+    query_classes[3].max_selectivity = 0.001;  // Rare attribute, matches far from the query
+    query_classes[3].locality = filtering::QueryLocality::AntiCorrelated;
+    query_classes[4].num_attributes = 0;       // No attributes
+
+    std::vector<std::vector<unsigned int>> query_attributes;
+    std::vector<std::vector<float>> query_vectors;
+    for (size_t i = 0; i < num_queries; i++) {
+        auto generated = workload.generateQueries({query_classes[i]}, 1, i);
+        query_attributes.push_back(generated[0].attributes);
+        query_vectors.push_back(generated[0].vector);
+    }
     
     double total_query_time = 0;
     size_t total_results = 0;
     
     for (size_t i = 0; i < num_queries; i++) {
-        // Generate random query vector
-        std::vector<float> query(dim);
-        for (size_t j = 0; j < dim; j++) {
-            query[j] = dis_vec(gen);
-        }
+        const std::vector<float>& query = query_vectors[i];
         
         // Set query attributes
         filter.setQueryAttributes(query_attributes[i]);
@@ -130,13 +123,75 @@ void runRoaringHNSWExample() {
         }
     }
     
+    // Compare the label-based filter path with the internal-id path
+    std::cout << "\nComparing filter paths...\n";
+    filter.alignWith(*alg_hnsw);
+    filtering::InternalIdFilter<filtering::RoaringFilter> internal_filter(filter, *alg_hnsw);
+
+    const size_t num_repeats = 50;
+    std::vector<std::vector<float>> bench_queries;
+    for (const auto& generated : workload.generateQueries({query_classes[4]}, num_repeats)) {
+        bench_queries.push_back(generated.vector);
+    }
+
+    double label_path_ms = 0;
+    double internal_path_ms = 0;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < num_queries; i++) {
+        filter.setQueryAttributes(query_attributes[i]);
+        for (const auto& q : bench_queries) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto by_label = alg_hnsw->searchKnn(q.data(), k, &filter);
+            auto mid = std::chrono::high_resolution_clock::now();
+            auto by_internal_id = alg_hnsw->searchKnnWithFilter(q.data(), k, &internal_filter);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            label_path_ms += std::chrono::duration<double, std::milli>(mid - start).count();
+            internal_path_ms += std::chrono::duration<double, std::milli>(end - mid).count();
+            if (by_label.size() != by_internal_id.size()) {
+                mismatches++;
+            }
+        }
+    }
+    const size_t num_runs = num_queries * num_repeats;
+    std::cout << "Label-based path: " << label_path_ms / num_runs << "ms per query\n"
+              << "Internal-id path: " << internal_path_ms / num_runs << "ms per query\n"
+              << "Speedup: " << label_path_ms / internal_path_ms << "x\n"
+              << "Result size mismatches: " << mismatches << "\n";
+
+    // Escalate ef only for queries that come back with fewer than k results
+    std::cout << "\nAdaptive ef for underfilled queries:\n";
+    for (size_t i = 0; i < num_queries; i++) {
+        filter.setQueryAttributes(query_attributes[i]);
+        size_t fixed_ef_results = alg_hnsw->searchKnnWithFilter(bench_queries[i].data(), k, &internal_filter).size();
+        size_t adaptive_results = alg_hnsw->searchKnnAdaptive(bench_queries[i].data(), k, &internal_filter,
+                                                              num_points * 10).size();
+        std::cout << "Query " << i + 1 << ": " << fixed_ef_results << " results with fixed ef, "
+                  << adaptive_results << " with adaptive ef\n";
+    }
+
+    // Let the planner pick between filtered HNSW and a brute-force scan
+    std::cout << "\nPlanned queries:\n";
+    filtering::QueryPlanner<float> planner(*alg_hnsw, filter);
+    for (size_t i = 0; i < num_queries; i++) {
+        filtering::PlanReport report;
+        auto result = planner.searchKnn(bench_queries[i].data(), k, query_attributes[i], &report);
+        std::cout << "Query " << i + 1 << ": "
+                  << (report.plan == filtering::SearchPlan::BruteForce ? "brute force" : "filtered HNSW")
+                  << (report.fell_back ? " (underfilled, scanned)" : "")
+                  << ", estimated selectivity " << report.estimated_selectivity
+                  << ", " << report.num_results << " results\n";
+    }
+
     // Print performance metrics
+    auto check_latency = filter.metrics().histogram(filtering::FilterOp::Query);
     std::cout << "\nPerformance Metrics:\n"
               << "Build time: " << build_time << " seconds\n"
               << "Average query time: " << total_query_time / num_queries << "ms\n"
               << "Average results per query: " << static_cast<double>(total_results) / num_queries << "\n"
-              << "Filter average operation time: " << filter.getAverageOperationTimeMs() << "ms\n"
-              << "Total filter operations: " << filter.getTotalOperations() << "\n"
+              << "Sampled filter checks: " << check_latency.count() << "\n"
+              << "Filter check latency: mean " << check_latency.meanNs() << "ns, p50 <= "
+              << check_latency.percentileNs(50) << "ns, p99 <= " << check_latency.percentileNs(99) << "ns\n"
               << "Total memory usage for attributes: " << filter.getMemoryUsage() / 1024.0 / 1024.0 << " MB\n";
     
     delete alg_hnsw;
@@ -115,7 +115,7 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
                 topResults.emplace(dist, label);
             }
         }
-        dist_t lastdist = topResults.empty() ? std::numeric_limits<dist_t>::max() : topResults.top().first;
+        dist_t lastdist = topResults.size() < k ? std::numeric_limits<dist_t>::max() : topResults.top().first;
         for (int i = k; i < cur_element_count; i++) {
             dist_t dist = fstdistfunc_(query_data, data_ + size_per_element_ * i, dist_func_param_);
             if (dist <= lastdist) {
@@ -126,7 +126,8 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
                 if (topResults.size() > k)
                     topResults.pop();
 
-                if (!topResults.empty()) {
+                // Until k elements passed the filter, any distance may still enter
+                if (topResults.size() == k) {
                     lastdist = topResults.top().first;
                 }
             }
@@ -1,19 +1,209 @@
 #pragma once
 
 #include "visited_list_pool.h"
+#include "mapped_file.h"
 #include "hnswlib.h"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
 #include <random>
 #include <stdlib.h>
 #include <assert.h>
 #include <unordered_set>
 #include <list>
 #include <memory>
+#include <thread>
+#include <exception>
+#include <type_traits>
 
 namespace hnswlib {
-typedef unsigned int tableint;
 typedef unsigned int linklistsizeint;
 
+// Search state kept by a thread across queries: the storage of the candidate
+// heaps, which keeps its capacity, and visited sets that are not taken from
+// the shared pool per query. The dense list is borrowed from the index's
+// pool for a whole batch and handed back afterwards. Each concurrent search
+// needs its own.
+template<typename dist_t>
+struct SearchScratch {
+    VisitedList *visited{nullptr};
+    VisitedHashSet compact_visited;
+    std::vector<std::pair<dist_t, tableint>> top_candidates;
+    std::vector<std::pair<dist_t, tableint>> candidate_set;
+    std::vector<tableint> two_hop;
+};
+
+// Threads shared by the searchKnnBatch calls of every index, one per core
+// besides the caller, started on first use. A call queues up to
+// num_workers - 1 tasks and works as worker 0 itself; once it is done, the
+// tasks no thread has started are withdrawn, so concurrent calls share the
+// threads and none waits for another's batch to finish.
+class BatchThreadPool {
+ public:
+    static BatchThreadPool &shared() {
+        static BatchThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    explicit BatchThreadPool(size_t num_threads) {
+        for (size_t t = 0; t < num_threads; t++) {
+            threads_.emplace_back([this]() { loop(); });
+        }
+    }
+
+    ~BatchThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    size_t size() const { return threads_.size(); }
+
+    // Calls job(worker) for worker 0 on this thread and, while pool threads
+    // are free, for workers 1 .. num_workers - 1 (at most size()) on them.
+    // Returns once none of them is running; job must not throw.
+    void run(size_t num_workers, const std::function<void(size_t)> &job) {
+        Call call{&job, 0};
+        size_t queued = std::min(num_workers, size() + 1) - 1;
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            for (size_t worker = 1; worker <= queued; worker++) {
+                tasks_.push_back(Task{&call, worker});
+            }
+            call.unfinished = queued;
+        }
+        if (queued > 0) wake_.notify_all();
+        job(0);
+
+        std::unique_lock<std::mutex> lock(lock_);
+        auto withdrawn = std::remove_if(tasks_.begin(), tasks_.end(),
+                                        [&](const Task &task) { return task.call == &call; });
+        call.unfinished -= tasks_.end() - withdrawn;
+        tasks_.erase(withdrawn, tasks_.end());
+        done_.wait(lock, [&]() { return call.unfinished == 0; });
+    }
+
+ private:
+    struct Call {
+        const std::function<void(size_t)> *job;
+        size_t unfinished;
+    };
+
+    struct Task {
+        Call *call;
+        size_t worker;
+    };
+
+    void loop() {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                wake_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+                if (stop_) return;
+                task = tasks_.front();
+                tasks_.pop_front();
+            }
+            (*task.call->job)(task.worker);
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                task.call->unfinished--;
+            }
+            done_.notify_all();
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::deque<Task> tasks_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    bool stop_{false};
+};
+
+// How base-layer searches remember the nodes they have seen
+enum class VisitedSetMode {
+    Dense,    // A max_elements array of tags (VisitedList)
+    Compact,  // A hash set sized to the search (VisitedHashSet)
+    Auto      // Compact for unfiltered searches expected to visit a tiny part of the index
+};
+
+// The two visited sets behind one interface for searchBaseLayerST
+struct DenseVisitedSet {
+    vl_type *mass;
+    vl_type tag;
+
+    bool contains(tableint id) const { return mass[id] == tag; }
+    // Marks id; false if it was already marked
+    bool insert(tableint id) {
+        if (mass[id] == tag) return false;
+        mass[id] = tag;
+        return true;
+    }
+    void prefetchList(tableint first) const {
+#ifdef USE_SSE
+        _mm_prefetch((char *) (mass + first), _MM_HINT_T0);
+        _mm_prefetch((char *) (mass + first + 64), _MM_HINT_T0);
+#endif
+    }
+    void prefetch(tableint id) const {
+#ifdef USE_SSE
+        _mm_prefetch((char *) (mass + id), _MM_HINT_T0);
+#endif
+    }
+};
+
+struct CompactVisitedSet {
+    VisitedHashSet &set;
+
+    bool contains(tableint id) const { return set.contains(id); }
+    bool insert(tableint id) { return set.insert(id); }
+    void prefetchList(tableint first) const { prefetch(first); }
+    void prefetch(tableint id) const {
+#ifdef USE_SSE
+        _mm_prefetch((const char *) set.slotOf(id), _MM_HINT_T0);
+#endif
+    }
+};
+
+// Cost of a single search, filled in when a search is given one. Counts add
+// up over every search it is passed to; call reset() in between to keep
+// them per query. Searches without one do no bookkeeping at all.
+struct SearchStats {
+    size_t hops = 0;                   // Neighbour lists expanded, upper layers included
+    size_t distance_computations = 0;  // Upper layers included
+    size_t filter_rejections = 0;      // Filter calls that returned false
+    size_t visited = 0;                // Base-layer nodes marked in the visited list
+    size_t heap_pushes = 0;            // Pushes to the candidate and result heaps
+    std::vector<double> layer_seconds; // Wall time per layer; [0] is the base layer
+
+    void reset() { *this = SearchStats(); }
+
+    SearchStats &operator+=(const SearchStats &other) {
+        hops += other.hops;
+        distance_computations += other.distance_computations;
+        filter_rejections += other.filter_rejections;
+        visited += other.visited;
+        heap_pushes += other.heap_pushes;
+        if (layer_seconds.size() < other.layer_seconds.size()) layer_seconds.resize(other.layer_seconds.size(), 0.0);
+        for (size_t level = 0; level < other.layer_seconds.size(); level++) layer_seconds[level] += other.layer_seconds[level];
+        return *this;
+    }
+
+    void addLayerTime(int level, std::chrono::steady_clock::time_point start) {
+        if (layer_seconds.size() <= (size_t) level) layer_seconds.resize(level + 1, 0.0);
+        layer_seconds[level] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
 template<typename dist_t>
 class HierarchicalNSW : public AlgorithmInterface<dist_t> {
  public:
@@ -25,6 +215,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     size_t size_data_per_element_{0};
     size_t size_links_per_element_{0};
     mutable std::atomic<size_t> num_deleted_{0};  // number of deleted elements
+    std::atomic<size_t> num_replaced_{0};  // deleted elements reused for new labels since built or loaded
     size_t M_{0};
     size_t maxM_{0};
     size_t maxM0_{0};
@@ -35,6 +226,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     int maxlevel_{0};
 
     std::unique_ptr<VisitedListPool> visited_list_pool_{nullptr};
+    VisitedSetMode visited_set_mode_{VisitedSetMode::Auto};
 
     // Locks operations with element by label value
     mutable std::vector<std::mutex> label_op_locks_;
@@ -51,6 +243,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     char **linkLists_{nullptr};
     std::vector<int> element_levels_;  // keeps level of each element
 
+    // Extra base-layer neighbours, followed by filtered searches only (see setExtraLinks).
+    // Links of internal id i are extra_links_[extra_link_offsets_[i] .. extra_link_offsets_[i + 1]).
+    std::vector<size_t> extra_link_offsets_;
+    std::vector<tableint> extra_links_;
+
+    // Set by loadMappedIndex: level 0 and the link lists then live in this file
+    std::unique_ptr<MappedFile> mapped_file_{nullptr};
+
+
     size_t data_size_{0};
 
     DISTFUNC<dist_t> fstdistfunc_;
@@ -62,9 +263,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     std::default_random_engine level_generator_;
     std::default_random_engine update_probability_generator_;
 
-    mutable std::atomic<long> metric_distance_computations{0};
-    mutable std::atomic<long> metric_hops{0};
-
     bool allow_replace_deleted_ = false;  // flag to replace deleted elements (marked as deleted) during insertions
 
     std::mutex deleted_elements_lock;  // lock for deleted_elements
@@ -149,16 +347,22 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
     void clear() {
-        free(data_level0_memory_);
-        data_level0_memory_ = nullptr;
-        for (tableint i = 0; i < cur_element_count; i++) {
-            if (element_levels_[i] > 0)
-                free(linkLists_[i]);
+        if (mapped_file_) {
+            mapped_file_.reset();
+        } else {
+            free(data_level0_memory_);
+            for (tableint i = 0; i < cur_element_count; i++) {
+                if (element_levels_[i] > 0)
+                    free(linkLists_[i]);
+            }
         }
+        data_level0_memory_ = nullptr;
         free(linkLists_);
         linkLists_ = nullptr;
         cur_element_count = 0;
+        num_replaced_ = 0;
         visited_list_pool_.reset(nullptr);
+        clearExtraLinks();
     }
 
 
@@ -175,6 +379,27 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    // Visited set of searchBaseLayerST; construction always uses the dense one
+    void setVisitedSetMode(VisitedSetMode mode) {
+        visited_set_mode_ = mode;
+    }
+
+
+    // Auto: a search visits about ef * maxM0_ nodes; the hash set wins when
+    // that is a sliver of a dense array too big to stay in cache. Below
+    // COMPACT_VISITED_MIN_ELEMENTS the dense array is cheaper regardless.
+    // Filtered searches can run far past ef before collecting ef allowed
+    // results, so they stay dense.
+    static const size_t COMPACT_VISITED_MIN_ELEMENTS = 1 << 19;
+
+    bool useCompactVisitedSet(size_t ef, bool filtered) const {
+        if (visited_set_mode_ != VisitedSetMode::Auto)
+            return visited_set_mode_ == VisitedSetMode::Compact;
+        return !filtered && ef > 0 && max_elements_ >= COMPACT_VISITED_MIN_ELEMENTS &&
+               ef * maxM0_ * 16 < max_elements_;
+    }
+
+
     inline std::mutex& getLabelOpMutex(labeltype label) const {
         // calculate hash
         size_t lock_id = label & (MAX_LABEL_OPERATION_LOCKS - 1);
@@ -210,18 +435,24 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         return (int) r;
     }
 
-    size_t getMaxElements() {
+    size_t getMaxElements() const {
         return max_elements_;
     }
 
-    size_t getCurrentElementCount() {
+    size_t getCurrentElementCount() const {
         return cur_element_count;
     }
 
-    size_t getDeletedCount() {
+    size_t getDeletedCount() const {
         return num_deleted_;
     }
 
+    // Changes whenever an internal id is handed to a different label (see addPoint
+    // with replace_deleted), so stores keyed by internal id can tell they are stale
+    size_t getReplacedCount() const {
+        return num_replaced_;
+    }
+
     std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
     searchBaseLayer(tableint ep_id, const void *data_point, int layer) {
         VisitedList *vl = visited_list_pool_->getFreeVisitedList();
@@ -305,39 +536,122 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    // Label-based filters see getExternalLabel(internal_id), internal-id filters see internal_id as is
+    template <typename filter_t>
+    inline bool isAllowedByFilter(filter_t* isIdAllowed, tableint internal_id) const {
+        if constexpr (std::is_base_of<BaseInternalFilterFunctor, filter_t>::value) {
+            return (*isIdAllowed)(internal_id);
+        } else {
+            return (*isIdAllowed)(getExternalLabel(internal_id));
+        }
+    }
+
+
+    // The container of a heap, to hand its storage back to a SearchScratch once drained
+    template <typename heap_t>
+    static typename heap_t::container_type &heapStorage(heap_t &heap) {
+        struct Access : heap_t {
+            static typename heap_t::container_type &of(heap_t &h) { return h.*&Access::c; }
+        };
+        return Access::of(heap);
+    }
+
+
     // bare_bone_search means there is no check for deletions and stop condition is ignored in return of extra performance
-    template <bool bare_bone_search = true, bool collect_metrics = false>
+    // traversal picks what filtered searches do with rejected neighbours (see FilterTraversal)
+    // scratch, if given, supplies the heap storage, the hash set, and the visited list when it
+    // holds one; otherwise the hash set is the thread's cached one (VisitedHashSetLease)
+    // collect_metrics adds the search's cost to stats, which must then be given
+    // The visited set follows setVisitedSetMode
+    template <bool bare_bone_search = true, bool collect_metrics = false, typename filter_t = BaseFilterFunctor>
     std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
     searchBaseLayerST(
         tableint ep_id,
         const void *data_point,
         size_t ef,
-        BaseFilterFunctor* isIdAllowed = nullptr,
-        BaseSearchStopCondition<dist_t>* stop_condition = nullptr) const {
-        VisitedList *vl = visited_list_pool_->getFreeVisitedList();
-        vl_type *visited_array = vl->mass;
-        vl_type visited_array_tag = vl->curV;
+        filter_t* isIdAllowed = nullptr,
+        BaseSearchStopCondition<dist_t>* stop_condition = nullptr,
+        FilterTraversal traversal = FilterTraversal::ScoreAll,
+        SearchScratch<dist_t>* scratch = nullptr,
+        SearchStats* stats = nullptr) const {
+        if (useCompactVisitedSet(ef, isIdAllowed != nullptr)) {
+            VisitedHashSetLease lease(scratch ? &scratch->compact_visited : nullptr);
+            lease.set().reset(ef * maxM0_);
+            CompactVisitedSet visited_set{lease.set()};
+            return searchBaseLayerWith<bare_bone_search, collect_metrics>(
+                visited_set, ep_id, data_point, ef, isIdAllowed, stop_condition, traversal, scratch, stats);
+        }
+        bool borrowed = scratch && scratch->visited;
+        VisitedList *vl = borrowed ? scratch->visited : visited_list_pool_->getFreeVisitedList();
+        if (borrowed) {
+            vl->reset();
+        }
+        DenseVisitedSet visited_set{vl->mass, vl->curV};
+        auto top_candidates = searchBaseLayerWith<bare_bone_search, collect_metrics>(
+            visited_set, ep_id, data_point, ef, isIdAllowed, stop_condition, traversal, scratch, stats);
+        if (!borrowed) {
+            visited_list_pool_->releaseVisitedList(vl);
+        }
+        return top_candidates;
+    }
+
+
+    // searchBaseLayerST over a given visited set
+    template <bool bare_bone_search, bool collect_metrics, typename filter_t, typename visited_set_t>
+    std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+    searchBaseLayerWith(
+        visited_set_t &visited_set,
+        tableint ep_id,
+        const void *data_point,
+        size_t ef,
+        filter_t* isIdAllowed,
+        BaseSearchStopCondition<dist_t>* stop_condition,
+        FilterTraversal traversal,
+        SearchScratch<dist_t>* scratch,
+        SearchStats* stats) const {
+        std::chrono::steady_clock::time_point start;
+        if (collect_metrics) {
+            start = std::chrono::steady_clock::now();
+        }
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidate_set;
+        if (scratch) {
+            heapStorage(top_candidates) = std::move(scratch->top_candidates);
+            heapStorage(candidate_set) = std::move(scratch->candidate_set);
+        }
 
         dist_t lowerBound;
+        size_t distance_computations = 0;
+        size_t hops = 0;
+        size_t filter_rejections = 0;
+        size_t visited = 1;
+        size_t heap_pushes = 0;
         if (bare_bone_search || 
-            (!isMarkedDeleted(ep_id) && ((!isIdAllowed) || (*isIdAllowed)(getExternalLabel(ep_id))))) {
+            (!isMarkedDeleted(ep_id) && ((!isIdAllowed) || isAllowedByFilter(isIdAllowed, ep_id)))) {
             char* ep_data = getDataByInternalId(ep_id);
             dist_t dist = fstdistfunc_(data_point, ep_data, dist_func_param_);
+            distance_computations++;
             lowerBound = dist;
             top_candidates.emplace(dist, ep_id);
             if (!bare_bone_search && stop_condition) {
                 stop_condition->add_point_to_result(getExternalLabel(ep_id), ep_data, dist);
             }
             candidate_set.emplace(-dist, ep_id);
+            heap_pushes += 2;
         } else {
+            // The entry point is only passed over when deleted or rejected by the filter
+            if (collect_metrics && isIdAllowed && !isMarkedDeleted(ep_id)) {
+                filter_rejections++;
+            }
             lowerBound = std::numeric_limits<dist_t>::max();
             candidate_set.emplace(-lowerBound, ep_id);
+            heap_pushes++;
         }
 
-        visited_array[ep_id] = visited_array_tag;
+        visited_set.insert(ep_id);
+        std::vector<tableint> own_two_hop;
+        std::vector<tableint> &two_hop = scratch ? scratch->two_hop : own_two_hop;
 
         while (!candidate_set.empty()) {
             std::pair<dist_t, tableint> current_node_pair = candidate_set.top();
@@ -361,32 +675,79 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             tableint current_node_id = current_node_pair.second;
             int *data = (int *) get_linklist0(current_node_id);
             size_t size = getListCount((linklistsizeint*)data);
+            // Extra links are visited after the regular ones, as if appended to the list
+            const tableint *extra = nullptr;
+            size_t num_extra = 0;
+            if (!bare_bone_search && isIdAllowed && current_node_id + 1 < extra_link_offsets_.size()) {
+                extra = extra_links_.data() + extra_link_offsets_[current_node_id];
+                num_extra = extra_link_offsets_[current_node_id + 1] - extra_link_offsets_[current_node_id];
+            }
 //                bool cur_node_deleted = isMarkedDeleted(current_node_id);
             if (collect_metrics) {
-                metric_hops++;
-                metric_distance_computations+=size;
+                hops++;
             }
+            // Allowed neighbours of rejected neighbours (TwoHop), visited after the list
+            two_hop.clear();
 
+            visited_set.prefetchList(*(data + 1));
 #ifdef USE_SSE
-            _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
-            _mm_prefetch((char *) (visited_array + *(data + 1) + 64), _MM_HINT_T0);
             _mm_prefetch(data_level0_memory_ + (*(data + 1)) * size_data_per_element_ + offsetData_, _MM_HINT_T0);
             _mm_prefetch((char *) (data + 2), _MM_HINT_T0);
 #endif
 
-            for (size_t j = 1; j <= size; j++) {
-                int candidate_id = *(data + j);
+            for (size_t j = 1; j <= size + num_extra + two_hop.size(); j++) {
+                int candidate_id = j <= size ? *(data + j)
+                                 : j <= size + num_extra ? extra[j - size - 1]
+                                 : two_hop[j - size - num_extra - 1];
 //                    if (candidate_id == 0) continue;
+                if (j < size) {
+                    visited_set.prefetch(*(data + j + 1));
 #ifdef USE_SSE
-                _mm_prefetch((char *) (visited_array + *(data + j + 1)), _MM_HINT_T0);
-                _mm_prefetch(data_level0_memory_ + (*(data + j + 1)) * size_data_per_element_ + offsetData_,
-                                _MM_HINT_T0);  ////////////
+                    _mm_prefetch(data_level0_memory_ + (*(data + j + 1)) * size_data_per_element_ + offsetData_,
+                                    _MM_HINT_T0);  ////////////
 #endif
-                if (!(visited_array[candidate_id] == visited_array_tag)) {
-                    visited_array[candidate_id] = visited_array_tag;
+                }
+                // Two-hop entries were marked visited and passed the filter when queued
+                bool from_two_hop = j > size + num_extra;
+                if (from_two_hop || visited_set.insert(candidate_id)) {
+                    if (collect_metrics && !from_two_hop) {
+                        visited++;
+                    }
+                    bool filter_passed = from_two_hop;
+                    if (!from_two_hop && !bare_bone_search && traversal != FilterTraversal::ScoreAll &&
+                        isIdAllowed && !top_candidates.empty()) {
+                        filter_passed = isAllowedByFilter(isIdAllowed, candidate_id);
+                        if (!filter_passed) {
+                            if (collect_metrics) {
+                                filter_rejections++;
+                            }
+                            if (traversal == FilterTraversal::TwoHop) {
+                                // Each neighbour is checked once and marked visited; only allowed ones
+                                // are queued, so the expansion stops at two hops
+                                linklistsizeint *rejected_list = get_linklist0(candidate_id);
+                                tableint *rejected_links = (tableint *) (rejected_list + 1);
+                                size_t rejected_size = getListCount(rejected_list);
+                                for (size_t l = 0; l < rejected_size; l++) {
+                                    tableint neighbour = rejected_links[l];
+                                    if (visited_set.insert(neighbour)) {
+                                        if (collect_metrics)
+                                            visited++;
+                                        if (isAllowedByFilter(isIdAllowed, neighbour))
+                                            two_hop.push_back(neighbour);
+                                        else if (collect_metrics)
+                                            filter_rejections++;
+                                    }
+                                }
+                            }
+                            continue;
+                        }
+                    }
 
                     char *currObj1 = (getDataByInternalId(candidate_id));
                     dist_t dist = fstdistfunc_(data_point, currObj1, dist_func_param_);
+                    if (collect_metrics) {
+                        distance_computations++;
+                    }
 
                     bool flag_consider_candidate;
                     if (!bare_bone_search && stop_condition) {
@@ -397,6 +758,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
                     if (flag_consider_candidate) {
                         candidate_set.emplace(-dist, candidate_id);
+                        if (collect_metrics) {
+                            heap_pushes++;
+                        }
 #ifdef USE_SSE
                         _mm_prefetch(data_level0_memory_ + candidate_set.top().second * size_data_per_element_ +
                                         offsetLevel0_,  ///////////
@@ -404,11 +768,17 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 #endif
 
                         if (bare_bone_search || 
-                            (!isMarkedDeleted(candidate_id) && ((!isIdAllowed) || (*isIdAllowed)(getExternalLabel(candidate_id))))) {
+                            (!isMarkedDeleted(candidate_id) &&
+                             ((!isIdAllowed) || filter_passed || isAllowedByFilter(isIdAllowed, candidate_id)))) {
                             top_candidates.emplace(dist, candidate_id);
+                            if (collect_metrics) {
+                                heap_pushes++;
+                            }
                             if (!bare_bone_search && stop_condition) {
                                 stop_condition->add_point_to_result(getExternalLabel(candidate_id), currObj1, dist);
                             }
+                        } else if (collect_metrics && isIdAllowed && !isMarkedDeleted(candidate_id)) {
+                            filter_rejections++;
                         }
 
                         bool flag_remove_extra = false;
@@ -435,7 +805,18 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             }
         }
 
-        visited_list_pool_->releaseVisitedList(vl);
+        if (scratch) {
+            scratch->candidate_set = std::move(heapStorage(candidate_set));
+            scratch->candidate_set.clear();
+        }
+        if (collect_metrics) {
+            stats->hops += hops;
+            stats->distance_computations += distance_computations;
+            stats->filter_rejections += filter_rejections;
+            stats->visited += visited;
+            stats->heap_pushes += heap_pushes;
+            stats->addLayerTime(0, start);
+        }
         return top_candidates;
     }
 
@@ -631,6 +1012,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     void resizeIndex(size_t new_max_elements) {
+        checkWritable();
         if (new_max_elements < cur_element_count)
             throw std::runtime_error("Cannot resize, max element is less than the current number of elements");
 
@@ -655,6 +1037,58 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         max_elements_ = new_max_elements;
     }
 
+    /*
+    * Sets extra base-layer links: links[i] are neighbours of internal id i that
+    * filtered searches follow in addition to its regular links, e.g. points that
+    * share a rare attribute (see filtering::addAttributeLinks). Unfiltered
+    * searches and inserts ignore them, and they are not saved with the index.
+    * Replaces any previous extra links; must not run concurrently with searches.
+    */
+    void setExtraLinks(const std::vector<std::vector<tableint>> &links) {
+        if (links.size() > cur_element_count)
+            throw std::runtime_error("Extra links given for elements that do not exist");
+        std::vector<size_t> offsets(links.size() + 1, 0);
+        for (size_t i = 0; i < links.size(); i++)
+            offsets[i + 1] = offsets[i] + links[i].size();
+        std::vector<tableint> flat;
+        flat.reserve(offsets.back());
+        for (const auto &neighbours : links) {
+            for (tableint neighbour : neighbours) {
+                if (neighbour >= cur_element_count)
+                    throw std::runtime_error("Extra link to an element that does not exist");
+                flat.push_back(neighbour);
+            }
+        }
+        extra_link_offsets_.swap(offsets);
+        extra_links_.swap(flat);
+    }
+
+    void clearExtraLinks() {
+        std::vector<size_t>().swap(extra_link_offsets_);
+        std::vector<tableint>().swap(extra_links_);
+    }
+
+    size_t getNumExtraLinks() const {
+        return extra_links_.size();
+    }
+
+    // Approximate bytes held in memory: vectors and graph, labels, per-element
+    // bookkeeping and extra links. Memory mapped by loadMappedIndex is not counted.
+    size_t memoryUsage() const {
+        size_t size = mapped_file_ ? 0 : max_elements_ * size_data_per_element_;
+        size += max_elements_ * (sizeof(void *) + sizeof(int) + sizeof(std::mutex));
+        if (!mapped_file_) {
+            for (size_t i = 0; i < cur_element_count; i++)
+                size += element_levels_[i] * size_links_per_element_;
+        }
+        {
+            std::unique_lock <std::mutex> lock_table(label_lookup_lock);
+            size += label_lookup_.size() * (sizeof(labeltype) + sizeof(tableint) + 2 * sizeof(void *));
+        }
+        size += extra_link_offsets_.capacity() * sizeof(size_t) + extra_links_.capacity() * sizeof(tableint);
+        return size;
+    }
+
     size_t indexFileSize() const {
         size_t size = 0;
         size += sizeof(offsetLevel0_);
@@ -822,6 +1256,218 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    /*
+    * Layout read by loadMappedIndex: the same header fields as saveIndex, level 0
+    * as one block at a 64-byte offset, then the upper-level link lists of all
+    * elements back to back, located through an offset table instead of being
+    * prefixed with their sizes.
+    */
+    static constexpr char MAPPED_INDEX_MAGIC[8] = {'H', 'N', 'S', 'W', 'M', 'A', 'P', '\0'};
+    static constexpr uint32_t MAPPED_INDEX_VERSION = 1;
+
+    void saveMappableIndex(const std::string &location) {
+        std::ofstream output(location, std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+
+        output.write(MAPPED_INDEX_MAGIC, sizeof(MAPPED_INDEX_MAGIC));
+        writeBinaryPOD(output, MAPPED_INDEX_VERSION);
+        writeBinaryPOD(output, offsetLevel0_);
+        writeBinaryPOD(output, max_elements_);
+        writeBinaryPOD(output, cur_element_count);
+        writeBinaryPOD(output, size_data_per_element_);
+        writeBinaryPOD(output, label_offset_);
+        writeBinaryPOD(output, offsetData_);
+        writeBinaryPOD(output, maxlevel_);
+        writeBinaryPOD(output, enterpoint_node_);
+        writeBinaryPOD(output, maxM_);
+
+        writeBinaryPOD(output, maxM0_);
+        writeBinaryPOD(output, M_);
+        writeBinaryPOD(output, mult_);
+        writeBinaryPOD(output, ef_construction_);
+
+        writePadding(output, 64);
+        output.write(data_level0_memory_, cur_element_count * size_data_per_element_);
+
+        writePadding(output, sizeof(uint64_t));
+        uint64_t offset = 0;
+        writeBinaryPOD(output, offset);
+        for (size_t i = 0; i < cur_element_count; i++) {
+            offset += element_levels_[i] > 0 ? size_links_per_element_ * element_levels_[i] : 0;
+            writeBinaryPOD(output, offset);
+        }
+        for (size_t i = 0; i < cur_element_count; i++) {
+            if (element_levels_[i] > 0)
+                output.write(linkLists_[i], size_links_per_element_ * element_levels_[i]);
+        }
+        if (!output)
+            throw std::runtime_error("Cannot write file");
+    }
+
+
+    /*
+    * Maps a file written by saveMappableIndex and searches it in place: nothing
+    * is copied except the label lookup and per-element levels. The index is
+    * read-only afterwards; adding, updating, deleting or resizing throws. The file is
+    * mapped read-only (MappedFile::Mode::ReadOnly), so it may be larger than RAM plus swap.
+    */
+    void loadMappedIndex(const std::string &location, SpaceInterface<dist_t> *s) {
+        std::unique_ptr<MappedFile> file(new MappedFile(location, MappedFile::Mode::ReadOnly));
+        auto corrupted = []() { return std::runtime_error("Index seems to be corrupted or unsupported"); };
+        size_t position = 0;
+        auto take = [&](size_t num_bytes, size_t alignment) {
+            size_t start = (position + alignment - 1) / alignment * alignment;
+            if (start > file->size() || num_bytes > file->size() - start)
+                throw corrupted();
+            position = start + num_bytes;
+            return file->data() + start;
+        };
+        auto read = [&](auto &podRef) {
+            memcpy(&podRef, take(sizeof(podRef), 1), sizeof(podRef));
+        };
+
+        char magic[sizeof(MAPPED_INDEX_MAGIC)];
+        uint32_t version;
+        read(magic);
+        read(version);
+        if (memcmp(magic, MAPPED_INDEX_MAGIC, sizeof(magic)) != 0 || version != MAPPED_INDEX_VERSION)
+            throw corrupted();
+
+        // Everything is read and checked before the current contents are dropped,
+        // so a bad file leaves the index as it was
+        size_t offset_level0, max_elements, element_count, size_data_per_element, label_offset, offset_data;
+        int maxlevel;
+        tableint enterpoint;
+        size_t max_m, max_m0, m, ef_construction;
+        double mult;
+        read(offset_level0);
+        read(max_elements);
+        read(element_count);
+        read(size_data_per_element);
+        read(label_offset);
+        read(offset_data);
+        read(maxlevel);
+        read(enterpoint);
+
+        read(max_m);
+        read(max_m0);
+        read(m);
+        read(mult);
+        read(ef_construction);
+
+        size_t data_size = s->get_data_size();
+        if (label_offset != offset_data + data_size)
+            throw std::runtime_error("Index was saved with a different space");
+
+        // The layout the constructor derives from M and the space
+        size_t size_links_per_element = max_m * sizeof(tableint) + sizeof(linklistsizeint);
+        size_t size_links_level0 = max_m0 * sizeof(tableint) + sizeof(linklistsizeint);
+        if (m == 0 || m > 10000 || max_m != m || max_m0 != 2 * m || offset_level0 != 0 ||
+            offset_data != size_links_level0 ||
+            size_data_per_element != size_links_level0 + data_size + sizeof(labeltype))
+            throw corrupted();
+        if (element_count > file->size() / size_data_per_element)
+            throw corrupted();
+        if (element_count > 0 && (enterpoint >= element_count || maxlevel < 0))
+            throw corrupted();
+
+        char *data_level0 = take(element_count * size_data_per_element, 64);
+        uint64_t *offsets = (uint64_t *) take((element_count + 1) * sizeof(uint64_t), sizeof(uint64_t));
+        char *link_lists = take(offsets[element_count], 1);
+
+        std::vector<int> element_levels(element_count);
+        std::vector<char *> link_list_of(element_count);
+        for (size_t i = 0; i < element_count; i++) {
+            uint64_t linkListSize = offsets[i + 1] - offsets[i];
+            if (offsets[i + 1] < offsets[i] || offsets[i + 1] > offsets[element_count] ||
+                linkListSize % size_links_per_element != 0)
+                throw corrupted();
+            element_levels[i] = (int) (linkListSize / size_links_per_element);
+            link_list_of[i] = linkListSize > 0 ? link_lists + offsets[i] : nullptr;
+        }
+        if (element_count > 0 && element_levels[enterpoint] < maxlevel)
+            throw corrupted();
+
+        // Every link must name an element that exists on that level
+        auto checkLinks = [&](linklistsizeint *list, size_t max_links, int level) {
+            size_t size = getListCount(list);
+            tableint *links = (tableint *) (list + 1);
+            if (size > max_links)
+                throw corrupted();
+            for (size_t j = 0; j < size; j++) {
+                if (links[j] >= element_count || element_levels[links[j]] < level)
+                    throw corrupted();
+            }
+        };
+        for (size_t i = 0; i < element_count; i++) {
+            checkLinks((linklistsizeint *) (data_level0 + i * size_data_per_element), max_m0, 0);
+            for (int level = 1; level <= element_levels[i]; level++) {
+                checkLinks((linklistsizeint *) (link_list_of[i] + (level - 1) * size_links_per_element), max_m,
+                           level);
+            }
+        }
+
+        char **link_list_table = (char **) malloc(sizeof(void *) * std::max<size_t>(element_count, 1));
+        if (link_list_table == nullptr)
+            throw std::runtime_error("Not enough memory: loadMappedIndex failed to allocate linklists");
+        if (element_count > 0)
+            memcpy(link_list_table, link_list_of.data(), sizeof(void *) * element_count);
+
+        clear();
+        label_lookup_.clear();
+        num_deleted_ = 0;
+        deleted_elements.clear();
+
+        offsetLevel0_ = offset_level0;
+        size_data_per_element_ = size_data_per_element;
+        label_offset_ = label_offset;
+        offsetData_ = offset_data;
+        maxlevel_ = maxlevel;
+        enterpoint_node_ = enterpoint;
+        maxM_ = max_m;
+        maxM0_ = max_m0;
+        M_ = m;
+        mult_ = mult;
+        ef_construction_ = ef_construction;
+        data_size_ = data_size;
+        fstdistfunc_ = s->get_dist_func();
+        dist_func_param_ = s->get_dist_func_param();
+        size_links_per_element_ = size_links_per_element;
+        size_links_level0_ = size_links_level0;
+
+        linkLists_ = link_list_table;
+        element_levels_ = std::move(element_levels);
+        data_level0_memory_ = data_level0;
+        mapped_file_ = std::move(file);
+        cur_element_count = element_count;
+        max_elements_ = element_count;
+
+        std::vector<std::mutex>(max_elements_).swap(link_list_locks_);
+        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+        visited_list_pool_.reset(new VisitedListPool(1, max_elements_));
+        revSize_ = 1.0 / mult_;
+        ef_ = 10;
+
+        for (size_t i = 0; i < cur_element_count; i++) {
+            label_lookup_[getExternalLabel(i)] = i;
+            if (isMarkedDeleted(i))
+                num_deleted_ += 1;
+        }
+    }
+
+
+    bool isReadOnly() const {
+        return mapped_file_ != nullptr;
+    }
+
+
+    void checkWritable() const {
+        if (mapped_file_)
+            throw std::runtime_error("Index is read-only: it was loaded with loadMappedIndex");
+    }
+
+
     template<typename data_t>
     std::vector<data_t> getDataByLabel(labeltype label) const {
         // lock all operations with element by label
@@ -871,6 +1517,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     * whereas maxM0_ has to be limited to the lower 16 bits, however, still large enough in almost all cases.
     */
     void markDeletedInternal(tableint internalId) {
+        checkWritable();
         assert(internalId < cur_element_count);
         if (!isMarkedDeleted(internalId)) {
             unsigned char *ll_cur = ((unsigned char *)get_linklist0(internalId))+2;
@@ -913,6 +1560,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     * Remove the deleted mark of the node.
     */
     void unmarkDeletedInternal(tableint internalId) {
+        checkWritable();
         assert(internalId < cur_element_count);
         if (isMarkedDeleted(internalId)) {
             unsigned char *ll_cur = ((unsigned char *)get_linklist0(internalId)) + 2;
@@ -984,6 +1632,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             std::unique_lock <std::mutex> lock_table(label_lookup_lock);
             label_lookup_.erase(label_replaced);
             label_lookup_[label] = internal_id_replaced;
+            num_replaced_++;
             lock_table.unlock();
 
             unmarkDeletedInternal(internal_id_replaced);
@@ -993,6 +1642,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     void updatePoint(const void *dataPoint, tableint internalId, float updateNeighborProbability) {
+        checkWritable();
         // update the feature vector associated with existing point with new vector
         memcpy(getDataByInternalId(internalId), dataPoint, data_size_);
 
@@ -1151,6 +1801,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     tableint addPoint(const void *data_point, labeltype label, int level) {
+        checkWritable();
         tableint cur_c = 0;
         {
             // Checking if the element with the same label already exists
@@ -1267,15 +1918,19 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
-    std::priority_queue<std::pair<dist_t, labeltype >>
-    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
-        std::priority_queue<std::pair<dist_t, labeltype >> result;
-        if (cur_element_count == 0) return result;
-
+    // Greedy descent through the upper layers; returns the entry point for the base layer
+    tableint searchUpperLayers(const void *query_data, SearchStats* stats = nullptr) const {
         tableint currObj = enterpoint_node_;
         dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        if (stats) {
+            stats->distance_computations++;
+        }
 
         for (int level = maxlevel_; level > 0; level--) {
+            std::chrono::steady_clock::time_point start;
+            if (stats) {
+                start = std::chrono::steady_clock::now();
+            }
             bool changed = true;
             while (changed) {
                 changed = false;
@@ -1283,8 +1938,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
                 data = (unsigned int *) get_linklist(currObj, level);
                 int size = getListCount(data);
-                metric_hops++;
-                metric_distance_computations+=size;
+                if (stats) {
+                    stats->hops++;
+                    stats->distance_computations += size;
+                }
 
                 tableint *datal = (tableint *) (data + 1);
                 for (int i = 0; i < size; i++) {
@@ -1300,16 +1957,90 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                     }
                 }
             }
+            if (stats) {
+                stats->addLayerTime(level, start);
+            }
+        }
+        return currObj;
+    }
+
+
+    // searchUpperLayers for num_queries queries at once. Queries standing on the
+    // same node scan its neighbour list together, so each neighbour's vector is
+    // fetched once for all of them; every query ends where it would alone.
+    void searchUpperLayersBatch(const void *const *queries, size_t num_queries,
+                                std::vector<tableint> &entry_points) const {
+        entry_points.assign(num_queries, enterpoint_node_);
+        std::vector<dist_t> curdist(num_queries);
+        char *ep_data = getDataByInternalId(enterpoint_node_);
+        for (size_t q = 0; q < num_queries; q++) {
+            curdist[q] = fstdistfunc_(queries[q], ep_data, dist_func_param_);
+        }
+
+        std::vector<size_t> active;
+        std::vector<size_t> order;
+        for (int level = maxlevel_; level > 0; level--) {
+            active.resize(num_queries);
+            for (size_t q = 0; q < num_queries; q++) active[q] = q;
+
+            while (!active.empty()) {
+                order.swap(active);
+                std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                    return entry_points[a] < entry_points[b];
+                });
+                active.clear();
+
+                for (size_t group = 0; group < order.size();) {
+                    tableint node = entry_points[order[group]];
+                    size_t group_end = group;
+                    while (group_end < order.size() && entry_points[order[group_end]] == node) group_end++;
+
+                    unsigned int *data = (unsigned int *) get_linklist(node, level);
+                    int size = getListCount(data);
+
+                    tableint *datal = (tableint *) (data + 1);
+                    for (int i = 0; i < size; i++) {
+                        tableint cand = datal[i];
+                        if (cand >= max_elements_)
+                            throw std::runtime_error("cand error");
+                        char *cand_data = getDataByInternalId(cand);
+                        for (size_t g = group; g < group_end; g++) {
+                            size_t q = order[g];
+                            dist_t d = fstdistfunc_(queries[q], cand_data, dist_func_param_);
+                            if (d < curdist[q]) {
+                                curdist[q] = d;
+                                entry_points[q] = cand;
+                            }
+                        }
+                    }
+                    for (size_t g = group; g < group_end; g++) {
+                        if (entry_points[order[g]] != node) active.push_back(order[g]);
+                    }
+                    group = group_end;
+                }
+            }
         }
+    }
+
 
+    // Base layer search from currObj, with the results turned into labels
+    template <typename filter_t>
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnnFrom(tableint currObj, const void *query_data, size_t k, filter_t* isIdAllowed,
+                  FilterTraversal traversal, SearchScratch<dist_t>* scratch = nullptr,
+                  SearchStats* stats = nullptr) const {
+        std::priority_queue<std::pair<dist_t, labeltype >> result;
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         bool bare_bone_search = !num_deleted_ && !isIdAllowed;
+        size_t ef = std::max(ef_, k);
         if (bare_bone_search) {
-            top_candidates = searchBaseLayerST<true>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+            top_candidates = stats
+                ? searchBaseLayerST<true, true>(currObj, query_data, ef, isIdAllowed, nullptr, traversal, scratch, stats)
+                : searchBaseLayerST<true>(currObj, query_data, ef, isIdAllowed, nullptr, traversal, scratch);
         } else {
-            top_candidates = searchBaseLayerST<false>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+            top_candidates = stats
+                ? searchBaseLayerST<false, true>(currObj, query_data, ef, isIdAllowed, nullptr, traversal, scratch, stats)
+                : searchBaseLayerST<false>(currObj, query_data, ef, isIdAllowed, nullptr, traversal, scratch);
         }
 
         while (top_candidates.size() > k) {
@@ -1320,47 +2051,174 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             result.push(std::pair<dist_t, labeltype>(rez.first, getExternalLabel(rez.second)));
             top_candidates.pop();
         }
+        if (scratch) {
+            scratch->top_candidates = std::move(heapStorage(top_candidates));
+        }
         return result;
     }
 
 
-    std::vector<std::pair<dist_t, labeltype >>
-    searchStopConditionClosest(
-        const void *query_data,
-        BaseSearchStopCondition<dist_t>& stop_condition,
-        BaseFilterFunctor* isIdAllowed = nullptr) const {
-        std::vector<std::pair<dist_t, labeltype >> result;
-        if (cur_element_count == 0) return result;
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        return searchKnnWithFilter(query_data, k, isIdAllowed);
+    }
 
-        tableint currObj = enterpoint_node_;
-        dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
 
-        for (int level = maxlevel_; level > 0; level--) {
-            bool changed = true;
-            while (changed) {
-                changed = false;
-                unsigned int *data;
+    // Same as above, but the filter is evaluated on internal ids; labels are only resolved for the results
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnn(const void *query_data, size_t k, BaseInternalFilterFunctor* isIdAllowed) const {
+        return searchKnnWithFilter(query_data, k, isIdAllowed);
+    }
 
-                data = (unsigned int *) get_linklist(currObj, level);
-                int size = getListCount(data);
-                metric_hops++;
-                metric_distance_computations+=size;
 
-                tableint *datal = (tableint *) (data + 1);
-                for (int i = 0; i < size; i++) {
-                    tableint cand = datal[i];
-                    if (cand < 0 || cand > max_elements_)
-                        throw std::runtime_error("cand error");
-                    dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
+    // Keeps searchKnn(query, k, nullptr) unambiguous next to the internal-id overload
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnn(const void *query_data, size_t k, std::nullptr_t) const {
+        return searchKnn(query_data, k, (BaseFilterFunctor*) nullptr);
+    }
 
-                    if (d < curdist) {
-                        curdist = d;
-                        currObj = cand;
-                        changed = true;
+
+    // Passing a final filter type lets the compiler devirtualize the filter call in the search loop.
+    // traversal applies per query: TwoHop saves the distance computations to rejected neighbours
+    // under restrictive filters, AllowedSubgraph only keeps recall when extra links connect the
+    // allowed elements (see setExtraLinks). stats, if given, receives the cost of the query.
+    template <typename filter_t>
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnnWithFilter(const void *query_data, size_t k, filter_t* isIdAllowed,
+                        FilterTraversal traversal = FilterTraversal::ScoreAll,
+                        SearchStats* stats = nullptr) const {
+        if (cur_element_count == 0) return std::priority_queue<std::pair<dist_t, labeltype >>();
+
+        tableint currObj = searchUpperLayers(query_data, stats);
+        return searchKnnFrom(currObj, query_data, k, isIdAllowed, traversal, nullptr, stats);
+    }
+
+
+    /*
+    * Searches a batch of queries on num_threads threads (0: one per core) and
+    * returns the results in query order. Workers take blocks of queries,
+    * descend the upper layers for a whole block at once (searchUpperLayersBatch)
+    * and keep one SearchScratch for all their queries, so the visited list pool
+    * and heap allocations are left out of the per-query path; each worker
+    * borrows one visited list from the pool per batch. The threads come from
+    * BatchThreadPool, shared by all indexes, so num_threads is capped at one
+    * per core. Concurrent calls run side by side.
+    * filters is empty or holds one filter per query; entries may be null.
+    */
+    template <typename filter_t = BaseFilterFunctor>
+    std::vector<std::priority_queue<std::pair<dist_t, labeltype >>>
+    searchKnnBatch(const std::vector<const void *> &queries, size_t k,
+                   const std::vector<filter_t *> &filters = {}, size_t num_threads = 0,
+                   FilterTraversal traversal = FilterTraversal::ScoreAll) const {
+        if (!filters.empty() && filters.size() != queries.size())
+            throw std::invalid_argument("searchKnnBatch needs one filter per query");
+        std::vector<std::priority_queue<std::pair<dist_t, labeltype >>> results(queries.size());
+        if (cur_element_count == 0 || queries.empty()) return results;
+
+        const size_t block_size = 16;
+        size_t num_blocks = (queries.size() + block_size - 1) / block_size;
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        std::atomic<size_t> next_block{0};
+        std::exception_ptr error;
+        std::mutex error_lock;
+        BatchThreadPool &pool = BatchThreadPool::shared();
+        std::vector<SearchScratch<dist_t>> worker_scratch(std::min(num_threads, pool.size() + 1));
+        std::function<void(size_t)> worker = [&](size_t w) {
+            if (next_block >= num_blocks) return;
+            SearchScratch<dist_t> &scratch = worker_scratch[w];
+            std::vector<tableint> entry_points;
+            try {
+                scratch.visited = visited_list_pool_->getFreeVisitedList();
+                for (size_t block = next_block++; block < num_blocks; block = next_block++) {
+                    size_t begin = block * block_size;
+                    size_t end = std::min(begin + block_size, queries.size());
+                    searchUpperLayersBatch(queries.data() + begin, end - begin, entry_points);
+                    for (size_t q = begin; q < end; q++) {
+                        results[q] = searchKnnFrom(entry_points[q - begin], queries[q], k,
+                                                   filters.empty() ? nullptr : filters[q], traversal, &scratch);
                     }
                 }
+            } catch (...) {
+                std::unique_lock<std::mutex> lock(error_lock);
+                if (!error) error = std::current_exception();
+                next_block = num_blocks;
             }
+            if (scratch.visited) {
+                visited_list_pool_->releaseVisitedList(scratch.visited);
+                scratch.visited = nullptr;
+            }
+        };
+
+        pool.run(worker_scratch.size(), worker);
+        if (error)
+            std::rethrow_exception(error);
+        return results;
+    }
+
+
+    /*
+    * Filtered search that escalates ef while fewer than k allowed results are found.
+    * ef starts at max(ef_, k) and doubles until k results are collected, ef covers the
+    * whole index, or the base layer spent max_distance_computations (0: no cap). Every
+    * attempt restarts the base layer from the entry point and re-scores what the earlier
+    * ones scored, so a query that escalates costs up to about twice its final attempt.
+    * Each attempt gets the budget the earlier ones left and stops mid-search once it is
+    * spent (BudgetSearchStopCondition), returning the best results so far; a query
+    * overshoots it by at most the entry point plus one neighbour list and that node's
+    * extra links. The budget counts this query's own distance computations only. stats,
+    * if given, receives the cost of every attempt.
+    */
+    template <typename filter_t>
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnnAdaptive(const void *query_data, size_t k, filter_t* isIdAllowed,
+                      size_t max_distance_computations = 0, SearchStats* stats = nullptr) const {
+        std::priority_queue<std::pair<dist_t, labeltype >> result;
+        if (cur_element_count == 0) return result;
+
+        tableint currObj = searchUpperLayers(query_data, stats);
+
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
+        size_t ef = std::max(ef_, k);
+        SearchStats base_layer;
+        while (true) {
+            BudgetSearchStopCondition<dist_t> budget(ef, max_distance_computations - base_layer.distance_computations);
+            top_candidates = searchBaseLayerST<false, true>(currObj, query_data, ef, isIdAllowed,
+                                                            max_distance_computations ? &budget : nullptr,
+                                                            FilterTraversal::ScoreAll, nullptr, &base_layer);
+
+            if (top_candidates.size() >= k || ef >= cur_element_count)
+                break;
+            if (max_distance_computations && base_layer.distance_computations >= max_distance_computations)
+                break;
+            ef = std::min(ef * 2, (size_t) cur_element_count);
         }
+        if (stats) {
+            *stats += base_layer;
+        }
+
+        while (top_candidates.size() > k) {
+            top_candidates.pop();
+        }
+        while (top_candidates.size() > 0) {
+            std::pair<dist_t, tableint> rez = top_candidates.top();
+            result.push(std::pair<dist_t, labeltype>(rez.first, getExternalLabel(rez.second)));
+            top_candidates.pop();
+        }
+        return result;
+    }
+
+
+    std::vector<std::pair<dist_t, labeltype >>
+    searchStopConditionClosest(
+        const void *query_data,
+        BaseSearchStopCondition<dist_t>& stop_condition,
+        BaseFilterFunctor* isIdAllowed = nullptr) const {
+        std::vector<std::pair<dist_t, labeltype >> result;
+        if (cur_element_count == 0) return result;
+
+        tableint currObj = searchUpperLayers(query_data);
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         top_candidates = searchBaseLayerST<false>(currObj, query_data, 0, isIdAllowed, &stop_condition);
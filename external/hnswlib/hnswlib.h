@@ -13,8 +13,14 @@
 #define USE_SSE
 #ifdef __AVX__
 #define USE_AVX
+#ifdef __AVX2__
+#define USE_AVX2
+#endif
 #ifdef __AVX512F__
 #define USE_AVX512
+#ifdef __AVX512BW__
+#define USE_AVX512BW
+#endif
 #endif
 #endif
 #endif
@@ -114,6 +120,26 @@ static bool AVX512Capable() {
     }
     return HW_AVX512F && avx512Supported;
 }
+
+// Integer 256-bit operations (gathers, epi16/epi32 arithmetic)
+static inline bool AVX2Capable() {
+    if (!AVXCapable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0, 0);
+    if (cpuInfo[0] < 0x00000007) return false;
+    cpuid(cpuInfo, 0x00000007, 0);
+    return (cpuInfo[1] & ((int)1 << 5)) != 0;
+}
+
+// Byte and word operations on 512-bit registers
+static inline bool AVX512BWCapable() {
+    if (!AVX512Capable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000007, 0);
+    return (cpuInfo[1] & ((int)1 << 30)) != 0;
+}
 #endif
 
 #include <queue>
@@ -123,6 +149,7 @@ static bool AVX512Capable() {
 
 namespace hnswlib {
 typedef size_t labeltype;
+typedef unsigned int tableint;
 
 // This can be extended to store state for filtering (e.g. from a std::set)
 class BaseFilterFunctor {
@@ -131,6 +158,22 @@ class BaseFilterFunctor {
     virtual ~BaseFilterFunctor() {};
 };
 
+// Filter that is handed internal ids instead of labels, so the search never
+// has to fetch a label from data_level0_memory_ to evaluate it
+class BaseInternalFilterFunctor {
+ public:
+    virtual bool operator()(hnswlib::tableint /*internal_id*/) { return true; }
+    virtual ~BaseInternalFilterFunctor() {};
+};
+
+// How a filtered search treats neighbours that fail the filter, once it has
+// found at least one element that passes
+enum class FilterTraversal {
+    ScoreAll,           // Compute their distance and use them to navigate
+    AllowedSubgraph,    // Skip them; needs extra links among the allowed elements
+    TwoHop              // Skip scoring them, and visit their allowed neighbours instead
+};
+
 template<typename dist_t>
 class BaseSearchStopCondition {
  public:
@@ -223,6 +266,8 @@ AlgorithmInterface<dist_t>::searchKnnCloserFirst(const void* query_data, size_t
 
 #include "space_l2.h"
 #include "space_ip.h"
+#include "space_sq8.h"
+#include "space_pq.h"
 #include "stop_condition.h"
 #include "bruteforce.h"
 #include "hnswalg.h"
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hnswlib {
+
+/*
+* Mapping of a whole file. Pages are shared with the page cache (and other
+* processes mapping the same file). A CopyOnWrite mapping can be written to;
+* written pages become private and the writes stay in this process, which is
+* why the kernel may charge the whole mapping against its commit limit. A
+* ReadOnly mapping is never charged, so it maps files larger than RAM plus
+* swap; writing through it faults.
+*/
+class MappedFile {
+ public:
+    enum class Mode {
+        CopyOnWrite,
+        ReadOnly
+    };
+
+    explicit MappedFile(const std::string &location, Mode mode = Mode::CopyOnWrite) {
+        const bool read_only = mode == Mode::ReadOnly;
+#ifdef _WIN32
+        file_ = CreateFileA(location.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            file_ = nullptr;
+            throw std::runtime_error("Cannot open file " + location);
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size)) {
+            close();
+            throw std::runtime_error("Cannot stat file " + location);
+        }
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0)
+            return;
+
+        mapping_ = CreateFileMappingA(file_, nullptr, read_only ? PAGE_READONLY : PAGE_WRITECOPY, 0, 0, nullptr);
+        if (mapping_ != nullptr)
+            data_ = static_cast<char *>(MapViewOfFile(mapping_, read_only ? FILE_MAP_READ : FILE_MAP_COPY, 0, 0, 0));
+        if (data_ == nullptr) {
+            close();
+            throw std::runtime_error("Cannot map file " + location);
+        }
+#else
+        int fd = open(location.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open file " + location);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat file " + location);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void *memory = read_only
+                ? mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0)
+                : mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (memory == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot map file " + location);
+            }
+            data_ = static_cast<char *>(memory);
+        }
+        // The mapping keeps the file alive
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Hints that the file will be read front to back: more readahead, and
+    // pages behind the reader are dropped first. No effect on Windows.
+    void adviseSequential() {
+#ifndef _WIN32
+        if (data_ != nullptr)
+            madvise(data_, size_, MADV_SEQUENTIAL);
+#endif
+    }
+
+    char *data() { return data_; }
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+ private:
+    void close() {
+#ifdef _WIN32
+        if (data_ != nullptr) UnmapViewOfFile(data_);
+        if (mapping_ != nullptr) CloseHandle(mapping_);
+        if (file_ != nullptr) CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = nullptr;
+#else
+        if (data_ != nullptr)
+            munmap(data_, size_);
+#endif
+        data_ = nullptr;
+    }
+
+    char *data_{nullptr};
+    size_t size_{0};
+#ifdef _WIN32
+    HANDLE file_{nullptr};
+    HANDLE mapping_{nullptr};
+#endif
+};
+
+
+/*
+* Writes zero bytes up to the next multiple of alignment from the start of the
+* stream, so that data written next can be used in place once mapped.
+*/
+inline void writePadding(std::ostream &out, size_t alignment) {
+    static const char zeros[64] = {};
+    size_t position = static_cast<size_t>(out.tellp());
+    out.write(zeros, (alignment - position % alignment) % alignment);
+}
+}  // namespace hnswlib
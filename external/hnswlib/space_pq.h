@@ -0,0 +1,312 @@
+#pragma once
+#include "hnswlib.h"
+#include "space_l2.h"
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string.h>
+
+namespace hnswlib {
+
+// Product quantization: a vector is cut into m sub-vectors of dsub = dim / m
+// components, and each sub-vector is stored as the index of its nearest
+// centroid among PQ_CENTROIDS learned for that subspace.
+//
+// Stored points are [PQ_CODE_TAG][m codes][zero padding], padded to a whole
+// number of tableints so that the link lists HNSW stores after each point
+// stay aligned. Queries are distance tables built
+// once per query by PQSpace::makeQuery, [PQ_QUERY_TAG][m x PQ_CENTROIDS floats],
+// and the distance to a point is the sum of m table entries (asymmetric
+// distance, ADC). Between two stored points, as during construction, the
+// distance sums entries of a precomputed centroid-to-centroid table instead
+// (symmetric distance, SDC). The tag in the first byte of the left operand
+// tells the two apart; the right operand is always a stored point.
+static const size_t PQ_CENTROIDS = 256;
+static const unsigned char PQ_CODE_TAG = 0;
+static const unsigned char PQ_QUERY_TAG = 1;
+
+struct PQParams {
+    size_t m;
+    const float *sdc_table;     // m x PQ_CENTROIDS x PQ_CENTROIDS
+    DISTFUNC<float> adc_func;   // Table-sum kernel, called with (table, codes)
+};
+
+static float
+PQTableSum(const void *pTablev, const void *pCodesv, const void *params_ptr) {
+    const float *pTable = (const float *) pTablev;
+    const unsigned char *pCodes = (const unsigned char *) pCodesv;
+    size_t m = ((const PQParams *) params_ptr)->m;
+
+    float res = 0;
+    for (size_t j = 0; j < m; j++) {
+        res += pTable[j * PQ_CENTROIDS + pCodes[j]];
+    }
+    return res;
+}
+
+#if defined(USE_AVX512)
+
+// Gathers the table entries of 16 subspaces at a time
+static float
+PQTableSumAVX512(const void *pTablev, const void *pCodesv, const void *params_ptr) {
+    const float *pTable = (const float *) pTablev;
+    const unsigned char *pCodes = (const unsigned char *) pCodesv;
+    size_t m = ((const PQParams *) params_ptr)->m;
+    size_t m16 = m >> 4 << 4;
+
+    const __m512i row = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                           _mm512_set1_epi32(PQ_CENTROIDS));
+    __m512 sum = _mm512_setzero_ps();
+    for (size_t j = 0; j < m16; j += 16) {
+        __m512i index = _mm512_add_epi32(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (pCodes + j))), row);
+        sum = _mm512_add_ps(sum, _mm512_i32gather_ps(index, pTable + j * PQ_CENTROIDS, 4));
+    }
+
+    float PORTABLE_ALIGN64 TmpRes[16];
+    _mm512_store_ps(TmpRes, sum);
+    float res = 0;
+    for (size_t i = 0; i < 16; i++)
+        res += TmpRes[i];
+    for (size_t j = m16; j < m; j++)
+        res += pTable[j * PQ_CENTROIDS + pCodes[j]];
+    return res;
+}
+#endif
+
+#if defined(USE_AVX2)
+
+// Gathers the table entries of 8 subspaces at a time
+static float
+PQTableSumAVX2(const void *pTablev, const void *pCodesv, const void *params_ptr) {
+    const float *pTable = (const float *) pTablev;
+    const unsigned char *pCodes = (const unsigned char *) pCodesv;
+    size_t m = ((const PQParams *) params_ptr)->m;
+    size_t m8 = m >> 3 << 3;
+
+    const __m256i row = _mm256_setr_epi32(0, PQ_CENTROIDS, 2 * PQ_CENTROIDS, 3 * PQ_CENTROIDS, 4 * PQ_CENTROIDS,
+                                          5 * PQ_CENTROIDS, 6 * PQ_CENTROIDS, 7 * PQ_CENTROIDS);
+    __m256 sum = _mm256_setzero_ps();
+    for (size_t j = 0; j < m8; j += 8) {
+        __m256i index = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (pCodes + j))), row);
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(pTable + j * PQ_CENTROIDS, index, 4));
+    }
+
+    float PORTABLE_ALIGN32 TmpRes[8];
+    _mm256_store_ps(TmpRes, sum);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+    for (size_t j = m8; j < m; j++)
+        res += pTable[j * PQ_CENTROIDS + pCodes[j]];
+    return res;
+}
+#endif
+
+static float
+PQDistance(const void *pVect1v, const void *pVect2v, const void *params_ptr) {
+    const unsigned char *pVect1 = (const unsigned char *) pVect1v;
+    const unsigned char *pCodes = (const unsigned char *) pVect2v + 1;
+    const PQParams *params = (const PQParams *) params_ptr;
+
+    if (pVect1[0] == PQ_QUERY_TAG) {
+        return params->adc_func((const float *) pVect1v + 1, pCodes, params_ptr);
+    }
+
+    const unsigned char *pOther = pVect1 + 1;
+    const float *table = params->sdc_table;
+    float res = 0;
+    for (size_t j = 0; j < params->m; j++) {
+        res += table[(j * PQ_CENTROIDS + pOther[j]) * PQ_CENTROIDS + pCodes[j]];
+    }
+    return res;
+}
+
+
+/*
+* Squared L2 over product-quantized points: m + 1 bytes per point, padded
+* to a multiple of sizeof(tableint). Train the
+* codebooks with PQSpace::train, add points encoded with encode, and search
+* with the table from makeQuery as query data. Distances are approximate;
+* re-rank the results with rerankL2 against the float vectors when exact
+* ordering matters.
+*/
+class PQSpace : public SpaceInterface<float> {
+    size_t dim_;
+    size_t m_;
+    size_t dsub_;
+    size_t data_size_;                  // 1 + m, padded to whole tableints
+    std::vector<float> centroids_;      // m x PQ_CENTROIDS x dsub
+    std::vector<float> transposed_;     // m x dsub x PQ_CENTROIDS
+    std::vector<float> sdc_table_;
+    PQParams params_;
+
+ public:
+    // centroids holds m x PQ_CENTROIDS sub-vectors of dim / m components
+    PQSpace(size_t dim, size_t m, std::vector<float> centroids)
+        : dim_(dim), m_(m),
+          data_size_((1 + m + sizeof(tableint) - 1) / sizeof(tableint) * sizeof(tableint)),
+          centroids_(std::move(centroids)) {
+        if (m == 0 || dim % m != 0)
+            throw std::invalid_argument("PQSpace needs dim to be a multiple of m");
+        dsub_ = dim / m;
+        if (centroids_.size() != m * PQ_CENTROIDS * dsub_)
+            throw std::invalid_argument("PQSpace needs m x 256 centroids of dim / m components");
+
+        transposed_.resize(centroids_.size());
+        for (size_t j = 0; j < m; j++) {
+            for (size_t c = 0; c < PQ_CENTROIDS; c++) {
+                for (size_t d = 0; d < dsub_; d++) {
+                    transposed_[(j * dsub_ + d) * PQ_CENTROIDS + c] = centroid(j, c)[d];
+                }
+            }
+        }
+
+        sdc_table_.resize(m * PQ_CENTROIDS * PQ_CENTROIDS);
+        L2Space sub_space(dsub_);
+        DISTFUNC<float> sub_dist = sub_space.get_dist_func();
+        for (size_t j = 0; j < m; j++) {
+            for (size_t a = 0; a < PQ_CENTROIDS; a++) {
+                for (size_t b = 0; b < PQ_CENTROIDS; b++) {
+                    sdc_table_[(j * PQ_CENTROIDS + a) * PQ_CENTROIDS + b] =
+                        sub_dist(centroid(j, a), centroid(j, b), sub_space.get_dist_func_param());
+                }
+            }
+        }
+
+        params_.m = m;
+        params_.adc_func = PQTableSum;
+#if defined(USE_AVX512)
+        if (m >= 16 && AVX512Capable())
+            params_.adc_func = PQTableSumAVX512;
+        else if (m >= 8 && AVX2Capable())
+            params_.adc_func = PQTableSumAVX2;
+#elif defined(USE_AVX2)
+        if (m >= 8 && AVX2Capable())
+            params_.adc_func = PQTableSumAVX2;
+#endif
+    }
+
+    // Learns the codebooks with iterations of k-means per subspace over
+    // num_vectors training vectors, starting from randomly sampled ones
+    static PQSpace train(size_t dim, size_t m, const float *vectors, size_t num_vectors,
+                         size_t iterations = 10, unsigned int seed = 100) {
+        if (m == 0 || dim % m != 0)
+            throw std::invalid_argument("PQSpace needs dim to be a multiple of m");
+        if (num_vectors == 0)
+            throw std::invalid_argument("PQSpace needs training vectors");
+        size_t dsub = dim / m;
+        L2Space sub_space(dsub);
+        DISTFUNC<float> sub_dist = sub_space.get_dist_func();
+
+        std::vector<float> centroids(m * PQ_CENTROIDS * dsub);
+        std::vector<float> sub_vectors(num_vectors * dsub);
+        std::vector<size_t> assignment(num_vectors);
+        std::vector<size_t> counts(PQ_CENTROIDS);
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<size_t> dis(0, num_vectors - 1);
+
+        for (size_t j = 0; j < m; j++) {
+            for (size_t i = 0; i < num_vectors; i++) {
+                memcpy(&sub_vectors[i * dsub], vectors + i * dim + j * dsub, dsub * sizeof(float));
+            }
+            float *codebook = &centroids[j * PQ_CENTROIDS * dsub];
+            for (size_t c = 0; c < PQ_CENTROIDS; c++) {
+                memcpy(codebook + c * dsub, &sub_vectors[dis(gen) * dsub], dsub * sizeof(float));
+            }
+
+            for (size_t iteration = 0; iteration < iterations; iteration++) {
+                for (size_t i = 0; i < num_vectors; i++) {
+                    assignment[i] = nearest(codebook, &sub_vectors[i * dsub], dsub, sub_dist,
+                                            sub_space.get_dist_func_param());
+                }
+                // Empty clusters keep their previous centroid
+                std::fill(counts.begin(), counts.end(), 0);
+                std::vector<float> sums(PQ_CENTROIDS * dsub, 0.0f);
+                for (size_t i = 0; i < num_vectors; i++) {
+                    counts[assignment[i]]++;
+                    for (size_t d = 0; d < dsub; d++) sums[assignment[i] * dsub + d] += sub_vectors[i * dsub + d];
+                }
+                for (size_t c = 0; c < PQ_CENTROIDS; c++) {
+                    if (counts[c] == 0) continue;
+                    for (size_t d = 0; d < dsub; d++) codebook[c * dsub + d] = sums[c * dsub + d] / counts[c];
+                }
+            }
+        }
+        return PQSpace(dim, m, std::move(centroids));
+    }
+
+    // code must hold get_data_size() bytes
+    void encode(const float *vector, unsigned char *code) const {
+        L2Space sub_space(dsub_);
+        DISTFUNC<float> sub_dist = sub_space.get_dist_func();
+        code[0] = PQ_CODE_TAG;
+        for (size_t j = 0; j < m_; j++) {
+            code[1 + j] = (unsigned char) nearest(centroid(j, 0), vector + j * dsub_, dsub_, sub_dist,
+                                                  sub_space.get_dist_func_param());
+        }
+        memset(code + 1 + m_, 0, data_size_ - 1 - m_);
+    }
+
+    void decode(const unsigned char *code, float *vector) const {
+        for (size_t j = 0; j < m_; j++) {
+            memcpy(vector + j * dsub_, centroid(j, code[1 + j]), dsub_ * sizeof(float));
+        }
+    }
+
+    // Distance table of a query, to pass as query data to searchKnn
+    std::vector<float> makeQuery(const float *query) const {
+        std::vector<float> table(1 + m_ * PQ_CENTROIDS);
+        *(unsigned char *) table.data() = PQ_QUERY_TAG;
+
+        // Sub-vectors are only a few components long, so the loop runs over
+        // the centroids of the transposed codebooks, which vectorizes
+        const float *codebook = transposed_.data();
+        for (size_t j = 0; j < m_; j++) {
+            float row[PQ_CENTROIDS] = {};
+            for (size_t d = 0; d < dsub_; d++) {
+                float component = query[j * dsub_ + d];
+                for (size_t c = 0; c < PQ_CENTROIDS; c++) {
+                    float t = component - codebook[c];
+                    row[c] += t * t;
+                }
+                codebook += PQ_CENTROIDS;
+            }
+            memcpy(&table[1 + j * PQ_CENTROIDS], row, sizeof(row));
+        }
+        return table;
+    }
+
+    const float *centroid(size_t subspace, size_t c) const {
+        return &centroids_[(subspace * PQ_CENTROIDS + c) * dsub_];
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return PQDistance;
+    }
+
+    void *get_dist_func_param() {
+        params_.sdc_table = sdc_table_.data();
+        return &params_;
+    }
+
+    ~PQSpace() {}
+
+ private:
+    static size_t nearest(const float *codebook, const float *sub_vector, size_t dsub, DISTFUNC<float> sub_dist,
+                          void *sub_param) {
+        size_t best = 0;
+        float best_dist = std::numeric_limits<float>::max();
+        for (size_t c = 0; c < PQ_CENTROIDS; c++) {
+            float dist = sub_dist(sub_vector, codebook + c * dsub, sub_param);
+            if (dist < best_dist) {
+                best_dist = dist;
+                best = c;
+            }
+        }
+        return best;
+    }
+};
+
+}  // namespace hnswlib
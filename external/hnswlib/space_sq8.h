@@ -0,0 +1,213 @@
+#pragma once
+#include "hnswlib.h"
+#include "space_l2.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+namespace hnswlib {
+
+// Uniform 8-bit scalar quantization: every component x in [min, max] is
+// stored as the code round((x - min) / step), step = (max - min) / 255.
+// The squared L2 distance between two code vectors, times step^2, then
+// approximates the one between the original vectors in the same units.
+struct SQ8Params {
+    size_t dim;
+    float step_sq;
+};
+
+static float
+SQ8L2Sqr(const void *pVect1v, const void *pVect2v, const void *params_ptr) {
+    const unsigned char *pVect1 = (const unsigned char *) pVect1v;
+    const unsigned char *pVect2 = (const unsigned char *) pVect2v;
+    const SQ8Params *params = (const SQ8Params *) params_ptr;
+
+    int res = 0;
+    for (size_t i = 0; i < params->dim; i++) {
+        int t = (int) pVect1[i] - (int) pVect2[i];
+        res += t * t;
+    }
+    return res * params->step_sq;
+}
+
+#if defined(USE_AVX2) || defined(USE_AVX512BW)
+
+// Sum of squared code differences over components [begin, qty)
+static int
+SQ8L2SqrResiduals(const unsigned char *pVect1, const unsigned char *pVect2, size_t begin, size_t qty) {
+    int res = 0;
+    for (size_t i = begin; i < qty; i++) {
+        int t = (int) pVect1[i] - (int) pVect2[i];
+        res += t * t;
+    }
+    return res;
+}
+#endif
+
+#if defined(USE_AVX512BW)
+
+// Widens 32 codes at a time to int16 and accumulates squared differences in
+// int32 lanes with madd; each step adds at most 2 * 255^2 to a lane.
+static float
+SQ8L2SqrAVX512(const void *pVect1v, const void *pVect2v, const void *params_ptr) {
+    const unsigned char *pVect1 = (const unsigned char *) pVect1v;
+    const unsigned char *pVect2 = (const unsigned char *) pVect2v;
+    const SQ8Params *params = (const SQ8Params *) params_ptr;
+    size_t qty32 = params->dim >> 5;
+
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < qty32; i++) {
+        __m512i v1 = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *) (pVect1 + (i << 5))));
+        __m512i v2 = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *) (pVect2 + (i << 5))));
+        __m512i diff = _mm512_sub_epi16(v1, v2);
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(diff, diff));
+    }
+
+    int PORTABLE_ALIGN64 TmpRes[16];
+    _mm512_store_si512((__m512i *) TmpRes, sum);
+    int res = SQ8L2SqrResiduals(pVect1, pVect2, qty32 << 5, params->dim);
+    for (size_t i = 0; i < 16; i++)
+        res += TmpRes[i];
+    return res * params->step_sq;
+}
+#endif
+
+#if defined(USE_AVX2)
+
+static float
+SQ8L2SqrAVX2(const void *pVect1v, const void *pVect2v, const void *params_ptr) {
+    const unsigned char *pVect1 = (const unsigned char *) pVect1v;
+    const unsigned char *pVect2 = (const unsigned char *) pVect2v;
+    const SQ8Params *params = (const SQ8Params *) params_ptr;
+    size_t qty32 = params->dim >> 5;
+
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty32; i++) {
+        __m256i v1 = _mm256_loadu_si256((const __m256i *) (pVect1 + (i << 5)));
+        __m256i v2 = _mm256_loadu_si256((const __m256i *) (pVect2 + (i << 5)));
+        __m256i diff_lo = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(v1)),
+                                           _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v2)));
+        __m256i diff_hi = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(v1, 1)),
+                                           _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v2, 1)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(diff_lo, diff_lo));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(diff_hi, diff_hi));
+    }
+
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_hadd_epi32(sum128, sum128);
+    sum128 = _mm_hadd_epi32(sum128, sum128);
+    int res = _mm_cvtsi128_si32(sum128) + SQ8L2SqrResiduals(pVect1, pVect2, qty32 << 5, params->dim);
+    return res * params->step_sq;
+}
+#endif
+
+
+/*
+* Squared L2 over 8-bit codes: one byte per component instead of four, so
+* level 0 of a 128-dim index shrinks from 512 to 128 bytes of vector per
+* element. Vectors are encoded before addPoint and queries before search;
+* re-rank the results with rerankL2 against the float vectors to recover
+* the precision lost to quantization. Codes are zero-padded to a whole
+* number of tableints, which keeps the link lists HNSW stores after each
+* point aligned; encode into buffers of get_data_size() bytes.
+*/
+class SQ8Space : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    SQ8Params params_;
+    size_t data_size_;  // dim, padded to whole tableints
+    float min_;
+    float step_;
+
+ public:
+    SQ8Space(size_t dim, float min_value, float max_value) {
+        if (!(max_value > min_value))
+            throw std::invalid_argument("SQ8Space needs max_value > min_value");
+        min_ = min_value;
+        step_ = (max_value - min_value) / 255.0f;
+        params_.dim = dim;
+        data_size_ = (dim + sizeof(tableint) - 1) / sizeof(tableint) * sizeof(tableint);
+        params_.step_sq = step_ * step_;
+
+        fstdistfunc_ = SQ8L2Sqr;
+#if defined(USE_AVX512BW)
+        if (dim >= 32 && AVX512BWCapable())
+            fstdistfunc_ = SQ8L2SqrAVX512;
+        else if (dim >= 32 && AVX2Capable())
+            fstdistfunc_ = SQ8L2SqrAVX2;
+#elif defined(USE_AVX2)
+        if (dim >= 32 && AVX2Capable())
+            fstdistfunc_ = SQ8L2SqrAVX2;
+#endif
+    }
+
+    // Range from the smallest and largest component of num_vectors sample vectors
+    static SQ8Space train(size_t dim, const float *vectors, size_t num_vectors) {
+        float min_value = std::numeric_limits<float>::max();
+        float max_value = std::numeric_limits<float>::lowest();
+        for (size_t i = 0; i < dim * num_vectors; i++) {
+            min_value = std::min(min_value, vectors[i]);
+            max_value = std::max(max_value, vectors[i]);
+        }
+        if (!(max_value > min_value))
+            max_value = min_value + 1.0f;
+        return SQ8Space(dim, min_value, max_value);
+    }
+
+    // Components outside the trained range are clamped to it
+    void encode(const float *vector, unsigned char *code) const {
+        for (size_t i = 0; i < params_.dim; i++) {
+            float level = std::round((vector[i] - min_) / step_);
+            code[i] = (unsigned char) std::min(255.0f, std::max(0.0f, level));
+        }
+        memset(code + params_.dim, 0, data_size_ - params_.dim);
+    }
+
+    void decode(const unsigned char *code, float *vector) const {
+        for (size_t i = 0; i < params_.dim; i++) {
+            vector[i] = min_ + code[i] * step_;
+        }
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &params_;
+    }
+
+    ~SQ8Space() {}
+};
+
+
+/*
+* Re-ranks approximate results by exact float L2 distance and keeps the best
+* k. vector_of(label) returns the float vector of a label; search with more
+* than k results (e.g. 2k to 4k) to leave room for reordering.
+*/
+template <typename VectorOf>
+std::priority_queue<std::pair<float, labeltype>>
+rerankL2(std::priority_queue<std::pair<float, labeltype>> candidates, const float *query, size_t dim, size_t k,
+         VectorOf vector_of) {
+    L2Space space(dim);
+    DISTFUNC<float> dist_func = space.get_dist_func();
+    std::priority_queue<std::pair<float, labeltype>> result;
+    for (; !candidates.empty(); candidates.pop()) {
+        labeltype label = candidates.top().second;
+        float dist = dist_func(query, vector_of(label), space.get_dist_func_param());
+        if (result.size() < k) {
+            result.emplace(dist, label);
+        } else if (dist < result.top().first) {
+            result.pop();
+            result.emplace(dist, label);
+        }
+    }
+    return result;
+}
+
+}  // namespace hnswlib
@@ -273,4 +273,50 @@ class EpsilonSearchStopCondition : public BaseSearchStopCondition<dist_t> {
 
     ~EpsilonSearchStopCondition() {}
 };
+
+
+// Stops a base-layer search where ef would, or once it has scored
+// max_distance_computations candidates. The count is checked between
+// expansions, so a search overshoots it by at most one expansion: a
+// neighbour list plus that node's extra links (see setExtraLinks).
+template<typename dist_t>
+class BudgetSearchStopCondition : public BaseSearchStopCondition<dist_t> {
+    size_t ef_;
+    size_t max_distance_computations_;
+    size_t num_results_;
+    size_t distance_computations_;
+
+ public:
+    BudgetSearchStopCondition(size_t ef, size_t max_distance_computations)
+        : ef_(ef), max_distance_computations_(max_distance_computations),
+          num_results_(0), distance_computations_(0) {}
+
+    void add_point_to_result(labeltype label, const void *datapoint, dist_t dist) override {
+        num_results_ += 1;
+    }
+
+    void remove_point_from_result(labeltype label, const void *datapoint, dist_t dist) override {
+        num_results_ -= 1;
+    }
+
+    bool should_stop_search(dist_t candidate_dist, dist_t lowerBound) override {
+        return distance_computations_ >= max_distance_computations_ ||
+               (candidate_dist > lowerBound && num_results_ == ef_);
+    }
+
+    // Called once per scored candidate
+    bool should_consider_candidate(dist_t candidate_dist, dist_t lowerBound) override {
+        distance_computations_ += 1;
+        return num_results_ < ef_ || lowerBound > candidate_dist;
+    }
+
+    bool should_remove_extra() override {
+        return num_results_ > ef_;
+    }
+
+    void filter_results(std::vector<std::pair<dist_t, labeltype >> &candidates) override {}
+
+    ~BudgetSearchStopCondition() {}
+};
+
 }  // namespace hnswlib
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <string.h>
 #include <deque>
+#include <memory>
+#include <vector>
 
 namespace hnswlib {
 typedef unsigned short int vl_type;
@@ -29,31 +33,255 @@ class VisitedList {
 
     ~VisitedList() { delete[] mass; }
 };
+
+// Visited set for searches that touch a tiny part of a large index: an
+// open-addressing hash set of internal ids, sized to the expected number of
+// visits, instead of a max_elements array. Its working set stays in cache
+// where a dense list would spread one cache line per visit over megabytes.
+// Grows when half full; reset() empties it for the next search.
+class VisitedHashSet {
+ public:
+    VisitedHashSet() { reset(0); }
+
+    // Room for expected_visits ids before the first rehash
+    void reset(size_t expected_visits) {
+        size_t capacity = 1024;
+        while (capacity < 2 * expected_visits) capacity *= 2;
+        if (keys_.size() != capacity) {
+            resize(capacity);
+        } else {
+            std::fill(keys_.begin(), keys_.end(), EMPTY);
+        }
+        size_ = 0;
+    }
+
+    bool contains(unsigned int id) const {
+        const size_t mask = keys_.size() - 1;
+        for (size_t slot = home(id);; slot = (slot + 1) & mask) {
+            if (keys_[slot] == id) return true;
+            if (keys_[slot] == EMPTY) return false;
+        }
+    }
+
+    // Adds id; false if it was already there
+    bool insert(unsigned int id) {
+        if (2 * (size_ + 1) > keys_.size()) grow();
+        const size_t mask = keys_.size() - 1;
+        size_t slot = home(id);
+        for (; keys_[slot] != EMPTY; slot = (slot + 1) & mask) {
+            if (keys_[slot] == id) return false;
+        }
+        keys_[slot] = id;
+        size_++;
+        return true;
+    }
+
+    const unsigned int *slotOf(unsigned int id) const { return keys_.data() + home(id); }
+    size_t size() const { return size_; }
+
+ private:
+    static constexpr unsigned int EMPTY = (unsigned int) -1;
+
+    // Fibonacci hashing: the top bits of the product, so ids that differ in
+    // any bits spread over the table
+    size_t home(unsigned int id) const { return (size_t) ((id * 0x9E3779B97F4A7C15ull) >> shift_); }
+
+    void resize(size_t capacity) {
+        keys_.assign(capacity, EMPTY);
+        shift_ = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) shift_--;
+    }
+
+    void grow() {
+        std::vector<unsigned int> old;
+        old.swap(keys_);
+        resize(old.size() * 2);
+        size_ = 0;
+        for (unsigned int id : old) {
+            if (id != EMPTY) insert(id);
+        }
+    }
+
+    std::vector<unsigned int> keys_;
+    int shift_ = 64;
+    size_t size_ = 0;
+};
+
+// Lends a VisitedHashSet for one search: the given set, else the calling
+// thread's cached one, which keeps its table across queries the way the
+// pooled dense lists do. A nested search on the same thread finds the cached
+// set taken and gets a set of its own.
+class VisitedHashSetLease {
+ public:
+    explicit VisitedHashSetLease(VisitedHashSet *set = nullptr) : set_(set) {
+        if (set_) return;
+        ThreadCache &cache = threadCache();
+        if (!cache.in_use) {
+            cache.in_use = true;
+            cached_ = true;
+            set_ = &cache.set;
+        } else {
+            own_.reset(new VisitedHashSet());
+            set_ = own_.get();
+        }
+    }
+
+    ~VisitedHashSetLease() {
+        if (cached_) threadCache().in_use = false;
+    }
+
+    VisitedHashSetLease(const VisitedHashSetLease &) = delete;
+    VisitedHashSetLease &operator=(const VisitedHashSetLease &) = delete;
+
+    VisitedHashSet &set() { return *set_; }
+
+ private:
+    struct ThreadCache {
+        VisitedHashSet set;
+        bool in_use = false;
+    };
+
+    static ThreadCache &threadCache() {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    VisitedHashSet *set_;
+    bool cached_ = false;
+    std::unique_ptr<VisitedHashSet> own_;
+};
 ///////////////////////////////////////////////////////////
 //
 // Class for multi-threaded pool-management of VisitedLists
 //
 /////////////////////////////////////////////////////////
 
+// Each thread keeps the lists it released in a small cache of its own, so
+// the usual acquire/release pair takes no lock; the shared deque only serves
+// threads without a cached list. Lists cached by a thread go back to their
+// pool when evicted or when the thread exits, or are freed if the pool is
+// gone by then. A cache entry holds a weak reference to its pool's free
+// lists, so neither path takes a lock other than that pool's own. Pools are
+// told apart by a unique id, never by address. Destroying a pool bumps a
+// global generation, and a thread frees the lists of dead pools on its next
+// access to any pool, so a long-lived worker does not pin the lists of an
+// index that was rebuilt or resized.
 class VisitedListPool {
-    std::deque<VisitedList *> pool;
-    std::mutex poolguard;
+    // Outlives the pool while a thread is giving a list back to it
+    struct FreeLists {
+        std::deque<VisitedList *> lists;
+        std::mutex guard;
+
+        ~FreeLists() {
+            for (VisitedList *vl : lists) delete vl;
+        }
+    };
+
+    std::shared_ptr<FreeLists> free_;
     int numelements;
+    uint64_t id_;
+
+    static const int THREAD_CACHE_SIZE = 4;
+
+    struct ThreadCache {
+        uint64_t owners[THREAD_CACHE_SIZE] = {};
+        std::weak_ptr<FreeLists> homes[THREAD_CACHE_SIZE];
+        VisitedList *lists[THREAD_CACHE_SIZE] = {};
+        int next_eviction = 0;
+        uint64_t seen_generation = 0;
+
+        ~ThreadCache() {
+            for (int i = 0; i < THREAD_CACHE_SIZE; i++) {
+                if (lists[i]) giveBack(homes[i], lists[i]);
+            }
+        }
+    };
+
+    // Number of pools destroyed so far
+    static std::atomic<uint64_t> &generation() {
+        static std::atomic<uint64_t> destroyed{0};
+        return destroyed;
+    }
+
+    static ThreadCache &rawThreadCache() {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    // The calling thread's cache, without lists of pools destroyed since its last use
+    static ThreadCache &threadCache() {
+        ThreadCache &cache = rawThreadCache();
+        uint64_t current = generation().load(std::memory_order_acquire);
+        if (cache.seen_generation != current) {
+            cache.seen_generation = current;
+            dropStaleLists(cache);
+        }
+        return cache;
+    }
+
+    static void giveBack(const std::weak_ptr<FreeLists> &home, VisitedList *vl) {
+        std::shared_ptr<FreeLists> free = home.lock();
+        if (!free) {
+            delete vl;
+            return;
+        }
+        std::unique_lock <std::mutex> lock(free->guard);
+        free->lists.push_front(vl);
+    }
+
+    // Frees cached lists of pools that no longer exist, e.g. after resizeIndex or loadIndex
+    static void dropStaleLists(ThreadCache &cache) {
+        for (int i = 0; i < THREAD_CACHE_SIZE; i++) {
+            if (cache.lists[i] && cache.homes[i].expired()) {
+                delete cache.lists[i];
+                cache.lists[i] = nullptr;
+                cache.homes[i].reset();
+            }
+        }
+    }
 
  public:
-    VisitedListPool(int initmaxpools, int numelements1) {
+    VisitedListPool(int initmaxpools, int numelements1) : free_(std::make_shared<FreeLists>()) {
+        static std::atomic<uint64_t> next_id{1};
         numelements = numelements1;
+        id_ = next_id++;
         for (int i = 0; i < initmaxpools; i++)
-            pool.push_front(new VisitedList(numelements));
+            free_->lists.push_front(new VisitedList(numelements));
+    }
+
+    ~VisitedListPool() {
+        // Expire the weak references first, so threads that see the new generation drop the lists
+        free_.reset();
+        generation().fetch_add(1, std::memory_order_release);
+    }
+
+    // Lists the calling thread holds in its cache, across all pools, stale ones included
+    static int threadCachedLists() {
+        const ThreadCache &cache = rawThreadCache();
+        int count = 0;
+        for (int i = 0; i < THREAD_CACHE_SIZE; i++) {
+            if (cache.lists[i]) count++;
+        }
+        return count;
     }
 
     VisitedList *getFreeVisitedList() {
-        VisitedList *rez;
-        {
-            std::unique_lock <std::mutex> lock(poolguard);
-            if (pool.size() > 0) {
-                rez = pool.front();
-                pool.pop_front();
+        VisitedList *rez = nullptr;
+        ThreadCache &cache = threadCache();
+        for (int i = 0; i < THREAD_CACHE_SIZE; i++) {
+            if (cache.lists[i] && cache.owners[i] == id_) {
+                rez = cache.lists[i];
+                cache.lists[i] = nullptr;
+                cache.homes[i].reset();
+                break;
+            }
+        }
+        if (!rez) {
+            dropStaleLists(cache);
+            std::unique_lock <std::mutex> lock(free_->guard);
+            if (free_->lists.size() > 0) {
+                rez = free_->lists.front();
+                free_->lists.pop_front();
             } else {
                 rez = new VisitedList(numelements);
             }
@@ -63,16 +291,19 @@ class VisitedListPool {
     }
 
     void releaseVisitedList(VisitedList *vl) {
-        std::unique_lock <std::mutex> lock(poolguard);
-        pool.push_front(vl);
-    }
-
-    ~VisitedListPool() {
-        while (pool.size()) {
-            VisitedList *rez = pool.front();
-            pool.pop_front();
-            delete rez;
+        ThreadCache &cache = threadCache();
+        int slot = -1;
+        for (int i = 0; i < THREAD_CACHE_SIZE && slot < 0; i++) {
+            if (!cache.lists[i]) slot = i;
+        }
+        if (slot < 0) {
+            slot = cache.next_eviction;
+            cache.next_eviction = (cache.next_eviction + 1) % THREAD_CACHE_SIZE;
+            giveBack(cache.homes[slot], cache.lists[slot]);
         }
+        cache.owners[slot] = id_;
+        cache.homes[slot] = free_;
+        cache.lists[slot] = vl;
     }
 };
 }  // namespace hnswlib
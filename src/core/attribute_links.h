@@ -0,0 +1,133 @@
+#pragma once
+#include "roaring_filter.h"
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+namespace filtering {
+
+struct AttributeLinkOptions {
+    // Extra links from each point of a linked attribute to its nearest
+    // neighbours having the same attribute
+    size_t links_per_point = 8;
+    // Bound on the links added for one attribute; attributes with more points
+    // than this allows at one link per point are left to the regular graph
+    size_t max_links_per_attribute = 100000;
+    // Only attributes on at most this fraction of the points are linked; the
+    // regular graph already connects the matches of less selective filters
+    double max_selectivity = 0.05;
+    // Neighbours are found by an exact scan up to this many points per
+    // attribute, and by a filtered search of the index above it
+    size_t exact_scan_limit = 2048;
+};
+
+struct AttributeLinkReport {
+    // Filters on these attributes may search the allowed subgraph only
+    // (FilterTraversal::AllowedSubgraph)
+    std::vector<unsigned int> linked_attributes;
+    size_t links_added;         // After dropping duplicates and existing links
+};
+
+namespace detail {
+
+// Internal-id predicate for the slots of one posting list
+class SlotSetFilter final : public hnswlib::BaseInternalFilterFunctor {
+public:
+    explicit SlotSetFilter(const roaring::Roaring& slots) : slots_(slots) {}
+    bool operator()(hnswlib::tableint internal_id) override { return slots_.contains(internal_id); }
+
+private:
+    const roaring::Roaring& slots_;
+};
+
+} // namespace detail
+
+// Adds extra base-layer links among points sharing a selective attribute, so
+// that a filtered search on that attribute can move between its matches
+// without crossing rejected nodes (in the spirit of filtered-HNSW / ACORN
+// construction). Links are set with HierarchicalNSW::setExtraLinks, replacing
+// earlier ones, and only filtered searches follow them. Filters on a linked
+// attribute can then search its matches alone (AllowedSubgraph), which
+// skips the distance computations to rejected nodes.
+//
+// The filter must be aligned with the index (RoaringFilter::alignWith) so that
+// its slots are internal ids; this throws otherwise. Call again after adding
+// points, and after loading the index, as extra links are not saved with it.
+template <typename dist_t>
+AttributeLinkReport addAttributeLinks(hnswlib::HierarchicalNSW<dist_t>& index, const RoaringFilter& filter,
+                                      const AttributeLinkOptions& options = AttributeLinkOptions()) {
+    checkAligned(filter, index);
+    const size_t num_elements = index.cur_element_count;
+    const size_t max_points = static_cast<size_t>(options.max_selectivity * num_elements);
+    std::vector<std::vector<hnswlib::tableint>> links(num_elements);
+    AttributeLinkReport report{{}, 0};
+
+    std::vector<hnswlib::tableint> members;
+    for (const auto& posting : filter.postingLists()) {
+        const roaring::Roaring& slots = posting.second;
+        size_t cardinality = slots.cardinality();
+        if (cardinality < 2 || cardinality > max_points) continue;
+        size_t per_point = std::min(options.links_per_point, options.max_links_per_attribute / cardinality);
+        if (per_point == 0) continue;
+
+        members.clear();
+        for (uint32_t slot : slots) {
+            if (slot < num_elements && !index.isMarkedDeleted(slot)) members.push_back(slot);
+        }
+        if (members.size() < 2) continue;
+        per_point = std::min(per_point, members.size() - 1);
+
+        if (members.size() <= options.exact_scan_limit) {
+            for (hnswlib::tableint point : members) {
+                const char* point_data = index.getDataByInternalId(point);
+                std::priority_queue<std::pair<dist_t, hnswlib::tableint>> nearest;
+                for (hnswlib::tableint other : members) {
+                    if (other == point) continue;
+                    dist_t dist = index.fstdistfunc_(point_data, index.getDataByInternalId(other),
+                                                     index.dist_func_param_);
+                    if (nearest.size() < per_point) {
+                        nearest.emplace(dist, other);
+                    } else if (dist < nearest.top().first) {
+                        nearest.pop();
+                        nearest.emplace(dist, other);
+                    }
+                }
+                for (; !nearest.empty(); nearest.pop()) links[point].push_back(nearest.top().second);
+            }
+        } else {
+            detail::SlotSetFilter in_attribute(slots);
+            for (hnswlib::tableint point : members) {
+                auto nearest = index.searchKnnAdaptive(index.getDataByInternalId(point), per_point + 1,
+                                                       &in_attribute);
+                for (; !nearest.empty(); nearest.pop()) {
+                    hnswlib::tableint other = index.label_lookup_.at(nearest.top().second);
+                    if (other != point) links[point].push_back(other);
+                }
+            }
+        }
+        report.linked_attributes.push_back(posting.first);
+    }
+
+    // Attributes overlap, and some neighbours are linked already
+    for (size_t point = 0; point < num_elements; point++) {
+        auto& neighbours = links[point];
+        if (neighbours.empty()) continue;
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        hnswlib::linklistsizeint* list = index.get_linklist0(point);
+        const hnswlib::tableint* regular = reinterpret_cast<hnswlib::tableint*>(list + 1);
+        size_t num_regular = index.getListCount(list);
+        neighbours.erase(std::remove_if(neighbours.begin(), neighbours.end(),
+                                        [&](hnswlib::tableint n) {
+                                            return std::find(regular, regular + num_regular, n) !=
+                                                   regular + num_regular;
+                                        }),
+                         neighbours.end());
+        report.links_added += neighbours.size();
+    }
+
+    index.setExtraLinks(links);
+    return report;
+}
+
+} // namespace filtering
\ No newline at end of file
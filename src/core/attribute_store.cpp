@@ -0,0 +1,72 @@
+#include "attribute_store.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace filtering {
+
+// Labels up to this far past the dense table are still stored densely
+constexpr size_t DENSE_LABEL_SLACK = 1 << 16;
+
+hnswlib::tableint SlotIndex::assign(hnswlib::labeltype label) {
+    hnswlib::tableint slot = find(label);
+    if (slot != NO_SLOT) {
+        return slot;
+    }
+    if (slot_labels_.size() >= NO_SLOT) {
+        throw std::runtime_error("Attribute store is full");
+    }
+    slot = static_cast<hnswlib::tableint>(slot_labels_.size());
+    slot_labels_.push_back(label);
+    num_labels_++;
+    bind(label, slot);
+    return slot;
+}
+
+std::vector<hnswlib::tableint> SlotIndex::rebind(std::vector<hnswlib::labeltype> slot_labels) {
+    std::vector<hnswlib::tableint> old_slot_of(slot_labels.size(), NO_SLOT);
+    for (size_t slot = 0; slot < slot_labels.size(); slot++) {
+        if (slot_labels[slot] != NO_LABEL) {
+            old_slot_of[slot] = find(slot_labels[slot]);
+        }
+    }
+
+    dense_slots_.clear();
+    sparse_slots_.clear();
+    slot_labels_ = std::move(slot_labels);
+    num_labels_ = 0;
+    for (size_t slot = 0; slot < slot_labels_.size(); slot++) {
+        if (slot_labels_[slot] != NO_LABEL) {
+            bind(slot_labels_[slot], static_cast<hnswlib::tableint>(slot));
+            num_labels_++;
+        }
+    }
+    return old_slot_of;
+}
+
+void SlotIndex::bind(hnswlib::labeltype label, hnswlib::tableint slot) {
+    if (label >= dense_slots_.size() && label < slot_labels_.size() * 2 + DENSE_LABEL_SLACK) {
+        growDense(label + 1);
+    }
+    if (label < dense_slots_.size()) {
+        dense_slots_[label] = slot;
+    } else {
+        sparse_slots_[label] = slot;
+    }
+}
+
+void SlotIndex::growDense(size_t min_size) {
+    size_t new_size = std::max(min_size, dense_slots_.size() * 2);
+    dense_slots_.resize(new_size, NO_SLOT);
+
+    // Pull in outliers that now fit the dense table
+    for (auto it = sparse_slots_.begin(); it != sparse_slots_.end();) {
+        if (it->first < new_size) {
+            dense_slots_[it->first] = it->second;
+            it = sparse_slots_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace filtering
\ No newline at end of file
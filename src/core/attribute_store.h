@@ -0,0 +1,171 @@
+#pragma once
+#include "../../external/hnswlib/hnswlib.h"
+#include <vector>
+#include <unordered_map>
+#include <limits>
+#include <mutex>
+
+namespace filtering {
+
+// Maps external labels to dense storage slots.
+// Slots are handed out in insertion order; after alignWith() slot == HNSW internal id.
+class SlotIndex {
+public:
+    static constexpr hnswlib::tableint NO_SLOT = std::numeric_limits<hnswlib::tableint>::max();
+    static constexpr hnswlib::labeltype NO_LABEL = std::numeric_limits<hnswlib::labeltype>::max();
+    static constexpr size_t NOT_ALIGNED = std::numeric_limits<size_t>::max();
+
+    // Hot path: one array load for dense labels, hash lookup only for outliers
+    inline hnswlib::tableint find(hnswlib::labeltype label) const {
+        if (label < dense_slots_.size()) {
+            return dense_slots_[label];
+        }
+        if (sparse_slots_.empty()) {
+            return NO_SLOT;
+        }
+        auto it = sparse_slots_.find(label);
+        return it != sparse_slots_.end() ? it->second : NO_SLOT;
+    }
+
+    // Returns the slot of label, appending a new one if the label is unknown
+    hnswlib::tableint assign(hnswlib::labeltype label);
+
+    hnswlib::labeltype labelAt(hnswlib::tableint slot) const { return slot_labels_[slot]; }
+    size_t size() const { return slot_labels_.size(); }
+    // Slots holding a label, i.e. size() without the NO_LABEL gaps left by alignWith()
+    size_t numLabels() const { return num_labels_; }
+
+    // Replaces the whole mapping; slot_labels[s] is the label stored at slot s (NO_LABEL for gaps).
+    // Returns old_slot_of[new_slot] so callers can permute their storage.
+    std::vector<hnswlib::tableint> rebind(std::vector<hnswlib::labeltype> slot_labels);
+
+    // Rebinds every label so that its slot equals its internal id in index.label_lookup_.
+    // Labels unknown to the index are kept after the index's elements.
+    template <typename dist_t>
+    std::vector<hnswlib::tableint> alignWith(const hnswlib::HierarchicalNSW<dist_t>& index) {
+        std::vector<hnswlib::labeltype> slot_labels;
+        size_t aligned_count, replaced_count;
+        {
+            std::unique_lock<std::mutex> lock(index.label_lookup_lock);
+            aligned_count = index.cur_element_count;
+            slot_labels.assign(aligned_count, NO_LABEL);
+            for (const auto& entry : index.label_lookup_) {
+                slot_labels[entry.second] = entry.first;
+            }
+            for (hnswlib::labeltype label : slot_labels_) {
+                if (label != NO_LABEL && index.label_lookup_.count(label) == 0) {
+                    slot_labels.push_back(label);
+                }
+            }
+            replaced_count = index.getReplacedCount();
+        }
+        std::vector<hnswlib::tableint> old_slot_of = rebind(std::move(slot_labels));
+        aligned_count_ = aligned_count;
+        aligned_replaced_count_ = replaced_count;
+        return old_slot_of;
+    }
+
+    // Checks that slot == internal id holds for every element of index. Elements
+    // present at the last alignWith() are trusted unless one of them has since
+    // been reused for a new label; elements added after it are compared label by
+    // label on every call, so points added to the index in a different order
+    // from the store fail it. A store that was never aligned (e.g. one replaced
+    // by loadAttributes) always fails; call alignWith to establish alignment.
+    template <typename dist_t>
+    bool isAlignedWith(const hnswlib::HierarchicalNSW<dist_t>& index) const {
+        if (aligned_count_ == NOT_ALIGNED || index.getReplacedCount() != aligned_replaced_count_) {
+            return false;
+        }
+        size_t num_elements = index.getCurrentElementCount();
+        if (num_elements < aligned_count_ || num_elements > size()) {
+            return false;
+        }
+        for (size_t id = aligned_count_; id < num_elements; id++) {
+            hnswlib::tableint internal_id = static_cast<hnswlib::tableint>(id);
+            if (labelAt(internal_id) != index.getExternalLabel(internal_id)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    void bind(hnswlib::labeltype label, hnswlib::tableint slot);
+    void growDense(size_t min_size);
+
+    // label -> slot for labels small enough to index directly
+    std::vector<hnswlib::tableint> dense_slots_;
+    // label -> slot for labels too large for the dense table
+    std::unordered_map<hnswlib::labeltype, hnswlib::tableint> sparse_slots_;
+    // slot -> label
+    std::vector<hnswlib::labeltype> slot_labels_;
+    size_t num_labels_ = 0;
+    // index.getCurrentElementCount() and index.getReplacedCount() at the last alignWith()
+    size_t aligned_count_ = NOT_ALIGNED;
+    size_t aligned_replaced_count_ = 0;
+};
+
+// Columnar per-point storage: one Row per slot in a contiguous array
+template <typename Row>
+class AttributeStore {
+public:
+    inline const Row* find(hnswlib::labeltype label) const {
+        hnswlib::tableint slot = slots_.find(label);
+        return slot != SlotIndex::NO_SLOT ? &rows_[slot] : nullptr;
+    }
+
+    inline Row* find(hnswlib::labeltype label) {
+        hnswlib::tableint slot = slots_.find(label);
+        return slot != SlotIndex::NO_SLOT ? &rows_[slot] : nullptr;
+    }
+
+    Row& getOrCreate(hnswlib::labeltype label) {
+        return rows_[getOrCreateSlot(label)];
+    }
+
+    hnswlib::tableint getOrCreateSlot(hnswlib::labeltype label) {
+        hnswlib::tableint slot = slots_.assign(label);
+        if (slot >= rows_.size()) {
+            rows_.resize(slot + 1);
+        }
+        return slot;
+    }
+
+    void reserve(size_t num_rows) { rows_.reserve(num_rows); }
+
+    // Direct access by slot; valid for slot < size()
+    inline const Row& row(hnswlib::tableint slot) const { return rows_[slot]; }
+    inline Row& row(hnswlib::tableint slot) { return rows_[slot]; }
+
+    size_t size() const { return rows_.size(); }
+    const SlotIndex& slots() const { return slots_; }
+    const std::vector<Row>& rows() const { return rows_; }
+
+    template <typename dist_t>
+    void alignWith(const hnswlib::HierarchicalNSW<dist_t>& index) {
+        permute(slots_.alignWith(index));
+    }
+
+    // Replaces the contents; rows[s] belongs to slot_labels[s]
+    void assign(std::vector<hnswlib::labeltype> slot_labels, std::vector<Row> rows) {
+        slots_ = SlotIndex();
+        slots_.rebind(std::move(slot_labels));
+        rows_ = std::move(rows);
+    }
+
+private:
+    void permute(const std::vector<hnswlib::tableint>& old_slot_of) {
+        std::vector<Row> rows(old_slot_of.size());
+        for (size_t slot = 0; slot < old_slot_of.size(); slot++) {
+            if (old_slot_of[slot] != SlotIndex::NO_SLOT) {
+                rows[slot] = std::move(rows_[old_slot_of[slot]]);
+            }
+        }
+        rows_.swap(rows);
+    }
+
+    SlotIndex slots_;
+    std::vector<Row> rows_;
+};
+
+} // namespace filtering
\ No newline at end of file
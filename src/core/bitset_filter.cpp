@@ -1,135 +1,258 @@
 #include "bitset_filter.h"
+#include "persistence.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <bitset>
+#include <fstream>
 #include <stdexcept>
 
 namespace filtering {
 
-BitsetFilter::BitsetFilter() : total_operations_(0), total_time_ms_(0) {}
+BitsetFilter::BitsetFilter() : BitsetFilter({}, MAX_ATTRIBUTES) {}
 
-BitsetFilter::BitsetFilter(const std::vector<unsigned int>& query_attributes) 
-    : total_operations_(0), total_time_ms_(0) {
-    setQueryAttributes(query_attributes);
-}
+BitsetFilter::BitsetFilter(const std::vector<unsigned int>& query_attributes)
+    : BitsetFilter(query_attributes, MAX_ATTRIBUTES) {}
+
+BitsetFilter::BitsetFilter(const std::vector<unsigned int>& query_attributes, size_t max_attributes)
+    : point_attributes_(max_attributes), attribute_counts_(max_attributes, 0), is_subset_(selectSubsetKernel()),
+      query_(compileQuery(query_attributes)) {}
 
 bool BitsetFilter::operator()(hnswlib::labeltype label_id) {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::Query);
     
-    auto it = point_attributes_.find(label_id);
+    const uint64_t* point = point_attributes_.find(label_id);
     bool result = false;
     
-    if (it != point_attributes_.end()) {
+    if (point != nullptr) {
         // Check if all query bits are set in point's bitset
-        result = (it->second & query_bitset_) == query_bitset_;
+        result = query_.matches(point);
     }
     
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
-    
     return result;
 }
 
+bool BitsetFilter::matchesSlot(hnswlib::tableint slot) const {
+    return slot < point_attributes_.size() &&
+           query_.matches(point_attributes_.row(slot));
+}
+
 bool BitsetFilter::hasAttribute(hnswlib::labeltype point_id, unsigned int attr_id) const {
     validateAttributeId(attr_id);
     
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
-    
-    auto it = point_attributes_.find(point_id);
-    bool result = (it != point_attributes_.end() && it->second[attr_id]);
+    ScopedOpTimer timer(metrics_, FilterOp::HasAttribute);
     
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+    const uint64_t* point = point_attributes_.find(point_id);
+    bool result = (point != nullptr && ((point[attr_id >> 6] >> (attr_id & 63)) & 1));
     
     return result;
 }
 
 bool BitsetFilter::hasAttributes(hnswlib::labeltype point_id, 
                                const std::vector<unsigned int>& attrs) const {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::HasAttributes);
     
-    auto it = point_attributes_.find(point_id);
-    if (it == point_attributes_.end()) {
-        auto end = std::chrono::high_resolution_clock::now();
-        last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-        total_time_ms_ += last_operation_time_ms_;
-        total_operations_++;
+    const uint64_t* point = point_attributes_.find(point_id);
+    if (point == nullptr) {
         return false;
     }
 
-    AttributeBitset query;
+    // A few bit tests, as in hasAttribute; compiling a query would sort and allocate
     for (unsigned int attr : attrs) {
         validateAttributeId(attr);
-        query.set(attr);
     }
-    
-    bool result = (it->second & query) == query;
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
-    
-    return result;
+    for (unsigned int attr : attrs) {
+        if (!((point[attr >> 6] >> (attr & 63)) & 1)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void BitsetFilter::addAttribute(hnswlib::labeltype point_id, unsigned int attr_id) {
     validateAttributeId(attr_id);
     
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
-    
-    point_attributes_[point_id].set(attr_id);
+    ScopedOpTimer timer(metrics_, FilterOp::AddAttribute);
     
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+    uint64_t& word = point_attributes_.getOrCreate(point_id)[attr_id >> 6];
+    uint64_t bit = uint64_t(1) << (attr_id & 63);
+    if (!(word & bit)) {
+        word |= bit;
+        attribute_counts_[attr_id]++;
+    }
 }
 
 void BitsetFilter::removeAttribute(hnswlib::labeltype point_id, unsigned int attr_id) {
     validateAttributeId(attr_id);
     
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::RemoveAttribute);
     
-    auto it = point_attributes_.find(point_id);
-    if (it != point_attributes_.end()) {
-        it->second.reset(attr_id);
+    uint64_t* point = point_attributes_.find(point_id);
+    uint64_t bit = uint64_t(1) << (attr_id & 63);
+    if (point != nullptr && (point[attr_id >> 6] & bit)) {
+        point[attr_id >> 6] &= ~bit;
+        attribute_counts_[attr_id]--;
     }
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+}
+
+void BitsetFilter::addPoints(const AttributeBatch& batch, size_t num_threads) {
+    for (size_t j = batch.offsets[0]; j < batch.offsets[batch.num_points]; j++) {
+        validateAttributeId(batch.attributes[j]);
+    }
+
+    point_attributes_.reserve(point_attributes_.size() + batch.num_points);
+    std::vector<hnswlib::tableint> slots(batch.num_points);
+    for (size_t i = 0; i < batch.num_points; i++) {
+        slots[i] = point_attributes_.getOrCreateSlot(batch.labels[i]);
+    }
+
+    // Each row is written by a single thread; counts are merged per range
+    std::mutex counts_lock;
+    parallelForRanges(batch.num_points, num_threads, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> counts(attribute_counts_.size(), 0);
+        for (size_t i = begin; i < end; i++) {
+            uint64_t* row = point_attributes_.row(slots[i]);
+            for (size_t j = batch.offsets[i]; j < batch.offsets[i + 1]; j++) {
+                unsigned int attr_id = batch.attributes[j];
+                uint64_t bit = uint64_t(1) << (attr_id & 63);
+                if (!(row[attr_id >> 6] & bit)) {
+                    row[attr_id >> 6] |= bit;
+                    counts[attr_id]++;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(counts_lock);
+        for (size_t attr_id = 0; attr_id < counts.size(); attr_id++) {
+            attribute_counts_[attr_id] += counts[attr_id];
+        }
+    });
 }
 
 void BitsetFilter::setQueryAttributes(const std::vector<unsigned int>& attributes) {
-    query_bitset_.reset();
-    for (unsigned int attr : attributes) {
-        validateAttributeId(attr);
-        query_bitset_.set(attr);
+    query_ = compileQuery(attributes);
+}
+
+BitsetQuery BitsetFilter::makeQuery(const std::vector<unsigned int>& attributes) const {
+    return BitsetQuery(*this, compileQuery(attributes));
+}
+
+bool BitsetQuery::matches(hnswlib::labeltype label_id) const {
+    ScopedOpTimer timer(filter_.metrics_, FilterOp::Query);
+
+    const uint64_t* point = filter_.point_attributes_.find(label_id);
+    return point != nullptr && query_.matches(point);
+}
+
+BitsetExpressionQuery BitsetFilter::makeQuery(const FilterExpression& expr) const {
+    return BitsetExpressionQuery(*this, compilePlan(expr));
+}
+
+FilterPlan BitsetFilter::compilePlan(const FilterExpression& expr) const {
+    FilterPlan plan = FilterPlan::compile(expr, point_attributes_.slots().numLabels(),
+        [this](unsigned int attr) { return getAttributeCardinality(attr); });
+    for (const PlanNode& node : plan.nodes()) {
+        for (unsigned int attr : node.attributes) {
+            validateAttributeId(attr);
+        }
     }
+    return plan;
 }
 
-size_t BitsetFilter::getNumAttributes(hnswlib::labeltype point_id) const {
-    auto it = point_attributes_.find(point_id);
-    return it != point_attributes_.end() ? it->second.count() : 0;
+BitsetExpressionQuery::BitsetExpressionQuery(const BitsetFilter& filter, FilterPlan plan)
+    : filter_(filter), plan_(std::move(plan)), node_words_(plan_.nodes().size()) {
+    for (size_t i = 0; i < plan_.nodes().size(); i++) {
+        // Group the node's attributes by word, keeping the plan's order of first use
+        auto& words = node_words_[i];
+        for (unsigned int attr : plan_.nodes()[i].attributes) {
+            size_t index = attr >> 6;
+            auto word = std::find_if(words.begin(), words.end(),
+                [index](const QueryWord& w) { return w.index == index; });
+            if (word == words.end()) {
+                words.push_back({index, 0});
+                word = words.end() - 1;
+            }
+            word->mask |= uint64_t(1) << (attr & 63);
+        }
+    }
+}
+
+bool BitsetExpressionQuery::matches(hnswlib::labeltype label_id) const {
+    ScopedOpTimer timer(filter_.metrics_, FilterOp::Query);
+
+    const uint64_t* point = filter_.point_attributes_.find(label_id);
+    return point != nullptr && matchesRow(point);
+}
+
+size_t BitsetFilter::getAttributeCardinality(unsigned int attr_id) const {
+    return attr_id < attribute_counts_.size() ? attribute_counts_[attr_id] : 0;
+}
+
+void BitsetFilter::saveAttributes(const std::string& location) const {
+    std::ofstream output(location, std::ios::binary);
+    if (!output) {
+        throw std::runtime_error("Cannot open file " + location);
+    }
+
+    writeHeader(output, FilterFormat::Bitset, point_attributes_.slots());
+    hnswlib::writeBinaryPOD(output, static_cast<uint64_t>(point_attributes_.numBits()));
+    hnswlib::writeBinaryPOD(output, static_cast<uint64_t>(point_attributes_.wordsPerRow()));
+    output.write(reinterpret_cast<const char*>(attribute_counts_.data()),
+                 attribute_counts_.size() * sizeof(uint32_t));
+
+    writePadding(output, AlignedWords::ALIGNMENT);
+    output.write(reinterpret_cast<const char*>(point_attributes_.row(0)),
+                 point_attributes_.size() * point_attributes_.wordsPerRow() * sizeof(uint64_t));
+    if (!output) {
+        throw std::runtime_error("Cannot write file " + location);
+    }
 }
 
-double BitsetFilter::getLastOperationTimeMs() const {
-    return last_operation_time_ms_;
+void BitsetFilter::loadAttributes(const std::string& location) {
+    auto file = std::make_shared<MappedFile>(location);
+    MappedReader reader(*file);
+    std::vector<hnswlib::labeltype> slot_labels = reader.readHeader(FilterFormat::Bitset);
+
+    uint64_t num_bits = reader.read<uint64_t>();
+    uint64_t words_per_row = reader.read<uint64_t>();
+    if (num_bits == 0 || num_bits > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Invalid attribute width in " + location);
+    }
+    BitsetStore store(num_bits);
+    if (store.wordsPerRow() != words_per_row) {
+        throw std::runtime_error("Unexpected bitset row width in " + location);
+    }
+    const uint32_t* counts = reader.array<uint32_t>(num_bits);
+    std::vector<uint32_t> attribute_counts(counts, counts + num_bits);
+
+    size_t num_words = slot_labels.size() * words_per_row;
+    uint64_t* slab = reader.array<uint64_t>(num_words, AlignedWords::ALIGNMENT);
+    store.assign(std::move(slot_labels), AlignedWords::view(slab, num_words, file));
+
+    point_attributes_ = std::move(store);
+    attribute_counts_ = std::move(attribute_counts);
+    query_ = compileQuery({});
 }
 
-uint64_t BitsetFilter::getTotalOperations() const {
-    return total_operations_;
+size_t BitsetFilter::getNumAttributes(hnswlib::labeltype point_id) const {
+    const uint64_t* point = point_attributes_.find(point_id);
+    if (point == nullptr) {
+        return 0;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < point_attributes_.wordsPerRow(); i++) {
+        count += std::bitset<64>(point[i]).count();
+    }
+    return count;
 }
 
-double BitsetFilter::getAverageOperationTimeMs() const {
-    return total_operations_ > 0 ? total_time_ms_ / total_operations_ : 0.0;
+CompiledBitsetQuery BitsetFilter::compileQuery(const std::vector<unsigned int>& attributes) const {
+    for (unsigned int attr : attributes) {
+        validateAttributeId(attr);
+    }
+    return CompiledBitsetQuery(attributes, point_attributes_.wordsPerRow(), is_subset_);
 }
 
 void BitsetFilter::validateAttributeId(unsigned int attr_id) const {
-    if (attr_id >= MAX_ATTRIBUTES) {
+    if (attr_id >= point_attributes_.numBits()) {
         throw std::out_of_range("Attribute ID exceeds maximum allowed value");
     }
 }
@@ -1,19 +1,23 @@
 #pragma once
 #include "filter_interface.h"
-#include <bitset>
-#include <unordered_map>
-#include <chrono>
+#include "bitset_store.h"
+#include "filter_metrics.h"
+#include "filter_expression.h"
 
 namespace filtering {
 
-// Using 1024 bits to support up to 1024 attributes (can be adjusted)
+// Default bitset width; pass max_attributes to the constructor for more
 constexpr size_t MAX_ATTRIBUTES = 1024;
-using AttributeBitset = std::bitset<MAX_ATTRIBUTES>;
+
+class BitsetQuery;
+class BitsetExpressionQuery;
 
 class BitsetFilter : public BaseFilter {
 public:
     BitsetFilter();
     BitsetFilter(const std::vector<unsigned int>& query_attributes);
+    // Attribute ids must be below max_attributes, which is fixed for the filter's lifetime
+    BitsetFilter(const std::vector<unsigned int>& query_attributes, size_t max_attributes);
     
     // BaseFilter interface implementation
     bool operator()(hnswlib::labeltype label_id) override;
@@ -21,31 +25,126 @@ public:
     bool hasAttributes(hnswlib::labeltype point_id, const std::vector<unsigned int>& attrs) const override;
     void addAttribute(hnswlib::labeltype point_id, unsigned int attr_id) override;
     void removeAttribute(hnswlib::labeltype point_id, unsigned int attr_id) override;
+    // Assigns slots and sizes the slab once, then fills rows in parallel
+    void addPoints(const AttributeBatch& batch, size_t num_threads = 1) override;
 
     // Additional functionality
     void setQueryAttributes(const std::vector<unsigned int>& attributes);
+    // Per-query predicate that leaves this filter untouched, for concurrent searches
+    BitsetQuery makeQuery(const std::vector<unsigned int>& attributes) const;
+    // Predicate for a boolean expression, evaluated per point with word-level bit tests
+    BitsetExpressionQuery makeQuery(const FilterExpression& expr) const;
+    // Plan for expr, ordered by this filter's attribute cardinalities
+    FilterPlan compilePlan(const FilterExpression& expr) const;
     size_t getNumAttributes(hnswlib::labeltype point_id) const;
+    size_t getAttributeCardinality(unsigned int attr_id) const;
+    size_t getMaxAttributes() const { return point_attributes_.numBits(); }
+    size_t getMemoryUsage() const { return point_attributes_.getMemoryUsage(); }
+
+    // Query check by storage slot, i.e. by internal id once aligned. Not timed.
+    bool matchesSlot(hnswlib::tableint slot) const;
+
+    // Re-lays out storage so that slot == internal id of the given index
+    template <typename dist_t>
+    void alignWith(const hnswlib::HierarchicalNSW<dist_t>& index) { point_attributes_.alignWith(index); }
+    const BitsetStore& store() const { return point_attributes_; }
+    const SlotIndex& slots() const { return point_attributes_.slots(); }
+
+    // Writes the attributes, e.g. next to an index written by saveIndex
+    void saveAttributes(const std::string& location) const;
+    // Replaces the attributes and width with those saved at location and clears
+    // the current query. The slab is mapped and used in place until it must grow.
+    void loadAttributes(const std::string& location);
     
-    // Performance metrics
-    double getLastOperationTimeMs() const;
-    uint64_t getTotalOperations() const;
-    double getAverageOperationTimeMs() const;
+    // Sampled latency histograms; only populated when built with FILTERING_INSTRUMENTATION
+    FilterMetrics& metrics() { return metrics_; }
+    const FilterMetrics& metrics() const { return metrics_; }
 
 private:
-    // Data storage: point_id -> bitset of attributes
-    std::unordered_map<hnswlib::labeltype, AttributeBitset> point_attributes_;
+    // Data storage: slot -> bitset of attributes, in one aligned slab
+    BitsetStore point_attributes_;
+
+    // Number of points per attribute, for plan ordering
+    std::vector<uint32_t> attribute_counts_;
     
-    // Query bitset
-    AttributeBitset query_bitset_;
+    // Subset check picked for this CPU at construction
+    SubsetKernel is_subset_;
+
+    // Current query, compiled for the store's row width
+    CompiledBitsetQuery query_;
 
     // Performance tracking
-    mutable std::chrono::high_resolution_clock::time_point last_operation_start_;
-    mutable double last_operation_time_ms_;
-    mutable uint64_t total_operations_;
-    mutable double total_time_ms_;
+    FilterMetrics metrics_;
 
     // Helper function to validate attribute ID
     void validateAttributeId(unsigned int attr_id) const;
+    CompiledBitsetQuery compileQuery(const std::vector<unsigned int>& attributes) const;
+
+    friend class BitsetQuery;
+    friend class BitsetExpressionQuery;
+};
+
+// Immutable predicate for one query against a BitsetFilter. Any number of
+// queries can be evaluated from different threads at once, as long as the
+// filter's attributes are not modified meanwhile.
+class BitsetQuery {
+public:
+    BitsetQuery(const BitsetFilter& filter, CompiledBitsetQuery query)
+        : filter_(filter), query_(std::move(query)) {}
+
+    bool matches(hnswlib::labeltype label_id) const;
+    bool matchesSlot(hnswlib::tableint slot) const {
+        const auto& store = filter_.point_attributes_;
+        return slot < store.size() && query_.matches(store.row(slot));
+    }
+    const SlotIndex& slots() const { return filter_.slots(); }
+
+private:
+    const BitsetFilter& filter_;
+    CompiledBitsetQuery query_;
+};
+
+// Immutable predicate for a FilterExpression against a BitsetFilter. Attribute
+// tests of each plan node are grouped per word, so an AllOf/AnyOf node costs
+// one load and mask per word it touches.
+class BitsetExpressionQuery {
+public:
+    BitsetExpressionQuery(const BitsetFilter& filter, FilterPlan plan);
+
+    bool matches(hnswlib::labeltype label_id) const;
+    bool matchesSlot(hnswlib::tableint slot) const {
+        const auto& store = filter_.point_attributes_;
+        return slot < store.size() && matchesRow(store.row(slot));
+    }
+    const SlotIndex& slots() const { return filter_.slots(); }
+
+    const FilterPlan& plan() const { return plan_; }
+
+private:
+    struct QueryWord {
+        size_t index;
+        uint64_t mask;
+    };
+
+    inline bool matchesRow(const uint64_t* row) const {
+        return plan_.evaluate([&](const PlanNode& node) {
+            const auto& words = node_words_[&node - plan_.nodes().data()];
+            if (node.op == PlanNode::Op::AllOf) {
+                for (const QueryWord& word : words) {
+                    if ((row[word.index] & word.mask) != word.mask) return false;
+                }
+                return true;
+            }
+            for (const QueryWord& word : words) {
+                if (row[word.index] & word.mask) return true;
+            }
+            return false;
+        });
+    }
+
+    const BitsetFilter& filter_;
+    FilterPlan plan_;
+    std::vector<std::vector<QueryWord>> node_words_;  // Per plan node, AllOf/AnyOf only
 };
 
 } // namespace filtering
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "bitset_store.h"
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace filtering {
+
+bool isSubsetScalar(const uint64_t* row, const uint64_t* query, size_t num_words) {
+    for (size_t i = 0; i < num_words; i++) {
+        if (query[i] & ~row[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(USE_AVX512)
+static bool isSubsetAVX512(const uint64_t* row, const uint64_t* query, size_t num_words) {
+    size_t i = 0;
+    for (; i + 8 <= num_words; i += 8) {
+        __m512i missing = _mm512_andnot_si512(_mm512_loadu_si512(row + i), _mm512_loadu_si512(query + i));
+        if (_mm512_test_epi64_mask(missing, missing)) {
+            return false;
+        }
+    }
+    return isSubsetScalar(row + i, query + i, num_words - i);
+}
+#endif
+
+#if defined(USE_AVX)
+static bool isSubsetAVX(const uint64_t* row, const uint64_t* query, size_t num_words) {
+    size_t i = 0;
+    for (; i + 4 <= num_words; i += 4) {
+        __m256i row_words = _mm256_loadu_si256((const __m256i*) (row + i));
+        __m256i query_words = _mm256_loadu_si256((const __m256i*) (query + i));
+        // testc: (~row & query) == 0
+        if (!_mm256_testc_si256(row_words, query_words)) {
+            return false;
+        }
+    }
+    return isSubsetScalar(row + i, query + i, num_words - i);
+}
+#endif
+
+SubsetKernel selectSubsetKernel() {
+#if defined(USE_AVX512)
+    if (AVX512Capable()) {
+        return isSubsetAVX512;
+    }
+#endif
+#if defined(USE_AVX)
+    if (AVXCapable()) {
+        return isSubsetAVX;
+    }
+#endif
+    return isSubsetScalar;
+}
+
+AlignedWords::AlignedWords(size_t num_words) {
+    resize(num_words);
+}
+
+AlignedWords::AlignedWords(const AlignedWords& other) {
+    *this = other;
+}
+
+AlignedWords AlignedWords::view(uint64_t* words, size_t num_words, std::shared_ptr<void> owner) {
+    AlignedWords result;
+    result.words_ = std::unique_ptr<uint64_t[], Free>(words, Free{false});
+    result.num_words_ = num_words;
+    result.owner_ = std::move(owner);
+    return result;
+}
+
+AlignedWords& AlignedWords::operator=(const AlignedWords& other) {
+    if (this != &other) {
+        words_.reset();
+        num_words_ = 0;
+        owner_.reset();
+        resize(other.num_words_);
+        if (num_words_ > 0) {
+            memcpy(words_.get(), other.words_.get(), num_words_ * sizeof(uint64_t));
+        }
+    }
+    return *this;
+}
+
+void AlignedWords::resize(size_t num_words) {
+    if (num_words <= num_words_) {
+        return;
+    }
+    size_t num_bytes = num_words * sizeof(uint64_t);
+    num_bytes = (num_bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+#ifdef _WIN32
+    void* memory = _aligned_malloc(num_bytes, ALIGNMENT);
+#else
+    void* memory = nullptr;
+    if (posix_memalign(&memory, ALIGNMENT, num_bytes) != 0) {
+        memory = nullptr;
+    }
+#endif
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    uint64_t* words = static_cast<uint64_t*>(memory);
+    if (num_words_ > 0) {
+        memcpy(words, words_.get(), num_words_ * sizeof(uint64_t));
+    }
+    memset(words + num_words_, 0, (num_words - num_words_) * sizeof(uint64_t));
+    words_ = std::unique_ptr<uint64_t[], Free>(words, Free{true});
+    num_words_ = num_words;
+    owner_.reset();
+}
+
+void AlignedWords::Free::operator()(uint64_t* words) const {
+    if (!owned) {
+        return;
+    }
+#ifdef _WIN32
+    _aligned_free(words);
+#else
+    free(words);
+#endif
+}
+
+CompiledBitsetQuery::CompiledBitsetQuery(const std::vector<unsigned int>& attributes,
+                                         size_t words_per_row, SubsetKernel is_subset)
+    : words_per_row_(words_per_row), is_subset_(is_subset) {
+    std::vector<unsigned int> sorted(attributes);
+    std::sort(sorted.begin(), sorted.end());
+    for (unsigned int attr : sorted) {
+        size_t index = attr >> 6;
+        if (words_.empty() || words_.back().index != index) {
+            words_.push_back({index, 0});
+        }
+        words_.back().mask |= uint64_t(1) << (attr & 63);
+    }
+
+    sparse_ = words_.size() <= MAX_SPARSE_WORDS;
+    if (!sparse_) {
+        dense_.resize(words_per_row);
+        for (const QueryWord& word : words_) {
+            dense_.data()[word.index] = word.mask;
+        }
+    }
+}
+
+BitsetStore::BitsetStore(size_t num_bits) : num_bits_(num_bits), num_rows_(0) {
+    if (num_bits == 0) {
+        throw std::invalid_argument("Bitset width must be positive");
+    }
+    // Narrow rows are padded to a power of two words, wide ones to whole cache lines
+    size_t words = (num_bits + 63) / 64;
+    size_t line_words = AlignedWords::ALIGNMENT / sizeof(uint64_t);
+    if (words < line_words) {
+        words_per_row_ = 1;
+        while (words_per_row_ < words) {
+            words_per_row_ *= 2;
+        }
+    } else {
+        words_per_row_ = (words + line_words - 1) / line_words * line_words;
+    }
+}
+
+hnswlib::tableint BitsetStore::getOrCreateSlot(hnswlib::labeltype label) {
+    hnswlib::tableint slot = slots_.assign(label);
+    if (slot >= num_rows_) {
+        num_rows_ = slot + 1;
+        if (num_rows_ * words_per_row_ > slab_.size()) {
+            reserve(std::max<size_t>(num_rows_, slab_.size() / words_per_row_ * 2));
+        }
+    }
+    return slot;
+}
+
+void BitsetStore::reserve(size_t num_rows) {
+    slab_.resize(num_rows * words_per_row_);
+}
+
+void BitsetStore::permute(const std::vector<hnswlib::tableint>& old_slot_of) {
+    AlignedWords slab(old_slot_of.size() * words_per_row_);
+    for (size_t slot = 0; slot < old_slot_of.size(); slot++) {
+        if (old_slot_of[slot] != SlotIndex::NO_SLOT) {
+            memcpy(slab.data() + slot * words_per_row_, row(old_slot_of[slot]),
+                   words_per_row_ * sizeof(uint64_t));
+        }
+    }
+    slab_ = std::move(slab);
+    num_rows_ = old_slot_of.size();
+}
+
+void BitsetStore::assign(std::vector<hnswlib::labeltype> slot_labels, AlignedWords slab) {
+    if (slab.size() < slot_labels.size() * words_per_row_) {
+        throw std::invalid_argument("Bitset slab is smaller than its rows");
+    }
+    num_rows_ = slot_labels.size();
+    slots_ = SlotIndex();
+    slots_.rebind(std::move(slot_labels));
+    slab_ = std::move(slab);
+}
+
+} // namespace filtering
\ No newline at end of file
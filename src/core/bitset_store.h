@@ -0,0 +1,140 @@
+#pragma once
+#include "attribute_store.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace filtering {
+
+// True if every bit set in query is also set in row; both are num_words long
+using SubsetKernel = bool (*)(const uint64_t* row, const uint64_t* query, size_t num_words);
+
+// Best subset kernel for this CPU: AVX-512, AVX or scalar, like hnswlib's distance dispatch
+SubsetKernel selectSubsetKernel();
+bool isSubsetScalar(const uint64_t* row, const uint64_t* query, size_t num_words);
+
+// Zero-initialized words on a 64-byte boundary
+class AlignedWords {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    AlignedWords() = default;
+    explicit AlignedWords(size_t num_words);
+    AlignedWords(const AlignedWords& other);
+    AlignedWords& operator=(const AlignedWords& other);
+    AlignedWords(AlignedWords&&) = default;
+    AlignedWords& operator=(AlignedWords&&) = default;
+
+    // Words that live in memory owned by owner, e.g. a mapped file. They are
+    // used in place until the first resize or copy, which moves them to the heap.
+    static AlignedWords view(uint64_t* words, size_t num_words, std::shared_ptr<void> owner);
+
+    // Grows to num_words, keeping the existing words and zeroing the new ones
+    void resize(size_t num_words);
+
+    uint64_t* data() { return words_.get(); }
+    const uint64_t* data() const { return words_.get(); }
+    size_t size() const { return num_words_; }
+
+private:
+    struct Free {
+        Free() : owned(true) {}
+        explicit Free(bool owned) : owned(owned) {}
+        bool owned;
+        void operator()(uint64_t* words) const;
+    };
+
+    std::unique_ptr<uint64_t[], Free> words_;
+    size_t num_words_ = 0;
+    std::shared_ptr<void> owner_;  // Keeps viewed words alive
+};
+
+// A query bitset compiled for rows of a given width. Queries touching only a
+// few words keep a list of (word, mask) pairs and test just those words;
+// others test the full padded row with the SIMD subset kernel.
+class CompiledBitsetQuery {
+public:
+    static constexpr size_t MAX_SPARSE_WORDS = 4;
+
+    CompiledBitsetQuery(const std::vector<unsigned int>& attributes, size_t words_per_row, SubsetKernel is_subset);
+
+    inline bool matches(const uint64_t* row) const {
+        if (sparse_) {
+            for (const QueryWord& word : words_) {
+                if ((row[word.index] & word.mask) != word.mask) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return is_subset_(row, dense_.data(), words_per_row_);
+    }
+
+    bool isSparse() const { return sparse_; }
+    size_t numWords() const { return words_.size(); }
+
+private:
+    struct QueryWord {
+        size_t index;
+        uint64_t mask;
+    };
+
+    std::vector<QueryWord> words_;   // Non-zero words of the query, in order
+    AlignedWords dense_;             // Only filled when !sparse_
+    size_t words_per_row_;
+    SubsetKernel is_subset_;
+    bool sparse_;
+};
+
+// Fixed-width bitsets for all points in one contiguous slab, indexed by slot.
+// The width is chosen at construction; rows are padded so that they never
+// straddle a cache line and wide rows start on one.
+class BitsetStore {
+public:
+    explicit BitsetStore(size_t num_bits);
+
+    size_t numBits() const { return num_bits_; }
+    size_t wordsPerRow() const { return words_per_row_; }
+
+    inline const uint64_t* find(hnswlib::labeltype label) const {
+        hnswlib::tableint slot = slots_.find(label);
+        return slot != SlotIndex::NO_SLOT ? row(slot) : nullptr;
+    }
+
+    inline uint64_t* find(hnswlib::labeltype label) {
+        hnswlib::tableint slot = slots_.find(label);
+        return slot != SlotIndex::NO_SLOT ? row(slot) : nullptr;
+    }
+
+    uint64_t* getOrCreate(hnswlib::labeltype label) { return row(getOrCreateSlot(label)); }
+    hnswlib::tableint getOrCreateSlot(hnswlib::labeltype label);
+    // Sizes the slab for num_rows rows, so that adding up to that many points does not reallocate
+    void reserve(size_t num_rows);
+
+    // Direct access by slot; valid for slot < size()
+    inline const uint64_t* row(hnswlib::tableint slot) const { return slab_.data() + slot * words_per_row_; }
+    inline uint64_t* row(hnswlib::tableint slot) { return slab_.data() + slot * words_per_row_; }
+
+    size_t size() const { return num_rows_; }
+    const SlotIndex& slots() const { return slots_; }
+    size_t getMemoryUsage() const { return slab_.size() * sizeof(uint64_t); }
+
+    template <typename dist_t>
+    void alignWith(const hnswlib::HierarchicalNSW<dist_t>& index) {
+        permute(slots_.alignWith(index));
+    }
+
+    // Replaces the contents; slab holds slot_labels.size() rows of wordsPerRow() words
+    void assign(std::vector<hnswlib::labeltype> slot_labels, AlignedWords slab);
+
+private:
+    void permute(const std::vector<hnswlib::tableint>& old_slot_of);
+
+    SlotIndex slots_;
+    size_t num_bits_;
+    size_t words_per_row_;
+    size_t num_rows_;
+    AlignedWords slab_;
+};
+
+} // namespace filtering
\ No newline at end of file
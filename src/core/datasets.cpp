@@ -0,0 +1,152 @@
+#include "datasets.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace filtering {
+
+static_assert(sizeof(size_t) == sizeof(int64_t), ".spmat offsets are used in place as size_t");
+static_assert(sizeof(unsigned int) == sizeof(int32_t), ".spmat indices are used in place as unsigned int");
+
+static bool endsWith(const std::string& path, const char* suffix) {
+    size_t length = strlen(suffix);
+    return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+}
+
+VectorFormat vectorFormatOf(const std::string& path) {
+    if (endsWith(path, ".fvecs")) return VectorFormat::Fvecs;
+    if (endsWith(path, ".bvecs")) return VectorFormat::Bvecs;
+    if (endsWith(path, ".ivecs")) return VectorFormat::Ivecs;
+    if (endsWith(path, ".fbin")) return VectorFormat::Fbin;
+    if (endsWith(path, ".u8bin")) return VectorFormat::U8bin;
+    if (endsWith(path, ".ibin")) return VectorFormat::Ibin;
+    throw std::invalid_argument("Unknown vector file format: " + path);
+}
+
+static size_t elementSize(ElementType type) {
+    return type == ElementType::UInt8 ? 1 : 4;
+}
+
+VectorFile::VectorFile(const std::string& path) : VectorFile(path, vectorFormatOf(path)) {}
+
+VectorFile::VectorFile(const std::string& path, VectorFormat format)
+    : file_(new hnswlib::MappedFile(path, hnswlib::MappedFile::Mode::ReadOnly)) {
+    // Index builds stream the rows once, front to back
+    file_->adviseSequential();
+    const char* data = file_->data();
+    const size_t file_size = file_->size();
+
+    switch (format) {
+        case VectorFormat::Fvecs: case VectorFormat::Fbin: type_ = ElementType::Float32; break;
+        case VectorFormat::Bvecs: case VectorFormat::U8bin: type_ = ElementType::UInt8; break;
+        case VectorFormat::Ivecs: case VectorFormat::Ibin: type_ = ElementType::Int32; break;
+    }
+
+    if (format == VectorFormat::Fbin || format == VectorFormat::U8bin || format == VectorFormat::Ibin) {
+        uint32_t header[2];
+        if (file_size < sizeof(header)) {
+            throw std::runtime_error("Vector file is truncated: " + path);
+        }
+        memcpy(header, data, sizeof(header));
+        num_vectors_ = header[0];
+        dim_ = header[1];
+        stride_ = dim_ * elementSize(type_);
+        rows_ = data + sizeof(header);
+        if (num_vectors_ > 0 && stride_ > 0 && (file_size - sizeof(header)) / stride_ < num_vectors_) {
+            throw std::runtime_error("Vector file is truncated: " + path);
+        }
+        return;
+    }
+
+    // *vecs: every row repeats the dimension; only the first is read, the
+    // file size has to be a whole number of rows of that dimension
+    num_vectors_ = 0;
+    dim_ = 0;
+    stride_ = 0;
+    rows_ = data + sizeof(int32_t);
+    if (file_size == 0) return;
+    int32_t dim;
+    if (file_size < sizeof(dim)) {
+        throw std::runtime_error("Vector file is truncated: " + path);
+    }
+    memcpy(&dim, data, sizeof(dim));
+    if (dim <= 0) {
+        throw std::runtime_error("Invalid dimension in vector file: " + path);
+    }
+    dim_ = dim;
+    stride_ = sizeof(int32_t) + dim_ * elementSize(type_);
+    if (file_size % stride_ != 0) {
+        throw std::runtime_error("Vector file size is not a multiple of its row size: " + path);
+    }
+    num_vectors_ = file_size / stride_;
+}
+
+void VectorFile::copyRows(size_t begin, size_t end, float* out) const {
+    for (size_t i = begin; i < end; i++) {
+        const char* source = rows_ + i * stride_;
+        switch (type_) {
+            case ElementType::Float32:
+                memcpy(out, source, dim_ * sizeof(float));
+                break;
+            case ElementType::UInt8:
+                for (size_t j = 0; j < dim_; j++) out[j] = static_cast<uint8_t>(source[j]);
+                break;
+            case ElementType::Int32:
+                for (size_t j = 0; j < dim_; j++) {
+                    int32_t value;
+                    memcpy(&value, source + j * sizeof(value), sizeof(value));
+                    out[j] = static_cast<float>(value);
+                }
+                break;
+        }
+        out += dim_;
+    }
+}
+
+AttributeMatrixFile::AttributeMatrixFile(const std::string& path)
+    : file_(new hnswlib::MappedFile(path, hnswlib::MappedFile::Mode::ReadOnly)) {
+    const char* data = file_->data();
+    const size_t file_size = file_->size();
+    int64_t header[3];
+    if (file_size < sizeof(header)) {
+        throw std::runtime_error("Attribute matrix file is truncated: " + path);
+    }
+    memcpy(header, data, sizeof(header));
+    if (header[0] < 0 || header[1] < 0 || header[2] < 0) {
+        throw std::runtime_error("Invalid attribute matrix header: " + path);
+    }
+    num_points_ = header[0];
+    num_attributes_ = header[1];
+    num_entries_ = header[2];
+
+    size_t available = (file_size - sizeof(header)) / sizeof(int64_t);
+    if (available < num_points_ + 1 ||
+        (file_size - sizeof(header) - (num_points_ + 1) * sizeof(int64_t)) / sizeof(int32_t) < num_entries_) {
+        throw std::runtime_error("Attribute matrix file is truncated: " + path);
+    }
+    offsets_ = reinterpret_cast<const size_t*>(data + sizeof(header));
+    attributes_ = reinterpret_cast<const unsigned int*>(data + sizeof(header) + (num_points_ + 1) * sizeof(int64_t));
+
+    // Offsets are what addPoints indexes with; check them once here
+    if (offsets_[0] != 0 || offsets_[num_points_] != num_entries_) {
+        throw std::runtime_error("Inconsistent attribute matrix offsets: " + path);
+    }
+    for (size_t i = 0; i < num_points_; i++) {
+        if (offsets_[i] > offsets_[i + 1]) {
+            throw std::runtime_error("Inconsistent attribute matrix offsets: " + path);
+        }
+    }
+}
+
+AttributeBatch AttributeMatrixFile::batch(const hnswlib::labeltype* labels, size_t begin, size_t end) const {
+    end = std::min(end, num_points_);
+    begin = std::min(begin, end);
+    return AttributeBatch{labels, end - begin, offsets_ + begin, attributes_};
+}
+
+std::vector<unsigned int> AttributeMatrixFile::row(size_t i) const {
+    return std::vector<unsigned int>(attributes_ + offsets_[i], attributes_ + offsets_[i + 1]);
+}
+
+} // namespace filtering
\ No newline at end of file
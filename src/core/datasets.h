@@ -0,0 +1,93 @@
+#pragma once
+#include "filter_interface.h"
+#include "../../external/hnswlib/mapped_file.h"
+#include <memory>
+#include <string>
+
+namespace filtering {
+
+enum class VectorFormat {
+    Fvecs,  // Per vector: int32 dimension, then float components
+    Bvecs,  // Per vector: int32 dimension, then uint8 components
+    Ivecs,  // Per vector: int32 dimension, then int32 components
+    Fbin,   // uint32 count and dimension, then float vectors back to back
+    U8bin,  // Same, with uint8 components
+    Ibin    // Same, with int32 components
+};
+
+enum class ElementType {
+    Float32,
+    UInt8,
+    Int32
+};
+
+// Picks the format from the file extension; throws std::invalid_argument
+// for an unknown one
+VectorFormat vectorFormatOf(const std::string& path);
+
+// Vectors of a dataset file, memory-mapped read-only and used in place:
+// nothing is copied until a row is read, pages are only loaded when touched,
+// and files larger than memory map fine. Rows of the *vecs formats are spaced
+// by their dimension header, so pass stride() to ParallelIndexBuilder::add;
+// copyRows converts to float for indexes over a different component type.
+// Data after the last vector, such as the distances section of a ground truth
+// .ibin file, is ignored.
+class VectorFile {
+public:
+    // Throws std::runtime_error if the file cannot be mapped or its size
+    // does not match its header
+    explicit VectorFile(const std::string& path);
+    VectorFile(const std::string& path, VectorFormat format);
+
+    size_t size() const { return num_vectors_; }
+    size_t dim() const { return dim_; }
+    ElementType elementType() const { return type_; }
+    // Bytes from the start of one row to the next
+    size_t stride() const { return stride_; }
+
+    const void* row(size_t i) const { return rows_ + i * stride_; }
+
+    // Components of rows [begin, end) as floats, back to back
+    void copyRows(size_t begin, size_t end, float* out) const;
+
+private:
+    std::unique_ptr<hnswlib::MappedFile> file_;
+    ElementType type_;
+    size_t num_vectors_;
+    size_t dim_;
+    size_t stride_;
+    const char* rows_;
+};
+
+// Sparse point x attribute matrix in the CSR .spmat format of the filtered
+// big-ann benchmarks: int64 rows, columns and non-zeros, int64 row offsets
+// (rows + 1), int32 column indices, then float values, which are ignored.
+// Row i holds the attributes of point i. Offsets and indices are mapped and
+// handed out in place as an AttributeBatch.
+class AttributeMatrixFile {
+public:
+    // Throws std::runtime_error if the file is truncated or its offsets are
+    // inconsistent
+    explicit AttributeMatrixFile(const std::string& path);
+
+    size_t numPoints() const { return num_points_; }
+    size_t numAttributes() const { return num_attributes_; }
+    size_t numEntries() const { return num_entries_; }
+
+    // Rows [begin, end) as the attributes of labels[0 .. end - begin - 1];
+    // end is clamped to the number of rows
+    AttributeBatch batch(const hnswlib::labeltype* labels, size_t begin = 0, size_t end = size_t(-1)) const;
+
+    // Attributes of row i
+    std::vector<unsigned int> row(size_t i) const;
+
+private:
+    std::unique_ptr<hnswlib::MappedFile> file_;
+    size_t num_points_;
+    size_t num_attributes_;
+    size_t num_entries_;
+    const size_t* offsets_;
+    const unsigned int* attributes_;
+};
+
+} // namespace filtering
\ No newline at end of file
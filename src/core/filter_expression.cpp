@@ -0,0 +1,217 @@
+#include "filter_expression.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace filtering {
+
+FilterExpression FilterExpression::attribute(unsigned int attr_id) {
+    return FilterExpression(Kind::Attribute, attr_id, {});
+}
+
+FilterExpression FilterExpression::conjunction(std::vector<FilterExpression> children) {
+    return FilterExpression(Kind::And, 0, std::move(children));
+}
+
+FilterExpression FilterExpression::disjunction(std::vector<FilterExpression> children) {
+    return FilterExpression(Kind::Or, 0, std::move(children));
+}
+
+FilterExpression FilterExpression::negation(FilterExpression child) {
+    return FilterExpression(Kind::Not, 0, {std::move(child)});
+}
+
+FilterExpression FilterExpression::allOf(const std::vector<unsigned int>& attrs) {
+    std::vector<FilterExpression> children;
+    for (unsigned int attr : attrs) {
+        children.push_back(attribute(attr));
+    }
+    return conjunction(std::move(children));
+}
+
+FilterExpression FilterExpression::anyOf(const std::vector<unsigned int>& attrs) {
+    std::vector<FilterExpression> children;
+    for (unsigned int attr : attrs) {
+        children.push_back(attribute(attr));
+    }
+    return disjunction(std::move(children));
+}
+
+FilterExpression operator&&(FilterExpression lhs, FilterExpression rhs) {
+    return FilterExpression::conjunction({std::move(lhs), std::move(rhs)});
+}
+
+FilterExpression operator||(FilterExpression lhs, FilterExpression rhs) {
+    return FilterExpression::disjunction({std::move(lhs), std::move(rhs)});
+}
+
+FilterExpression operator!(FilterExpression expr) {
+    return FilterExpression::negation(std::move(expr));
+}
+
+namespace {
+
+// Plan node with owned children, before flattening
+struct TreeNode {
+    PlanNode::Op op;
+    std::vector<unsigned int> attributes;
+    std::vector<TreeNode> children;
+    double selectivity = 1.0;
+    double cost = 1.0;
+};
+
+bool isAttributeTest(const TreeNode& node) {
+    return node.op == PlanNode::Op::AllOf || node.op == PlanNode::Op::AnyOf;
+}
+
+TreeNode build(const FilterExpression& expr) {
+    switch (expr.kind()) {
+        case FilterExpression::Kind::Attribute:
+            return TreeNode{PlanNode::Op::AllOf, {expr.attributeId()}, {}};
+
+        case FilterExpression::Kind::Not: {
+            TreeNode child = build(expr.children()[0]);
+            if (child.op == PlanNode::Op::Not) {
+                return std::move(child.children[0]);
+            }
+            TreeNode node{PlanNode::Op::Not, {}, {}};
+            node.children.push_back(std::move(child));
+            return node;
+        }
+
+        default: {
+            bool is_and = expr.kind() == FilterExpression::Kind::And;
+            PlanNode::Op op = is_and ? PlanNode::Op::And : PlanNode::Op::Or;
+            PlanNode::Op test_op = is_and ? PlanNode::Op::AllOf : PlanNode::Op::AnyOf;
+
+            TreeNode node{op, {}, {}};
+            TreeNode tests{test_op, {}, {}};
+            // Nested nodes of the same op are flattened, and attribute tests that
+            // combine the same way are merged into one AllOf/AnyOf
+            std::function<void(TreeNode&&)> add = [&](TreeNode&& child) {
+                if (child.op == op) {
+                    for (auto& grandchild : child.children) {
+                        add(std::move(grandchild));
+                    }
+                } else if (child.op == test_op || (isAttributeTest(child) && child.attributes.size() == 1)) {
+                    tests.attributes.insert(tests.attributes.end(), child.attributes.begin(), child.attributes.end());
+                } else {
+                    node.children.push_back(std::move(child));
+                }
+            };
+            for (const auto& child : expr.children()) {
+                add(build(child));
+            }
+
+            std::sort(tests.attributes.begin(), tests.attributes.end());
+            tests.attributes.erase(std::unique(tests.attributes.begin(), tests.attributes.end()),
+                                   tests.attributes.end());
+            if (!tests.attributes.empty() || node.children.empty()) {
+                node.children.push_back(std::move(tests));
+            }
+            if (node.children.size() == 1) {
+                return std::move(node.children[0]);
+            }
+            return node;
+        }
+    }
+}
+
+// Fills in selectivity and cost bottom-up, ordering children when statistics are given
+void estimate(TreeNode& node, size_t num_points, const FilterPlan::CardinalityFunc* cardinality) {
+    auto attribute_selectivity = [&](unsigned int attr) {
+        if (cardinality == nullptr || num_points == 0) {
+            return 0.5;
+        }
+        return std::min(1.0, static_cast<double>((*cardinality)(attr)) / num_points);
+    };
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    switch (node.op) {
+        case PlanNode::Op::AllOf:
+        case PlanNode::Op::AnyOf: {
+            bool all = node.op == PlanNode::Op::AllOf;
+            if (cardinality != nullptr) {
+                // Rarest first for AllOf, so intersections shrink fast; most common first for AnyOf
+                std::stable_sort(node.attributes.begin(), node.attributes.end(),
+                    [&](unsigned int a, unsigned int b) {
+                        return all ? attribute_selectivity(a) < attribute_selectivity(b)
+                                   : attribute_selectivity(a) > attribute_selectivity(b);
+                    });
+            }
+            double none_or_all = 1.0;
+            for (unsigned int attr : node.attributes) {
+                double p = attribute_selectivity(attr);
+                none_or_all *= all ? p : 1.0 - p;
+            }
+            node.selectivity = all ? none_or_all : 1.0 - none_or_all;
+            node.cost = std::max<size_t>(1, node.attributes.size());
+            break;
+        }
+
+        case PlanNode::Op::Not:
+            estimate(node.children[0], num_points, cardinality);
+            node.selectivity = 1.0 - node.children[0].selectivity;
+            node.cost = node.children[0].cost;
+            break;
+
+        default: {
+            bool is_and = node.op == PlanNode::Op::And;
+            for (auto& child : node.children) {
+                estimate(child, num_points, cardinality);
+            }
+            if (cardinality != nullptr) {
+                // Cost per unit of probability that the child decides the result
+                auto rank = [&](const TreeNode& child) {
+                    double decides = is_and ? 1.0 - child.selectivity : child.selectivity;
+                    return decides > 0 ? child.cost / decides : infinity;
+                };
+                std::stable_sort(node.children.begin(), node.children.end(),
+                    [&](const TreeNode& a, const TreeNode& b) { return rank(a) < rank(b); });
+            }
+            // Expected cost: each child runs only if the previous ones did not decide
+            double reach = 1.0;
+            node.cost = 0;
+            for (const auto& child : node.children) {
+                node.cost += reach * child.cost;
+                reach *= is_and ? child.selectivity : 1.0 - child.selectivity;
+            }
+            node.selectivity = is_and ? reach : 1.0 - reach;
+            break;
+        }
+    }
+}
+
+void emit(TreeNode& node, std::vector<PlanNode>& nodes) {
+    size_t index = nodes.size();
+    nodes.push_back(PlanNode{node.op, std::move(node.attributes), 0, node.selectivity, node.cost});
+    for (auto& child : node.children) {
+        emit(child, nodes);
+    }
+    if (nodes.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Filter expression too large");
+    }
+    nodes[index].end = static_cast<uint32_t>(nodes.size());
+}
+
+} // namespace
+
+FilterPlan FilterPlan::compile(const FilterExpression& expr) {
+    TreeNode root = build(expr);
+    estimate(root, 0, nullptr);
+
+    FilterPlan plan;
+    emit(root, plan.nodes_);
+    return plan;
+}
+
+FilterPlan FilterPlan::compile(const FilterExpression& expr, size_t num_points, const CardinalityFunc& cardinality) {
+    TreeNode root = build(expr);
+    estimate(root, num_points, &cardinality);
+
+    FilterPlan plan;
+    emit(root, plan.nodes_);
+    return plan;
+}
+
+} // namespace filtering
\ No newline at end of file
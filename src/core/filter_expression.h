@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace filtering {
+
+// Boolean expression over attributes, e.g.
+//   (FilterExpression::attribute(A) || FilterExpression::attribute(B)) && !FilterExpression::attribute(D)
+class FilterExpression {
+public:
+    enum class Kind { Attribute, And, Or, Not };
+
+    static FilterExpression attribute(unsigned int attr_id);
+    // An empty And is always true, an empty Or always false
+    static FilterExpression conjunction(std::vector<FilterExpression> children);
+    static FilterExpression disjunction(std::vector<FilterExpression> children);
+    static FilterExpression negation(FilterExpression child);
+    // Shorthands for "has all of" / "has any of" attrs
+    static FilterExpression allOf(const std::vector<unsigned int>& attrs);
+    static FilterExpression anyOf(const std::vector<unsigned int>& attrs);
+
+    Kind kind() const { return kind_; }
+    unsigned int attributeId() const { return attr_id_; }
+    const std::vector<FilterExpression>& children() const { return children_; }
+
+private:
+    FilterExpression(Kind kind, unsigned int attr_id, std::vector<FilterExpression> children)
+        : kind_(kind), attr_id_(attr_id), children_(std::move(children)) {}
+
+    Kind kind_;
+    unsigned int attr_id_;
+    std::vector<FilterExpression> children_;
+};
+
+FilterExpression operator&&(FilterExpression lhs, FilterExpression rhs);
+FilterExpression operator||(FilterExpression lhs, FilterExpression rhs);
+FilterExpression operator!(FilterExpression expr);
+
+// One node of a compiled plan. Nodes are stored in pre-order and each one
+// records where its subtree ends, so children are walked without pointers.
+struct PlanNode {
+    enum class Op {
+        AllOf,  // Point has every attribute in attributes (true if empty)
+        AnyOf,  // Point has at least one attribute in attributes
+        And,
+        Or,
+        Not
+    };
+
+    Op op;
+    std::vector<unsigned int> attributes;  // AllOf / AnyOf only
+    uint32_t end;                          // One past the last node of this subtree
+    double selectivity;                    // Estimated fraction of points that match
+    double cost;                           // Estimated attribute tests per evaluation
+};
+
+// Flat evaluation plan for a FilterExpression. Compilation flattens nested
+// And/Or, removes double negations and merges sibling attribute tests into
+// AllOf/AnyOf nodes. With statistics it also orders children so that cheap
+// clauses likely to decide the result run first: And by cost / (1 - selectivity),
+// Or by cost / selectivity, assuming independent attributes.
+class FilterPlan {
+public:
+    // Number of points having an attribute, and the total number of points
+    using CardinalityFunc = std::function<size_t(unsigned int)>;
+
+    static FilterPlan compile(const FilterExpression& expr);
+    static FilterPlan compile(const FilterExpression& expr, size_t num_points, const CardinalityFunc& cardinality);
+
+    const std::vector<PlanNode>& nodes() const { return nodes_; }
+    const PlanNode& root() const { return nodes_[0]; }
+    double estimatedSelectivity() const { return nodes_[0].selectivity; }
+
+    // Short-circuit evaluation; test_attributes(node) decides AllOf/AnyOf nodes
+    template <typename TestAttributes>
+    bool evaluate(const TestAttributes& test_attributes, uint32_t node = 0) const {
+        const PlanNode& current = nodes_[node];
+        switch (current.op) {
+            case PlanNode::Op::And:
+                for (uint32_t child = node + 1; child < current.end; child = nodes_[child].end) {
+                    if (!evaluate(test_attributes, child)) return false;
+                }
+                return true;
+            case PlanNode::Op::Or:
+                for (uint32_t child = node + 1; child < current.end; child = nodes_[child].end) {
+                    if (evaluate(test_attributes, child)) return true;
+                }
+                return false;
+            case PlanNode::Op::Not:
+                return !evaluate(test_attributes, node + 1);
+            default:
+                return test_attributes(current);
+        }
+    }
+
+private:
+    std::vector<PlanNode> nodes_;
+};
+
+} // namespace filtering
\ No newline at end of file
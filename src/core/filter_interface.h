@@ -1,9 +1,19 @@
 #pragma once
+#include <stdexcept>
 #include <vector>
 #include "../../external/hnswlib/hnswlib.h"
 
 namespace filtering {
 
+// Attributes of many points in CSR form: point labels[i] has attributes
+// attributes[offsets[i]] .. attributes[offsets[i + 1] - 1]
+struct AttributeBatch {
+    const hnswlib::labeltype* labels;
+    size_t num_points;
+    const size_t* offsets;          // num_points + 1 entries
+    const unsigned int* attributes;
+};
+
 class BaseFilter : public hnswlib::BaseFilterFunctor {
 public:
     // Override from HNSW's base filter
@@ -16,8 +26,60 @@ public:
     // Add/Remove attributes for a point
     virtual void addAttribute(hnswlib::labeltype point_id, unsigned int attr_id) = 0;
     virtual void removeAttribute(hnswlib::labeltype point_id, unsigned int attr_id) = 0;
+
+    // Adds the attributes of many points at once; labels must be distinct.
+    // Filters with a bulk path split the work over num_threads threads.
+    virtual void addPoints(const AttributeBatch& batch, size_t /*num_threads*/ = 1) {
+        for (size_t i = 0; i < batch.num_points; i++) {
+            for (size_t j = batch.offsets[i]; j < batch.offsets[i + 1]; j++) {
+                addAttribute(batch.labels[i], batch.attributes[j]);
+            }
+        }
+    }
     
     virtual ~BaseFilter() = default;
 };
 
+// Throws unless filter's slots are the internal ids of index (see alignWith
+// on each filter). Filter is a filter or a per-query predicate from makeQuery.
+template <typename Filter, typename dist_t>
+void checkAligned(const Filter& filter, const hnswlib::HierarchicalNSW<dist_t>& index) {
+    if (!filter.slots().isAlignedWith(index)) {
+        throw std::runtime_error("Filter is not aligned with the index; call alignWith after adding points");
+    }
+}
+
+// Lets HNSW evaluate a filter, or a per-query predicate from makeQuery, on
+// internal ids of the given index. The filter's store must be aligned with
+// the index first (see alignWith on each filter).
+template <typename Filter>
+class InternalIdFilter final : public hnswlib::BaseInternalFilterFunctor {
+public:
+    template <typename dist_t>
+    InternalIdFilter(const Filter& filter, const hnswlib::HierarchicalNSW<dist_t>& index) : filter_(filter) {
+        checkAligned(filter, index);
+    }
+
+    bool operator()(hnswlib::tableint internal_id) override {
+        return filter_.matchesSlot(internal_id);
+    }
+
+private:
+    const Filter& filter_;
+};
+
+// Lets HNSW evaluate a per-query predicate (see makeQuery on each filter) on labels
+template <typename Query>
+class QueryFilter final : public hnswlib::BaseFilterFunctor {
+public:
+    explicit QueryFilter(const Query& query) : query_(query) {}
+
+    bool operator()(hnswlib::labeltype label_id) override {
+        return query_.matches(label_id);
+    }
+
+private:
+    const Query& query_;
+};
+
 } // namespace filtering
\ No newline at end of file
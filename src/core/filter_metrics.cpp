@@ -0,0 +1,160 @@
+#include "filter_metrics.h"
+#include <unordered_map>
+
+namespace filtering {
+
+namespace {
+std::atomic<uint64_t> next_metrics_id{1};
+}
+
+thread_local uint32_t FilterMetrics::sample_tick_ = 0;
+
+// Written only by its thread, erased from by metrics being destroyed
+struct FilterMetrics::ThreadSlots {
+    std::mutex guard;
+    std::unordered_map<uint64_t, ThreadSlot*> slots;
+};
+
+size_t LatencyHistogram::bucketOf(uint64_t ns) {
+    size_t bucket = 0;
+    while (ns != 0 && bucket < NUM_BUCKETS - 1) {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets_[bucketOf(ns)]++;
+    count_++;
+    total_ns_ += ns;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t b = 0; b < NUM_BUCKETS; b++) {
+        buckets_[b] += other.buckets_[b];
+    }
+    count_ += other.count_;
+    total_ns_ += other.total_ns_;
+}
+
+uint64_t LatencyHistogram::percentileNs(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * (count_ - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < NUM_BUCKETS; b++) {
+        seen += buckets_[b];
+        if (seen >= rank) {
+            return b == 0 ? 0 : (uint64_t(1) << b) - 1;
+        }
+    }
+    return (uint64_t(1) << (NUM_BUCKETS - 1)) - 1;
+}
+
+FilterMetrics::FilterMetrics()
+    : id_(next_metrics_id.fetch_add(1, std::memory_order_relaxed)),
+      sample_rate_(DEFAULT_SAMPLE_RATE) {}
+
+FilterMetrics::FilterMetrics(const FilterMetrics& other)
+    : id_(next_metrics_id.fetch_add(1, std::memory_order_relaxed)),
+      sample_rate_(other.getSampleRate()) {}
+
+FilterMetrics& FilterMetrics::operator=(const FilterMetrics& other) {
+    setSampleRate(other.getSampleRate());
+    return *this;
+}
+
+FilterMetrics::~FilterMetrics() {
+    // Drop this object's entry from every thread that recorded into it.
+    // Nothing records while the object is destroyed, so slots_ needs no lock.
+    for (const auto& slot : slots_) {
+        if (std::shared_ptr<ThreadSlots> home = slot->home.lock()) {
+            std::lock_guard<std::mutex> home_lock(home->guard);
+            home->slots.erase(id_);
+        }
+    }
+}
+
+void FilterMetrics::record(FilterOp op, uint64_t ns) const {
+    // Only the owning thread writes a slot, so plain load/store is enough
+    Counters& counters = localSlot().ops[static_cast<size_t>(op)];
+    auto& bucket = counters.buckets[LatencyHistogram::bucketOf(ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    counters.total_ns.store(counters.total_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+}
+
+const std::shared_ptr<FilterMetrics::ThreadSlots>& FilterMetrics::threadSlots() {
+    thread_local std::shared_ptr<ThreadSlots> thread_slots = std::make_shared<ThreadSlots>();
+    return thread_slots;
+}
+
+FilterMetrics::ThreadSlot& FilterMetrics::localSlot() const {
+    // Ids are never reused, so a destroyed object's id can't match the cache
+    thread_local uint64_t cached_id = 0;
+    thread_local ThreadSlot* cached_slot = nullptr;
+
+    if (cached_id == id_) {
+        return *cached_slot;
+    }
+    const std::shared_ptr<ThreadSlots>& home = threadSlots();
+    ThreadSlot* slot;
+    {
+        std::lock_guard<std::mutex> home_lock(home->guard);
+        ThreadSlot*& entry = home->slots[id_];
+        if (entry == nullptr) {
+            std::lock_guard<std::mutex> lock(slots_mutex_);
+            slots_.push_back(std::make_unique<ThreadSlot>());
+            slots_.back()->home = home;
+            entry = slots_.back().get();
+        }
+        slot = entry;
+    }
+    cached_id = id_;
+    cached_slot = slot;
+    return *slot;
+}
+
+size_t FilterMetrics::threadSlotCount() {
+    const std::shared_ptr<ThreadSlots>& home = threadSlots();
+    std::lock_guard<std::mutex> home_lock(home->guard);
+    return home->slots.size();
+}
+
+LatencyHistogram FilterMetrics::histogram(FilterOp op) const {
+    LatencyHistogram merged;
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    for (const auto& slot : slots_) {
+        const Counters& counters = slot->ops[static_cast<size_t>(op)];
+        for (size_t b = 0; b < LatencyHistogram::NUM_BUCKETS; b++) {
+            uint64_t n = counters.buckets[b].load(std::memory_order_relaxed);
+            merged.buckets_[b] += n;
+            merged.count_ += n;
+        }
+        merged.total_ns_ += counters.total_ns.load(std::memory_order_relaxed);
+    }
+    return merged;
+}
+
+uint64_t FilterMetrics::getSampledOperations() const {
+    uint64_t total = 0;
+    for (size_t op = 0; op < NUM_FILTER_OPS; op++) {
+        total += histogram(static_cast<FilterOp>(op)).count();
+    }
+    return total;
+}
+
+void FilterMetrics::reset() {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    for (auto& slot : slots_) {
+        for (auto& counters : slot->ops) {
+            for (auto& bucket : counters.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            counters.total_ns.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+} // namespace filtering
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Build with -DFILTERING_INSTRUMENTATION to time filter operations.
+// Without it ScopedOpTimer compiles to nothing and the hot paths carry no timing code.
+
+namespace filtering {
+
+enum class FilterOp {
+    Query,            // operator()
+    HasAttribute,
+    HasAttributes,
+    AddAttribute,
+    RemoveAttribute,
+    Count
+};
+
+constexpr size_t NUM_FILTER_OPS = static_cast<size_t>(FilterOp::Count);
+
+// Latency histogram with power-of-two nanosecond buckets: bucket b holds [2^(b-1), 2^b)
+class LatencyHistogram {
+public:
+    static constexpr size_t NUM_BUCKETS = 40;
+
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const { return count_; }
+    uint64_t bucketCount(size_t bucket) const { return buckets_[bucket]; }
+    double meanNs() const { return count_ > 0 ? static_cast<double>(total_ns_) / count_ : 0.0; }
+    // Upper bound of the bucket containing the given percentile (0-100)
+    uint64_t percentileNs(double percentile) const;
+
+    static size_t bucketOf(uint64_t ns);
+
+private:
+    friend class FilterMetrics;
+
+    std::array<uint64_t, NUM_BUCKETS> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t total_ns_ = 0;
+};
+
+// Sampled latency counters for one filter. Each thread records into its own
+// slot; histograms are merged only when read.
+class FilterMetrics {
+public:
+    static constexpr uint32_t DEFAULT_SAMPLE_RATE = 64;
+
+#ifdef FILTERING_INSTRUMENTATION
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    FilterMetrics();
+    // Copies carry the sample rate over but start with empty counters
+    FilterMetrics(const FilterMetrics& other);
+    FilterMetrics& operator=(const FilterMetrics& other);
+    ~FilterMetrics();
+
+    // Time one in every_n operations per thread; 0 turns sampling off
+    void setSampleRate(uint32_t every_n) { sample_rate_.store(every_n, std::memory_order_relaxed); }
+    uint32_t getSampleRate() const { return sample_rate_.load(std::memory_order_relaxed); }
+
+    bool shouldSample() const {
+        uint32_t every_n = sample_rate_.load(std::memory_order_relaxed);
+        return every_n != 0 && ++sample_tick_ % every_n == 0;
+    }
+
+    void record(FilterOp op, uint64_t ns) const;
+
+    // Aggregated over all threads
+    LatencyHistogram histogram(FilterOp op) const;
+    uint64_t getSampledOperations() const;
+    void reset();
+
+    // Slots the calling thread holds in live metrics objects
+    static size_t threadSlotCount();
+
+private:
+    struct Counters {
+        std::array<std::atomic<uint64_t>, LatencyHistogram::NUM_BUCKETS> buckets{};
+        std::atomic<uint64_t> total_ns{0};
+    };
+    // Per-thread lookup from metrics id to that thread's slot
+    struct ThreadSlots;
+    struct ThreadSlot {
+        std::array<Counters, NUM_FILTER_OPS> ops;
+        std::weak_ptr<ThreadSlots> home;   // Expires when the thread exits
+    };
+
+    ThreadSlot& localSlot() const;
+    static const std::shared_ptr<ThreadSlots>& threadSlots();
+
+    static thread_local uint32_t sample_tick_;
+
+    const uint64_t id_;   // Never reused, unlike the object's address
+    std::atomic<uint32_t> sample_rate_;
+    mutable std::mutex slots_mutex_;
+    mutable std::vector<std::unique_ptr<ThreadSlot>> slots_;
+};
+
+// Times the enclosing scope into metrics when the operation is sampled
+class ScopedOpTimer {
+public:
+#ifdef FILTERING_INSTRUMENTATION
+    ScopedOpTimer(const FilterMetrics& metrics, FilterOp op)
+        : metrics_(metrics.shouldSample() ? &metrics : nullptr), op_(op) {
+        if (metrics_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedOpTimer() {
+        if (metrics_) {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            metrics_->record(op_, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+private:
+    const FilterMetrics* metrics_;
+    FilterOp op_;
+    std::chrono::steady_clock::time_point start_;
+#else
+    ScopedOpTimer(const FilterMetrics&, FilterOp) {}
+#endif
+};
+
+} // namespace filtering
\ No newline at end of file
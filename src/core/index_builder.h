@@ -0,0 +1,229 @@
+#pragma once
+#include "filter_interface.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+namespace filtering {
+
+// Snapshot passed to the progress callback
+struct BuildProgress {
+    size_t points_inserted;     // In the current call to add
+    size_t points_total;        // Size of the current call to add
+    double elapsed_seconds;
+    double points_per_second;
+};
+
+struct BuildOptions {
+    size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    // Points a worker claims at a time; small enough to balance the uneven
+    // cost of inserts, large enough to keep the shared cursor cold.
+    size_t chunk_size = 256;
+    // Calls on_progress every time this many more points are inserted (0: never)
+    size_t progress_interval = 100000;
+    // Called from worker threads, one call at a time
+    std::function<void(const BuildProgress&)> on_progress;
+    // When a batch does not fit, capacity grows to at least this multiple of
+    // the current one, so streaming many small batches resizes rarely
+    double growth_factor = 2.0;
+};
+
+struct BuildReport {
+    size_t points_inserted;
+    size_t index_resizes;
+    double elapsed_seconds;
+    double points_per_second;
+};
+
+// Builds an HNSW index (and optionally its attribute filter) from batches of
+// points, inserting vectors concurrently. HierarchicalNSW::addPoint is safe
+// to call from several threads; num_threads workers from a pool owned by the
+// builder each claim chunk_size points at a time from a shared cursor. The
+// index hands out internal ids in whatever order the inserts land, so the
+// batch's attributes go to the filter afterwards, sorted by internal id, with
+// addPoints on num_threads threads. Each add leaves the filter aligned with
+// the index (see alignWith on each filter), realigning it only when that
+// order does not already make slot == internal id.
+//
+// Batches may arrive one at a time with no total known up front: add grows
+// the index with resizeIndex between batches, when no insert is running.
+// The builder must be the only writer to the index and filter while it runs.
+template <typename dist_t>
+class ParallelIndexBuilder {
+public:
+    ParallelIndexBuilder(hnswlib::HierarchicalNSW<dist_t>& index, std::nullptr_t = nullptr,
+                         BuildOptions options = BuildOptions())
+        : index_(index), filter_(nullptr), options_(std::move(options)),
+          totals_{0, 0, 0.0, 0.0} {
+        options_.num_threads = std::max<size_t>(1, options_.num_threads);
+        options_.chunk_size = std::max<size_t>(1, options_.chunk_size);
+        pool_.reset(new hnswlib::BatchThreadPool(options_.num_threads - 1));
+    }
+
+    // Filter is a concrete filter (BitsetFilter, RoaringFilter, NaiveFilter)
+    template <typename Filter>
+    ParallelIndexBuilder(hnswlib::HierarchicalNSW<dist_t>& index, Filter* filter,
+                         BuildOptions options = BuildOptions())
+        : ParallelIndexBuilder(index, nullptr, std::move(options)) {
+        filter_ = filter;
+        align_filter_ = [filter](const hnswlib::HierarchicalNSW<dist_t>& index) {
+            if (!filter->slots().isAlignedWith(index)) {
+                filter->alignWith(index);
+            }
+        };
+    }
+
+    // Inserts num_points vectors under the given labels. Vector i starts
+    // i * stride bytes after vectors; a stride of 0 means the index space's
+    // data size, i.e. vectors stored back to back. attributes, if given, must
+    // describe the same points and requires a filter.
+    BuildReport add(const void* vectors, const hnswlib::labeltype* labels, size_t num_points,
+                    const AttributeBatch* attributes = nullptr, size_t stride = 0) {
+        if (stride != 0 && stride < index_.data_size_) {
+            throw std::invalid_argument("Vector stride is smaller than the index data size");
+        }
+        if (attributes != nullptr && filter_ == nullptr) {
+            throw std::invalid_argument("Attributes given to a builder without a filter");
+        }
+        if (attributes != nullptr && attributes->num_points != num_points) {
+            throw std::invalid_argument("Attribute batch does not match the vector batch");
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        size_t resizes = reserve(num_points);
+
+        const char* data = static_cast<const char*>(vectors);
+        const size_t data_size = stride ? stride : index_.data_size_;
+        std::atomic<size_t> cursor{0};
+        std::atomic<size_t> inserted{0};
+        std::mutex progress_lock;
+        size_t last_reported = 0;
+
+        std::exception_ptr error;
+        std::mutex error_lock;
+
+        pool_->run(options_.num_threads, [&](size_t) {
+            try {
+                for (;;) {
+                    size_t begin = cursor.fetch_add(options_.chunk_size);
+                    if (begin >= num_points) break;
+                    size_t end = std::min(num_points, begin + options_.chunk_size);
+                    for (size_t i = begin; i < end; i++) {
+                        index_.addPoint(data + i * data_size, labels[i]);
+                    }
+                    size_t done = inserted.fetch_add(end - begin) + (end - begin);
+                    reportProgress(done - (end - begin), done, num_points, start, progress_lock, last_reported);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_lock);
+                if (!error) error = std::current_exception();
+                cursor = num_points;
+            }
+        });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        if (attributes != nullptr) {
+            filter_->addPoints(byInternalId(*attributes), options_.num_threads);
+        }
+        if (filter_ != nullptr) {
+            align_filter_(index_);
+        }
+
+        double elapsed = secondsSince(start);
+        BuildReport report{num_points, resizes, elapsed, elapsed > 0 ? num_points / elapsed : 0.0};
+        totals_.points_inserted += report.points_inserted;
+        totals_.index_resizes += report.index_resizes;
+        totals_.elapsed_seconds += report.elapsed_seconds;
+        totals_.points_per_second = totals_.elapsed_seconds > 0
+                                        ? totals_.points_inserted / totals_.elapsed_seconds
+                                        : 0.0;
+        return report;
+    }
+
+    // Sums over every call to add
+    const BuildReport& totals() const { return totals_; }
+
+private:
+    // Copies batch into sorted_batch_, ordered by the internal ids the index gave
+    // its labels, so that new filter slots are appended in internal id order
+    const AttributeBatch& byInternalId(const AttributeBatch& batch) {
+        std::vector<hnswlib::tableint> ids(batch.num_points, hnswlib::tableint(-1));
+        {
+            std::unique_lock<std::mutex> lock(index_.label_lookup_lock);
+            for (size_t i = 0; i < batch.num_points; i++) {
+                auto it = index_.label_lookup_.find(batch.labels[i]);
+                if (it != index_.label_lookup_.end()) ids[i] = it->second;
+            }
+        }
+        std::vector<size_t> order(batch.num_points);
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ids[a] < ids[b]; });
+
+        sorted_labels_.clear();
+        sorted_offsets_.assign(1, 0);
+        sorted_attributes_.clear();
+        for (size_t i : order) {
+            sorted_labels_.push_back(batch.labels[i]);
+            sorted_attributes_.insert(sorted_attributes_.end(), batch.attributes + batch.offsets[i],
+                                      batch.attributes + batch.offsets[i + 1]);
+            sorted_offsets_.push_back(sorted_attributes_.size());
+        }
+        sorted_batch_ = {sorted_labels_.data(), batch.num_points, sorted_offsets_.data(),
+                         sorted_attributes_.data()};
+        return sorted_batch_;
+    }
+
+    // Makes room for num_points more elements; returns the number of resizes
+    size_t reserve(size_t num_points) {
+        size_t needed = index_.getCurrentElementCount() + num_points;
+        size_t capacity = index_.getMaxElements();
+        if (needed <= capacity) return 0;
+        size_t grown = static_cast<size_t>(capacity * options_.growth_factor);
+        index_.resizeIndex(std::max(needed, grown));
+        return 1;
+    }
+
+    void reportProgress(size_t before, size_t done, size_t total,
+                        std::chrono::steady_clock::time_point start, std::mutex& progress_lock,
+                        size_t& last_reported) {
+        const size_t interval = options_.progress_interval;
+        if (!options_.on_progress || interval == 0) return;
+        if (before / interval == done / interval && done != total) return;
+
+        std::lock_guard<std::mutex> lock(progress_lock);
+        // Chunks finish out of order; keep the reported counts increasing
+        if (done <= last_reported) return;
+        last_reported = done;
+        double elapsed = secondsSince(start);
+        options_.on_progress({done, total, elapsed, elapsed > 0 ? done / elapsed : 0.0});
+    }
+
+    static double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    hnswlib::HierarchicalNSW<dist_t>& index_;
+    BaseFilter* filter_;
+    // Realigns filter_ with the index unless its slots already match
+    std::function<void(const hnswlib::HierarchicalNSW<dist_t>&)> align_filter_;
+    BuildOptions options_;
+    BuildReport totals_;
+    std::unique_ptr<hnswlib::BatchThreadPool> pool_;
+
+    // Attribute batch reordered by byInternalId
+    std::vector<hnswlib::labeltype> sorted_labels_;
+    std::vector<size_t> sorted_offsets_;
+    std::vector<unsigned int> sorted_attributes_;
+    AttributeBatch sorted_batch_;
+};
+
+} // namespace filtering
\ No newline at end of file
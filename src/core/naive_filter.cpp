@@ -3,101 +3,89 @@
 
 namespace filtering {
 
-NaiveFilter::NaiveFilter() : total_operations_(0), total_time_ms_(0) {}
+NaiveFilter::NaiveFilter() {}
 
 NaiveFilter::NaiveFilter(const std::vector<unsigned int>& query_attributes) 
-    : query_attributes_(query_attributes), total_operations_(0), total_time_ms_(0) {}
+    : query_attributes_(query_attributes) {}
 
 bool NaiveFilter::operator()(hnswlib::labeltype label_id) {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::Query);
     
     bool result = hasAttributes(label_id, query_attributes_);
     
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
-    
     return result;
 }
 
+bool NaiveFilter::matchesSlot(hnswlib::tableint slot) const {
+    if (slot >= point_attributes_.size()) {
+        return false;
+    }
+    const auto& attrs = point_attributes_.row(slot);
+    return std::all_of(query_attributes_.begin(), query_attributes_.end(),
+        [&](unsigned int attr) { return attrs.count(attr) > 0; });
+}
+
 bool NaiveFilter::hasAttribute(hnswlib::labeltype point_id, unsigned int attr_id) const {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
-    
-    auto it = point_attributes_.find(point_id);
-    bool result = (it != point_attributes_.end() && it->second.count(attr_id) > 0);
+    ScopedOpTimer timer(metrics_, FilterOp::HasAttribute);
     
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+    auto* point = point_attributes_.find(point_id);
+    bool result = (point != nullptr && point->count(attr_id) > 0);
     
     return result;
 }
 
 bool NaiveFilter::hasAttributes(hnswlib::labeltype point_id, 
                               const std::vector<unsigned int>& attrs) const {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::HasAttributes);
     
-    auto it = point_attributes_.find(point_id);
-    if (it == point_attributes_.end()) {
-        auto end = std::chrono::high_resolution_clock::now();
-        last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-        total_time_ms_ += last_operation_time_ms_;
-        total_operations_++;
+    auto* point = point_attributes_.find(point_id);
+    if (point == nullptr) {
         return false;
     }
 
     bool result = std::all_of(attrs.begin(), attrs.end(),
-        [&](unsigned int attr) { return it->second.count(attr) > 0; });
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+        [&](unsigned int attr) { return point->count(attr) > 0; });
     
     return result;
 }
 
 void NaiveFilter::addAttribute(hnswlib::labeltype point_id, unsigned int attr_id) {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
-    
-    point_attributes_[point_id].insert(attr_id);
+    ScopedOpTimer timer(metrics_, FilterOp::AddAttribute);
     
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+    point_attributes_.getOrCreate(point_id).insert(attr_id);
 }
 
 void NaiveFilter::removeAttribute(hnswlib::labeltype point_id, unsigned int attr_id) {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::RemoveAttribute);
     
-    auto it = point_attributes_.find(point_id);
-    if (it != point_attributes_.end()) {
-        it->second.erase(attr_id);
+    auto* point = point_attributes_.find(point_id);
+    if (point != nullptr) {
+        point->erase(attr_id);
     }
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
 }
 
 void NaiveFilter::setQueryAttributes(const std::vector<unsigned int>& attributes) {
     query_attributes_ = attributes;
 }
 
-double NaiveFilter::getLastOperationTimeMs() const {
-    return last_operation_time_ms_;
+NaiveQuery NaiveFilter::makeQuery(const std::vector<unsigned int>& attributes) const {
+    return NaiveQuery(*this, attributes);
+}
+
+bool NaiveQuery::matches(hnswlib::labeltype label_id) const {
+    ScopedOpTimer timer(filter_.metrics_, FilterOp::Query);
+
+    auto* point = filter_.point_attributes_.find(label_id);
+    return point != nullptr && matchesRow(*point);
 }
 
-uint64_t NaiveFilter::getTotalOperations() const {
-    return total_operations_;
+bool NaiveQuery::matchesSlot(hnswlib::tableint slot) const {
+    return slot < filter_.point_attributes_.size() && matchesRow(filter_.point_attributes_.row(slot));
 }
 
-double NaiveFilter::getAverageOperationTimeMs() const {
-    return total_operations_ > 0 ? total_time_ms_ / total_operations_ : 0.0;
+bool NaiveQuery::matchesRow(const std::unordered_set<unsigned int>& attrs) const {
+    return std::all_of(query_attributes_.begin(), query_attributes_.end(),
+        [&](unsigned int attr) { return attrs.count(attr) > 0; });
 }
 
 } // namespace filtering
\ No newline at end of file
@@ -1,11 +1,13 @@
 #pragma once
 #include "filter_interface.h"
-#include <unordered_map>
+#include "attribute_store.h"
+#include "filter_metrics.h"
 #include <unordered_set>
-#include <chrono>
 
 namespace filtering {
 
+class NaiveQuery;
+
 class NaiveFilter : public BaseFilter {
 public:
     NaiveFilter();
@@ -20,24 +22,52 @@ public:
 
     // Query setting
     void setQueryAttributes(const std::vector<unsigned int>& attributes);
+    // Per-query predicate that leaves this filter untouched, for concurrent searches
+    NaiveQuery makeQuery(const std::vector<unsigned int>& attributes) const;
+
+    // Query check by storage slot, i.e. by internal id once aligned. Not timed.
+    bool matchesSlot(hnswlib::tableint slot) const;
+
+    // Re-lays out storage so that slot == internal id of the given index
+    template <typename dist_t>
+    void alignWith(const hnswlib::HierarchicalNSW<dist_t>& index) { point_attributes_.alignWith(index); }
+    const AttributeStore<std::unordered_set<unsigned int>>& store() const { return point_attributes_; }
+    const SlotIndex& slots() const { return point_attributes_.slots(); }
     
-    // Performance metrics
-    double getLastOperationTimeMs() const;
-    uint64_t getTotalOperations() const;
-    double getAverageOperationTimeMs() const;
+    // Sampled latency histograms; only populated when built with FILTERING_INSTRUMENTATION
+    FilterMetrics& metrics() { return metrics_; }
+    const FilterMetrics& metrics() const { return metrics_; }
 
 private:
-    // Data storage: point_id -> set of attributes
-    std::unordered_map<hnswlib::labeltype, std::unordered_set<unsigned int>> point_attributes_;
+    // Data storage: slot -> set of attributes
+    AttributeStore<std::unordered_set<unsigned int>> point_attributes_;
     
     // Current query attributes
     std::vector<unsigned int> query_attributes_;
 
     // Performance tracking
-    mutable std::chrono::high_resolution_clock::time_point last_operation_start_;
-    mutable double last_operation_time_ms_;
-    mutable uint64_t total_operations_;
-    mutable double total_time_ms_;
+    FilterMetrics metrics_;
+
+    friend class NaiveQuery;
+};
+
+// Immutable predicate for one query against a NaiveFilter. Any number of
+// queries can be evaluated from different threads at once, as long as the
+// filter's attributes are not modified meanwhile.
+class NaiveQuery {
+public:
+    NaiveQuery(const NaiveFilter& filter, const std::vector<unsigned int>& query_attributes)
+        : filter_(filter), query_attributes_(query_attributes) {}
+
+    bool matches(hnswlib::labeltype label_id) const;
+    bool matchesSlot(hnswlib::tableint slot) const;
+    const SlotIndex& slots() const { return filter_.slots(); }
+
+private:
+    bool matchesRow(const std::unordered_set<unsigned int>& attrs) const;
+
+    const NaiveFilter& filter_;
+    std::vector<unsigned int> query_attributes_;
 };
 
 } // namespace filtering
\ No newline at end of file
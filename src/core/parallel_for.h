@@ -0,0 +1,46 @@
+#pragma once
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace filtering {
+
+// Splits [0, count) into num_threads contiguous ranges and runs fn(begin, end)
+// on each, one thread per range; the calling thread takes the first range.
+// Rethrows the first exception thrown by fn once all threads have finished.
+template <typename Function>
+void parallelForRanges(size_t count, size_t num_threads, Function fn) {
+    num_threads = std::max<size_t>(1, std::min(num_threads, count));
+    if (num_threads == 1) {
+        fn(size_t(0), count);
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex error_lock;
+    auto run = [&](size_t begin, size_t end) {
+        try {
+            fn(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_lock);
+            if (!error) error = std::current_exception();
+        }
+    };
+
+    size_t chunk = (count + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+        threads.emplace_back(run, begin, std::min(count, begin + chunk));
+    }
+    run(0, std::min(count, chunk));
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace filtering
\ No newline at end of file
@@ -0,0 +1,212 @@
+#pragma once
+#include "roaring_filter.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <queue>
+#include <vector>
+
+namespace filtering {
+
+enum class SearchRoute {
+    Global,             // Filtered search of the global index
+    Partition,          // Unfiltered search of a partition
+    FilteredPartition   // Partition searched with the remaining attributes as filter
+};
+
+struct PartitionStats {
+    unsigned int attribute;
+    size_t num_points;
+    size_t memory_bytes;    // HierarchicalNSW::memoryUsage of the partition
+};
+
+// A global index plus dedicated sub-indexes ("partitions") holding only the
+// points that have a designated hot attribute. Queries whose attributes
+// include a partitioned attribute search the smallest such partition, without
+// a filter when that attribute is the whole query, so no visited node is
+// spent on points that cannot match.
+//
+// Partitions copy their vectors from the global index and keep its labels.
+// Points added through addPoint reach the partitions of their attributes;
+// after changing the filter directly, call refresh. Searches may run
+// concurrently with each other, but not with addPoint, markDelete or refresh.
+template <typename dist_t>
+class PartitionedIndex {
+public:
+    // space must be the one the global index was built with; partitions are
+    // built with the given M and ef_construction
+    PartitionedIndex(hnswlib::SpaceInterface<dist_t>* space, hnswlib::HierarchicalNSW<dist_t>& index,
+                     RoaringFilter& filter, size_t M = 16, size_t ef_construction = 200)
+        : space_(space), index_(index), filter_(filter), M_(M), ef_construction_(ef_construction) {}
+
+    // Builds the partition for attr from the points currently having it
+    void addPartition(unsigned int attr) {
+        const auto& postings = filter_.postingLists();
+        auto posting = postings.find(attr);
+        size_t cardinality = posting == postings.end() ? 0 : posting->second.cardinality();
+
+        auto partition = std::unique_ptr<hnswlib::HierarchicalNSW<dist_t>>(
+            new hnswlib::HierarchicalNSW<dist_t>(space_, std::max<size_t>(cardinality, 1), M_, ef_construction_));
+        partition->setEf(index_.ef_);
+        partitions_[attr] = std::move(partition);
+        refreshPartition(attr, *partitions_[attr]);
+    }
+
+    void removePartition(unsigned int attr) { partitions_.erase(attr); }
+    bool isPartitioned(unsigned int attr) const { return partitions_.count(attr) != 0; }
+
+    // Inserts into the global index, the filter and the partitions of attrs
+    void addPoint(const void* data_point, hnswlib::labeltype label, const std::vector<unsigned int>& attrs) {
+        index_.addPoint(data_point, label);
+        for (unsigned int attr : attrs) {
+            filter_.addAttribute(label, attr);
+            auto partition = partitions_.find(attr);
+            if (partition != partitions_.end()) {
+                insert(*partition->second, data_point, label);
+            }
+        }
+    }
+
+    void markDelete(hnswlib::labeltype label) {
+        index_.markDelete(label);
+        for (auto& partition : partitions_) {
+            if (contains(*partition.second, label)) {
+                partition.second->markDelete(label);
+            }
+        }
+    }
+
+    // Brings every partition up to date with the filter and the global index
+    void refresh() {
+        for (auto& partition : partitions_) {
+            refreshPartition(partition.first, *partition.second);
+        }
+    }
+
+    void setEf(size_t ef) {
+        index_.setEf(ef);
+        for (auto& partition : partitions_) {
+            partition.second->setEf(ef);
+        }
+    }
+
+    // Points having all attrs, routed to the smallest matching partition if any
+    std::priority_queue<std::pair<dist_t, hnswlib::labeltype>>
+    searchKnn(const void* query_data, size_t k, const std::vector<unsigned int>& attrs,
+              SearchRoute* route = nullptr) const {
+        const hnswlib::HierarchicalNSW<dist_t>* best = nullptr;
+        unsigned int best_attr = 0;
+        for (unsigned int attr : attrs) {
+            auto partition = partitions_.find(attr);
+            if (partition != partitions_.end() &&
+                (!best || partition->second->getCurrentElementCount() < best->getCurrentElementCount())) {
+                best = partition->second.get();
+                best_attr = attr;
+            }
+        }
+
+        if (!best) {
+            if (route) *route = SearchRoute::Global;
+            RoaringQuery query = filter_.makeQuery(attrs);
+            QueryFilter<RoaringQuery> by_label(query);
+            return index_.searchKnnWithFilter(query_data, k, &by_label);
+        }
+
+        std::vector<unsigned int> rest;
+        for (unsigned int attr : attrs) {
+            if (attr != best_attr) rest.push_back(attr);
+        }
+        if (rest.empty()) {
+            if (route) *route = SearchRoute::Partition;
+            return best->searchKnn(query_data, k);
+        }
+        if (route) *route = SearchRoute::FilteredPartition;
+        RoaringQuery query = filter_.makeQuery(rest);
+        QueryFilter<RoaringQuery> by_label(query);
+        return best->searchKnnWithFilter(query_data, k, &by_label);
+    }
+
+    std::vector<PartitionStats> partitionStats() const {
+        std::vector<PartitionStats> stats;
+        for (const auto& partition : partitions_) {
+            const auto& index = *partition.second;
+            stats.push_back({partition.first, index.getCurrentElementCount() - index.getDeletedCount(),
+                             index.memoryUsage()});
+        }
+        return stats;
+    }
+
+    const hnswlib::HierarchicalNSW<dist_t>* partition(unsigned int attr) const {
+        auto found = partitions_.find(attr);
+        return found == partitions_.end() ? nullptr : found->second.get();
+    }
+
+private:
+    static bool contains(const hnswlib::HierarchicalNSW<dist_t>& index, hnswlib::labeltype label) {
+        std::unique_lock<std::mutex> lock(index.label_lookup_lock);
+        return index.label_lookup_.count(label) != 0;
+    }
+
+    static bool isLive(const hnswlib::HierarchicalNSW<dist_t>& index, hnswlib::labeltype label) {
+        std::unique_lock<std::mutex> lock(index.label_lookup_lock);
+        auto found = index.label_lookup_.find(label);
+        return found != index.label_lookup_.end() && !index.isMarkedDeleted(found->second);
+    }
+
+    // addPoint on a label already present updates it and clears its delete mark
+    static void insert(hnswlib::HierarchicalNSW<dist_t>& partition, const void* data_point,
+                       hnswlib::labeltype label) {
+        if (partition.getCurrentElementCount() == partition.getMaxElements() && !contains(partition, label)) {
+            partition.resizeIndex(partition.getMaxElements() * 2);
+        }
+        partition.addPoint(data_point, label);
+    }
+
+    void refreshPartition(unsigned int attr, hnswlib::HierarchicalNSW<dist_t>& partition) {
+        const auto& postings = filter_.postingLists();
+        auto posting = postings.find(attr);
+        const SlotIndex& slots = filter_.store().slots();
+
+        // Points that gained the attribute
+        std::vector<hnswlib::labeltype> live;
+        if (posting != postings.end()) {
+            for (uint32_t slot : posting->second) {
+                hnswlib::labeltype label = slots.labelAt(slot);
+                if (isLive(index_, label)) live.push_back(label);
+            }
+        }
+        for (hnswlib::labeltype label : live) {
+            if (isLive(partition, label)) continue;
+            hnswlib::tableint id;
+            {
+                std::unique_lock<std::mutex> lock(index_.label_lookup_lock);
+                id = index_.label_lookup_.at(label);
+            }
+            insert(partition, index_.getDataByInternalId(id), label);
+        }
+
+        // Points that lost it, or were deleted from the global index
+        std::vector<hnswlib::labeltype> stale;
+        {
+            std::unique_lock<std::mutex> lock(partition.label_lookup_lock);
+            for (const auto& entry : partition.label_lookup_) {
+                if (!partition.isMarkedDeleted(entry.second) &&
+                    (!filter_.hasAttribute(entry.first, attr) || !isLive(index_, entry.first))) {
+                    stale.push_back(entry.first);
+                }
+            }
+        }
+        for (hnswlib::labeltype label : stale) {
+            partition.markDelete(label);
+        }
+    }
+
+    hnswlib::SpaceInterface<dist_t>* space_;
+    hnswlib::HierarchicalNSW<dist_t>& index_;
+    RoaringFilter& filter_;
+    size_t M_;
+    size_t ef_construction_;
+    std::map<unsigned int, std::unique_ptr<hnswlib::HierarchicalNSW<dist_t>>> partitions_;
+};
+
+} // namespace filtering
\ No newline at end of file
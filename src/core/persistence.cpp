@@ -0,0 +1,46 @@
+#include "persistence.h"
+
+namespace filtering {
+
+static const char FILTER_MAGIC[8] = {'H', 'N', 'S', 'W', 'F', 'L', 'T', '\0'};
+
+void writeHeader(std::ostream& out, FilterFormat format, const SlotIndex& slots) {
+    FilterFileHeader header;
+    memcpy(header.magic, FILTER_MAGIC, sizeof(FILTER_MAGIC));
+    header.version = FILTER_FORMAT_VERSION;
+    header.format = format;
+    header.num_slots = slots.size();
+    hnswlib::writeBinaryPOD(out, header);
+
+    for (hnswlib::tableint slot = 0; slot < slots.size(); slot++) {
+        uint64_t label = slots.labelAt(slot);
+        hnswlib::writeBinaryPOD(out, label);
+    }
+}
+
+std::vector<hnswlib::labeltype> MappedReader::readHeader(FilterFormat format) {
+    FilterFileHeader header = read<FilterFileHeader>();
+    if (memcmp(header.magic, FILTER_MAGIC, sizeof(FILTER_MAGIC)) != 0) {
+        throw std::runtime_error("Not an attribute file");
+    }
+    if (header.version != FILTER_FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported attribute file version " + std::to_string(header.version));
+    }
+    if (header.format != format) {
+        throw std::runtime_error("Attribute file was saved by a different filter type");
+    }
+
+    const uint64_t* labels = array<uint64_t>(header.num_slots);
+    return std::vector<hnswlib::labeltype>(labels, labels + header.num_slots);
+}
+
+char* MappedReader::take(size_t num_bytes, size_t alignment) {
+    size_t start = (position_ + alignment - 1) / alignment * alignment;
+    if (start > file_.size() || num_bytes > file_.size() - start) {
+        throw std::runtime_error("Attribute file is truncated");
+    }
+    position_ = start + num_bytes;
+    return file_.data() + start;
+}
+
+} // namespace filtering
\ No newline at end of file
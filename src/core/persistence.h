@@ -0,0 +1,74 @@
+#pragma once
+#include "attribute_store.h"
+#include "../../external/hnswlib/mapped_file.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace filtering {
+
+using hnswlib::MappedFile;
+using hnswlib::writePadding;
+
+// On-disk attribute store format. Every file starts with a FilterFileHeader
+// followed by the slot labels; the rest depends on the filter:
+//   Bitset:  num_bits, words_per_row, per-attribute counts, then the slab
+//            itself, 64-byte aligned, mapped in place on load.
+//   Roaring: offsets and portable serializations of the per-point bitmaps,
+//            then those of the per-attribute posting lists, read as views.
+// Files are written in native byte order.
+constexpr uint32_t FILTER_FORMAT_VERSION = 1;
+
+enum class FilterFormat : uint32_t {
+    Bitset = 1,
+    Roaring = 2
+};
+
+struct FilterFileHeader {
+    char magic[8];
+    uint32_t version;
+    FilterFormat format;
+    uint64_t num_slots;
+};
+
+void writeHeader(std::ostream& out, FilterFormat format, const SlotIndex& slots);
+
+// Bounds-checked cursor over a mapped file; values start at their natural
+// alignment. Throws std::runtime_error when the file is truncated or was not
+// written by this version.
+class MappedReader {
+public:
+    explicit MappedReader(MappedFile& file) : file_(file), position_(0) {}
+
+    // Checks magic, version and format, and returns the slot labels
+    std::vector<hnswlib::labeltype> readHeader(FilterFormat format);
+
+    template <typename T>
+    T read() {
+        T value;
+        memcpy(&value, take(sizeof(T), alignof(T)), sizeof(T));
+        return value;
+    }
+
+    // count elements in place, starting at the next multiple of alignment
+    template <typename T>
+    T* array(size_t count, size_t alignment = alignof(T)) {
+        if (count > (file_.size() - position_) / sizeof(T)) {
+            throw std::runtime_error("Attribute file is truncated");
+        }
+        return reinterpret_cast<T*>(take(count * sizeof(T), alignment));
+    }
+
+    size_t position() const { return position_; }
+
+private:
+    char* take(size_t num_bytes, size_t alignment);
+
+    MappedFile& file_;
+    size_t position_;
+};
+
+} // namespace filtering
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+#include "roaring_filter.h"
+#include <atomic>
+#include <queue>
+#include <vector>
+
+namespace filtering {
+
+enum class SearchPlan {
+    FilteredHnsw,   // Graph traversal with the filter applied to visited nodes
+    BruteForce      // Exact distance scan over the matching points only
+};
+
+// What the planner decided for one query, for tuning the threshold from traffic
+struct PlanReport {
+    SearchPlan plan;
+    double estimated_selectivity;
+    size_t matching_points;   // Exact count, only known for BruteForce or after a fallback
+    size_t num_results;
+    bool fell_back;           // FilteredHnsw underfilled k, so the matches were scanned instead
+};
+
+// Chooses per query between filtered HNSW search and a brute-force scan,
+// based on the selectivity estimated from the filter's posting lists.
+// A filtered search that returns fewer than k results, which happens when
+// the estimate is too high, is redone as a scan of the matching points.
+// The filter must be aligned with the index (RoaringFilter::alignWith) so
+// that matching slots are internal ids of the index; searchKnn throws
+// otherwise. It leaves the filter untouched, so one planner can serve
+// concurrent queries.
+template <typename dist_t>
+class QueryPlanner {
+public:
+    QueryPlanner(const hnswlib::HierarchicalNSW<dist_t>& index, const RoaringFilter& filter,
+                 double brute_force_selectivity = 0.01)
+        : index_(index), filter_(filter), brute_force_selectivity_(brute_force_selectivity),
+          num_hnsw_plans_(0), num_brute_force_plans_(0), num_fallbacks_(0) {}
+
+    void setBruteForceSelectivity(double selectivity) { brute_force_selectivity_ = selectivity; }
+    double getBruteForceSelectivity() const { return brute_force_selectivity_; }
+
+    SearchPlan choosePlan(double estimated_selectivity) const {
+        return estimated_selectivity <= brute_force_selectivity_ ? SearchPlan::BruteForce
+                                                                 : SearchPlan::FilteredHnsw;
+    }
+
+    std::priority_queue<std::pair<dist_t, hnswlib::labeltype>>
+    searchKnn(const void* query_data, size_t k, const std::vector<unsigned int>& attrs,
+              PlanReport* report = nullptr) {
+        checkAligned(filter_, index_);
+        PlanReport plan_report{SearchPlan::FilteredHnsw, filter_.estimateSelectivity(attrs), 0, 0, false};
+        plan_report.plan = choosePlan(plan_report.estimated_selectivity);
+
+        std::priority_queue<std::pair<dist_t, hnswlib::labeltype>> result;
+        if (plan_report.plan == SearchPlan::BruteForce) {
+            roaring::Roaring slots = filter_.matchingSlots(attrs);
+            plan_report.matching_points = slots.cardinality();
+            result = scanSlots(query_data, k, slots);
+            num_brute_force_plans_++;
+        } else {
+            RoaringQuery query = filter_.makeQuery(attrs);
+            InternalIdFilter<RoaringQuery> internal_filter(query, index_);
+            result = index_.searchKnnWithFilter(query_data, k, &internal_filter);
+            num_hnsw_plans_++;
+            if (result.size() < k) {
+                // The scan only helps when the graph missed some of the matches
+                roaring::Roaring slots = filter_.matchingSlots(attrs);
+                plan_report.matching_points = slots.cardinality();
+                if (plan_report.matching_points > result.size()) {
+                    plan_report.fell_back = true;
+                    result = scanSlots(query_data, k, slots);
+                    num_fallbacks_++;
+                }
+            }
+        }
+
+        plan_report.num_results = result.size();
+        if (report) {
+            *report = plan_report;
+        }
+        return result;
+    }
+
+    size_t getNumHnswPlans() const { return num_hnsw_plans_; }
+    size_t getNumBruteForcePlans() const { return num_brute_force_plans_; }
+    // FilteredHnsw plans that were redone as a scan
+    size_t getNumFallbacks() const { return num_fallbacks_; }
+
+private:
+    // Exact k-NN over the given internal ids, using the index's (SIMD) distance function
+    std::priority_queue<std::pair<dist_t, hnswlib::labeltype>>
+    scanSlots(const void* query_data, size_t k, const roaring::Roaring& slots) const {
+        std::priority_queue<std::pair<dist_t, hnswlib::labeltype>> top;
+        if (k == 0) {
+            return top;
+        }
+        size_t num_elements = index_.cur_element_count;
+        for (uint32_t slot : slots) {
+            if (slot >= num_elements || index_.isMarkedDeleted(slot)) {
+                continue;
+            }
+            dist_t dist = index_.fstdistfunc_(query_data, index_.getDataByInternalId(slot),
+                                              index_.dist_func_param_);
+            if (top.size() < k) {
+                top.emplace(dist, index_.getExternalLabel(slot));
+            } else if (dist < top.top().first) {
+                top.pop();
+                top.emplace(dist, index_.getExternalLabel(slot));
+            }
+        }
+        return top;
+    }
+
+    const hnswlib::HierarchicalNSW<dist_t>& index_;
+    const RoaringFilter& filter_;
+    double brute_force_selectivity_;
+    std::atomic<size_t> num_hnsw_plans_;
+    std::atomic<size_t> num_brute_force_plans_;
+    std::atomic<size_t> num_fallbacks_;
+};
+
+} // namespace filtering
\ No newline at end of file
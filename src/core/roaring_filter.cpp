@@ -1,60 +1,118 @@
 #define ROARING_AMALGAMATION
 #include "roaring.c"  // Include the implementation here
 #include "roaring_filter.h"
+#include "parallel_for.h"
 #include <stdexcept>
+#include <algorithm>
+#include <fstream>
 
 namespace filtering {
 
-RoaringFilter::RoaringFilter() : total_operations_(0), total_time_ms_(0) {}
+namespace {
+
+// Flattens a set of slots to one bit per slot
+std::vector<uint64_t> toWords(const roaring::Roaring& slots, size_t num_slots) {
+    std::vector<uint64_t> words((num_slots + 63) / 64, 0);
+    for (uint32_t slot : slots) {
+        if ((slot >> 6) >= words.size()) {
+            words.resize((slot >> 6) + 1, 0);
+        }
+        words[slot >> 6] |= uint64_t(1) << (slot & 63);
+    }
+    return words;
+}
+
+// Offsets, then the portable serializations of the given bitmaps
+void writeBitmaps(std::ostream& out, const std::vector<const roaring::Roaring*>& bitmaps) {
+    writePadding(out, sizeof(uint64_t));
+    uint64_t offset = 0;
+    hnswlib::writeBinaryPOD(out, offset);
+    for (const roaring::Roaring* bitmap : bitmaps) {
+        offset += bitmap->getSizeInBytes(true);
+        hnswlib::writeBinaryPOD(out, offset);
+    }
+
+    std::vector<char> buffer;
+    for (const roaring::Roaring* bitmap : bitmaps) {
+        buffer.resize(bitmap->getSizeInBytes(true));
+        bitmap->write(buffer.data(), true);
+        out.write(buffer.data(), buffer.size());
+    }
+}
+
+// Read-only views of count bitmaps written by writeBitmaps. Container
+// payloads stay in the mapping, which must outlive the views.
+std::vector<roaring::Roaring> readBitmaps(MappedReader& reader, size_t count) {
+    const uint64_t* offsets = reader.array<uint64_t>(count + 1);
+    const char* data = reader.array<char>(offsets[count]);
+
+    std::vector<roaring::Roaring> bitmaps(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t num_bytes = offsets[i + 1] - offsets[i];
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > offsets[count] ||
+            roaring::api::roaring_bitmap_portable_deserialize_size(data + offsets[i], num_bytes) != num_bytes) {
+            throw std::runtime_error("Corrupt bitmap in attribute file");
+        }
+        roaring::api::roaring_bitmap_t* view =
+            roaring::api::roaring_bitmap_portable_deserialize_frozen(data + offsets[i]);
+        if (view == nullptr) {
+            throw std::bad_alloc();
+        }
+        // As in Roaring::frozenView, the wrapper takes over the view's allocation
+        bitmaps[i].roaring = *view;
+    }
+    return bitmaps;
+}
+
+} // namespace
+
+RoaringFilter::RoaringFilter()
+    : query_mode_(QueryMode::PerPoint) {}
 
 RoaringFilter::RoaringFilter(const std::vector<unsigned int>& query_attributes) 
-    : total_operations_(0), total_time_ms_(0) {
+    : query_mode_(QueryMode::PerPoint) {
     setQueryAttributes(query_attributes);
 }
 
 bool RoaringFilter::operator()(hnswlib::labeltype label_id) {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::Query);
     
-    auto it = point_attributes_.find(label_id);
     bool result = false;
-    
-    if (it != point_attributes_.end()) {
-        // Check if all query bits are present in point's bitmap
-        result = query_bitmap_.isSubset(it->second);
+    if (query_mode_ == QueryMode::Materialized) {
+        result = isAllowedSlot(point_attributes_.slots().find(label_id));
+    } else {
+        auto* point = point_attributes_.find(label_id);
+        if (point != nullptr) {
+            // Check if all query bits are present in point's bitmap
+            result = query_bitmap_.isSubset(*point);
+        }
     }
     
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
-    
     return result;
 }
 
+bool RoaringFilter::matchesSlot(hnswlib::tableint slot) const {
+    if (query_mode_ == QueryMode::Materialized) {
+        return isAllowedSlot(slot);
+    }
+    return slot < point_attributes_.size() && query_bitmap_.isSubset(point_attributes_.row(slot));
+}
+
 bool RoaringFilter::hasAttribute(hnswlib::labeltype point_id, unsigned int attr_id) const {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::HasAttribute);
     
-    auto it = point_attributes_.find(point_id);
-    bool result = (it != point_attributes_.end() && it->second.contains(attr_id));
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+    auto* point = point_attributes_.find(point_id);
+    bool result = (point != nullptr && point->contains(attr_id));
     
     return result;
 }
 
 bool RoaringFilter::hasAttributes(hnswlib::labeltype point_id, 
                                 const std::vector<unsigned int>& attrs) const {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::HasAttributes);
     
-    auto it = point_attributes_.find(point_id);
-    if (it == point_attributes_.end()) {
-        auto end = std::chrono::high_resolution_clock::now();
-        last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-        total_time_ms_ += last_operation_time_ms_;
-        total_operations_++;
+    auto* point = point_attributes_.find(point_id);
+    if (point == nullptr) {
         return false;
     }
 
@@ -63,39 +121,75 @@ bool RoaringFilter::hasAttributes(hnswlib::labeltype point_id,
         query.add(attr);
     }
     
-    bool result = query.isSubset(it->second);
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+    bool result = query.isSubset(*point);
     
     return result;
 }
 
 void RoaringFilter::addAttribute(hnswlib::labeltype point_id, unsigned int attr_id) {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
-    
-    point_attributes_[point_id].add(attr_id);
+    ScopedOpTimer timer(metrics_, FilterOp::AddAttribute);
     
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
+    copyMappedBitmaps();
+    point_attributes_.getOrCreate(point_id).add(attr_id);
+    hnswlib::tableint slot = point_attributes_.slots().find(point_id);
+    all_slots_.add(slot);
+    attribute_points_[attr_id].add(slot);
+    updateAllowedSlot(slot);
 }
 
 void RoaringFilter::removeAttribute(hnswlib::labeltype point_id, unsigned int attr_id) {
-    last_operation_start_ = std::chrono::high_resolution_clock::now();
+    ScopedOpTimer timer(metrics_, FilterOp::RemoveAttribute);
     
-    auto it = point_attributes_.find(point_id);
-    if (it != point_attributes_.end()) {
-        it->second.remove(attr_id);
+    copyMappedBitmaps();
+    auto* point = point_attributes_.find(point_id);
+    if (point != nullptr) {
+        point->remove(attr_id);
+        hnswlib::tableint slot = point_attributes_.slots().find(point_id);
+        auto posting = attribute_points_.find(attr_id);
+        if (posting != attribute_points_.end()) {
+            posting->second.remove(slot);
+        }
+        updateAllowedSlot(slot);
+    }
+}
+
+void RoaringFilter::addPoints(const AttributeBatch& batch, size_t num_threads) {
+    copyMappedBitmaps();
+
+    point_attributes_.reserve(point_attributes_.size() + batch.num_points);
+    std::vector<hnswlib::tableint> slots(batch.num_points);
+    for (size_t i = 0; i < batch.num_points; i++) {
+        slots[i] = point_attributes_.getOrCreateSlot(batch.labels[i]);
+    }
+    all_slots_.addMany(slots.size(), slots.data());
+
+    parallelForRanges(batch.num_points, num_threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            point_attributes_.row(slots[i]).addMany(batch.offsets[i + 1] - batch.offsets[i],
+                                                    batch.attributes + batch.offsets[i]);
+        }
+    });
+
+    // New slots per attribute, in batch order, so each posting list gets one addMany
+    std::unordered_map<unsigned int, std::vector<uint32_t>> attribute_slots;
+    for (size_t i = 0; i < batch.num_points; i++) {
+        for (size_t j = batch.offsets[i]; j < batch.offsets[i + 1]; j++) {
+            attribute_slots[batch.attributes[j]].push_back(slots[i]);
+        }
+    }
+    std::vector<std::pair<roaring::Roaring*, const std::vector<uint32_t>*>> postings;
+    for (const auto& entry : attribute_slots) {
+        postings.emplace_back(&attribute_points_[entry.first], &entry.second);
+    }
+    parallelForRanges(postings.size(), num_threads, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            postings[k].first->addMany(postings[k].second->size(), postings[k].second->data());
+        }
+    });
+
+    if (query_mode_ == QueryMode::Materialized) {
+        materializeQuery();
     }
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    last_operation_time_ms_ = std::chrono::duration<double, std::milli>(end - last_operation_start_).count();
-    total_time_ms_ += last_operation_time_ms_;
-    total_operations_++;
 }
 
 void RoaringFilter::setQueryAttributes(const std::vector<unsigned int>& attributes) {
@@ -103,35 +197,313 @@ void RoaringFilter::setQueryAttributes(const std::vector<unsigned int>& attribut
     for (unsigned int attr : attributes) {
         query_bitmap_.add(attr);
     }
+    if (query_mode_ == QueryMode::Materialized) {
+        materializeQuery();
+    }
 }
 
-size_t RoaringFilter::getNumAttributes(hnswlib::labeltype point_id) const {
-    auto it = point_attributes_.find(point_id);
-    return it != point_attributes_.end() ? it->second.cardinality() : 0;
+void RoaringFilter::setQueryMode(QueryMode mode) {
+    query_mode_ = mode;
+    if (query_mode_ == QueryMode::Materialized) {
+        materializeQuery();
+    } else {
+        allowed_slots_ = roaring::Roaring();
+        allowed_words_.clear();
+    }
 }
 
-size_t RoaringFilter::getCardinality(hnswlib::labeltype point_id) const {
-    auto it = point_attributes_.find(point_id);
-    return it != point_attributes_.end() ? it->second.cardinality() : 0;
+void RoaringFilter::materializeQuery() {
+    std::vector<unsigned int> attrs;
+    for (uint32_t attr : query_bitmap_) {
+        attrs.push_back(attr);
+    }
+    allowed_slots_ = matchingSlots(attrs);
+    allowed_words_ = toWords(allowed_slots_, point_attributes_.size());
+}
+
+RoaringQuery RoaringFilter::makeQuery(const std::vector<unsigned int>& attributes) const {
+    return RoaringQuery(*this, attributes);
 }
 
-double RoaringFilter::getLastOperationTimeMs() const {
-    return last_operation_time_ms_;
+RoaringQuery::RoaringQuery(const RoaringFilter& filter, const std::vector<unsigned int>& attributes)
+    : filter_(filter), materialized_(filter.query_mode_ == QueryMode::Materialized) {
+    for (unsigned int attr : attributes) {
+        query_bitmap_.add(attr);
+    }
+    if (materialized_) {
+        allowed_words_ = toWords(filter.matchingSlots(attributes), filter.point_attributes_.size());
+    }
 }
 
-uint64_t RoaringFilter::getTotalOperations() const {
-    return total_operations_;
+RoaringQuery RoaringFilter::makeQuery(const FilterExpression& expr) const {
+    return RoaringQuery(*this, matchingSlots(expr));
 }
 
-double RoaringFilter::getAverageOperationTimeMs() const {
-    return total_operations_ > 0 ? total_time_ms_ / total_operations_ : 0.0;
+RoaringQuery::RoaringQuery(const RoaringFilter& filter, const roaring::Roaring& allowed_slots)
+    : filter_(filter), materialized_(true),
+      allowed_words_(toWords(allowed_slots, filter.point_attributes_.size())) {}
+
+bool RoaringQuery::matches(hnswlib::labeltype label_id) const {
+    ScopedOpTimer timer(filter_.metrics_, FilterOp::Query);
+
+    if (materialized_) {
+        return matchesSlot(filter_.point_attributes_.slots().find(label_id));
+    }
+    auto* point = filter_.point_attributes_.find(label_id);
+    return point != nullptr && query_bitmap_.isSubset(*point);
+}
+
+roaring::Roaring RoaringFilter::matchingSlots(const std::vector<unsigned int>& attrs) const {
+    roaring::Roaring result;
+    if (attrs.empty()) {
+        // Every stored point satisfies an empty conjunction
+        return all_slots_;
+    }
+
+    // Intersect the rarest posting lists first so the running result shrinks fast
+    std::vector<const roaring::Roaring*> postings;
+    for (unsigned int attr : attrs) {
+        auto posting = attribute_points_.find(attr);
+        if (posting == attribute_points_.end()) {
+            return result;
+        }
+        postings.push_back(&posting->second);
+    }
+    std::sort(postings.begin(), postings.end(),
+        [](const roaring::Roaring* a, const roaring::Roaring* b) {
+            return a->cardinality() < b->cardinality();
+        });
+    result = *postings[0];
+    for (size_t i = 1; i < postings.size() && !result.isEmpty(); i++) {
+        result &= *postings[i];
+    }
+    return result;
+}
+
+void RoaringFilter::rebuildAllSlots() {
+    all_slots_ = roaring::Roaring();
+    const SlotIndex& slots = point_attributes_.slots();
+    for (hnswlib::tableint slot = 0; slot < slots.size(); slot++) {
+        if (slots.labelAt(slot) != SlotIndex::NO_LABEL) {
+            all_slots_.add(slot);
+        }
+    }
+    // Mostly a single run of slots once aligned
+    all_slots_.runOptimize();
+}
+
+FilterPlan RoaringFilter::compilePlan(const FilterExpression& expr) const {
+    return FilterPlan::compile(expr, point_attributes_.slots().numLabels(),
+        [this](unsigned int attr) { return getAttributeCardinality(attr); });
+}
+
+roaring::Roaring RoaringFilter::matchingSlots(const FilterExpression& expr) const {
+    return evaluateSlots(compilePlan(expr), 0);
+}
+
+roaring::Roaring RoaringFilter::evaluateSlots(const FilterPlan& plan, uint32_t node) const {
+    const auto& nodes = plan.nodes();
+    const PlanNode& current = nodes[node];
+    switch (current.op) {
+        case PlanNode::Op::AllOf:
+            return matchingSlots(current.attributes);
+
+        case PlanNode::Op::AnyOf: {
+            std::vector<const roaring::Roaring*> postings;
+            for (unsigned int attr : current.attributes) {
+                auto posting = attribute_points_.find(attr);
+                if (posting != attribute_points_.end()) {
+                    postings.push_back(&posting->second);
+                }
+            }
+            return roaring::Roaring::fastunion(postings.size(), postings.data());
+        }
+
+        case PlanNode::Op::Not:
+            return all_slots_ - evaluateSlots(plan, node + 1);
+
+        case PlanNode::Op::Or: {
+            roaring::Roaring result;
+            for (uint32_t child = node + 1; child < current.end; child = nodes[child].end) {
+                result |= evaluateSlots(plan, child);
+            }
+            return result;
+        }
+
+        default: {
+            // Intersect positive clauses in plan order, then subtract the negated ones
+            roaring::Roaring result;
+            bool started = false;
+            for (uint32_t child = node + 1; child < current.end; child = nodes[child].end) {
+                if (nodes[child].op == PlanNode::Op::Not) {
+                    continue;
+                }
+                if (!started) {
+                    result = evaluateSlots(plan, child);
+                    started = true;
+                } else {
+                    result &= evaluateSlots(plan, child);
+                }
+                if (result.isEmpty()) {
+                    return result;
+                }
+            }
+            if (!started) {
+                result = all_slots_;
+            }
+            for (uint32_t child = node + 1; child < current.end && !result.isEmpty(); child = nodes[child].end) {
+                if (nodes[child].op == PlanNode::Op::Not) {
+                    result -= evaluateSlots(plan, child + 1);
+                }
+            }
+            return result;
+        }
+    }
+}
+
+size_t RoaringFilter::getAttributeCardinality(unsigned int attr_id) const {
+    auto posting = attribute_points_.find(attr_id);
+    return posting != attribute_points_.end() ? posting->second.cardinality() : 0;
+}
+
+double RoaringFilter::estimateSelectivity(const std::vector<unsigned int>& attrs) const {
+    // Gap slots left by alignWith hold no point
+    size_t num_points = point_attributes_.slots().numLabels();
+    if (num_points == 0) {
+        return 0.0;
+    }
+    double selectivity = 1.0;
+    for (unsigned int attr : attrs) {
+        selectivity *= static_cast<double>(getAttributeCardinality(attr)) / num_points;
+    }
+    return selectivity;
+}
+
+void RoaringFilter::updateAllowedSlot(hnswlib::tableint slot) {
+    if (query_mode_ != QueryMode::Materialized) {
+        return;
+    }
+    if ((slot >> 6) >= allowed_words_.size()) {
+        allowed_words_.resize((slot >> 6) + 1, 0);
+    }
+    uint64_t bit = uint64_t(1) << (slot & 63);
+    if (query_bitmap_.isSubset(point_attributes_.row(slot))) {
+        allowed_slots_.add(slot);
+        allowed_words_[slot >> 6] |= bit;
+    } else {
+        allowed_slots_.remove(slot);
+        allowed_words_[slot >> 6] &= ~bit;
+    }
+}
+
+void RoaringFilter::rebuildInvertedIndex() {
+    rebuildAllSlots();
+    attribute_points_.clear();
+    for (hnswlib::tableint slot = 0; slot < point_attributes_.size(); slot++) {
+        for (uint32_t attr : point_attributes_.row(slot)) {
+            attribute_points_[attr].add(slot);
+        }
+    }
+    if (query_mode_ == QueryMode::Materialized) {
+        materializeQuery();
+    }
+}
+
+void RoaringFilter::saveAttributes(const std::string& location) const {
+    std::ofstream output(location, std::ios::binary);
+    if (!output) {
+        throw std::runtime_error("Cannot open file " + location);
+    }
+
+    writeHeader(output, FilterFormat::Roaring, point_attributes_.slots());
+    std::vector<const roaring::Roaring*> rows;
+    for (const auto& row : point_attributes_.rows()) {
+        rows.push_back(&row);
+    }
+    writeBitmaps(output, rows);
+
+    // Posting lists in attribute order, so equal filters save identical files
+    std::vector<unsigned int> attrs;
+    for (const auto& posting : attribute_points_) {
+        attrs.push_back(posting.first);
+    }
+    std::sort(attrs.begin(), attrs.end());
+    std::vector<const roaring::Roaring*> postings;
+    writePadding(output, sizeof(uint64_t));
+    hnswlib::writeBinaryPOD(output, static_cast<uint64_t>(attrs.size()));
+    for (unsigned int attr : attrs) {
+        hnswlib::writeBinaryPOD(output, static_cast<uint32_t>(attr));
+        postings.push_back(&attribute_points_.at(attr));
+    }
+    writeBitmaps(output, postings);
+    if (!output) {
+        throw std::runtime_error("Cannot write file " + location);
+    }
+}
+
+void RoaringFilter::loadAttributes(const std::string& location) {
+    auto file = std::make_shared<MappedFile>(location);
+    MappedReader reader(*file);
+    std::vector<hnswlib::labeltype> slot_labels = reader.readHeader(FilterFormat::Roaring);
+    std::vector<roaring::Roaring> rows = readBitmaps(reader, slot_labels.size());
+
+    uint64_t num_postings = reader.read<uint64_t>();
+    const uint32_t* attrs = reader.array<uint32_t>(num_postings);
+    std::vector<roaring::Roaring> postings = readBitmaps(reader, num_postings);
+
+    point_attributes_.assign(std::move(slot_labels), std::move(rows));
+    attribute_points_.clear();
+    for (size_t i = 0; i < num_postings; i++) {
+        attribute_points_.emplace(attrs[i], std::move(postings[i]));
+    }
+    rebuildAllSlots();
+    mapped_file_ = std::move(file);
+
+    if (query_mode_ == QueryMode::Materialized) {
+        materializeQuery();
+    }
+}
+
+void RoaringFilter::copyMappedBitmaps() {
+    if (!mapped_file_) {
+        return;
+    }
+    // Copies own their containers; the views are destroyed, never assigned to
+    const SlotIndex& slots = point_attributes_.slots();
+    std::vector<hnswlib::labeltype> slot_labels;
+    for (hnswlib::tableint slot = 0; slot < slots.size(); slot++) {
+        slot_labels.push_back(slots.labelAt(slot));
+    }
+    std::vector<roaring::Roaring> rows(point_attributes_.rows().begin(), point_attributes_.rows().end());
+    point_attributes_.assign(std::move(slot_labels), std::move(rows));
+
+    std::unordered_map<unsigned int, roaring::Roaring> attribute_points;
+    for (const auto& posting : attribute_points_) {
+        attribute_points.emplace(posting.first, roaring::Roaring(posting.second));
+    }
+    attribute_points_ = std::move(attribute_points);
+    mapped_file_.reset();
+}
+
+size_t RoaringFilter::getNumAttributes(hnswlib::labeltype point_id) const {
+    auto* point = point_attributes_.find(point_id);
+    return point != nullptr ? point->cardinality() : 0;
+}
+
+size_t RoaringFilter::getCardinality(hnswlib::labeltype point_id) const {
+    auto* point = point_attributes_.find(point_id);
+    return point != nullptr ? point->cardinality() : 0;
 }
 
 size_t RoaringFilter::getMemoryUsage() const {
     size_t total = 0;
-    for (const auto& pair : point_attributes_) {
-        total += pair.second.getSizeInBytes();
+    for (const auto& bitmap : point_attributes_.rows()) {
+        total += bitmap.getSizeInBytes();
+    }
+    for (const auto& posting : attribute_points_) {
+        total += posting.second.getSizeInBytes();
     }
+    total += all_slots_.getSizeInBytes();
     return total;
 }
 
@@ -1,11 +1,21 @@
 #pragma once
 #include "filter_interface.h"
+#include "attribute_store.h"
+#include "filter_metrics.h"
+#include "filter_expression.h"
+#include "persistence.h"
 #include "../../external/roaring/roaring.hh"  // Keep this as we're using C++ interface
 #include <unordered_map>
-#include <chrono>
 
 namespace filtering {
 
+enum class QueryMode {
+    PerPoint,      // Test query bitmap against the point's bitmap on every call
+    Materialized   // Intersect posting lists once per query, then a bit test per call
+};
+
+class RoaringQuery;
+
 class RoaringFilter : public BaseFilter {
 public:
     RoaringFilter();
@@ -17,30 +27,123 @@ public:
     bool hasAttributes(hnswlib::labeltype point_id, const std::vector<unsigned int>& attrs) const override;
     void addAttribute(hnswlib::labeltype point_id, unsigned int attr_id) override;
     void removeAttribute(hnswlib::labeltype point_id, unsigned int attr_id) override;
+    // Builds point bitmaps and posting lists with addMany, in parallel over points
+    // and then over attributes
+    void addPoints(const AttributeBatch& batch, size_t num_threads = 1) override;
 
     // Additional functionality
     void setQueryAttributes(const std::vector<unsigned int>& attributes);
+    void setQueryMode(QueryMode mode);
+    // Per-query predicate that leaves this filter untouched, for concurrent searches.
+    // Uses the filter's current query mode.
+    RoaringQuery makeQuery(const std::vector<unsigned int>& attributes) const;
+    // Predicate for a boolean expression, evaluated once as bitmap algebra over the posting lists
+    RoaringQuery makeQuery(const FilterExpression& expr) const;
+    QueryMode getQueryMode() const { return query_mode_; }
+    // Slots allowed by the current query (Materialized mode only)
+    const roaring::Roaring& getAllowedSlots() const { return allowed_slots_; }
     size_t getNumAttributes(hnswlib::labeltype point_id) const;
     size_t getCardinality(hnswlib::labeltype point_id) const;
+
+    // Statistics from the inverted index
+    size_t getAttributeCardinality(unsigned int attr_id) const;
+    // Estimated fraction of stored points having all attrs, assuming independent attributes
+    double estimateSelectivity(const std::vector<unsigned int>& attrs) const;
+    // Exact slots having all attrs, by intersecting posting lists
+    roaring::Roaring matchingSlots(const std::vector<unsigned int>& attrs) const;
+    roaring::Roaring matchingSlots(const FilterExpression& expr) const;
+    // Inverted index: attribute -> slots of the points that have it
+    const std::unordered_map<unsigned int, roaring::Roaring>& postingLists() const { return attribute_points_; }
+    // Plan for expr, ordered by this filter's attribute cardinalities
+    FilterPlan compilePlan(const FilterExpression& expr) const;
+
+    // Query check by storage slot, i.e. by internal id once aligned. Not timed.
+    bool matchesSlot(hnswlib::tableint slot) const;
+
+    // Re-lays out storage so that slot == internal id of the given index
+    template <typename dist_t>
+    void alignWith(const hnswlib::HierarchicalNSW<dist_t>& index) {
+        point_attributes_.alignWith(index);
+        rebuildInvertedIndex();
+    }
+    const AttributeStore<roaring::Roaring>& store() const { return point_attributes_; }
+    const SlotIndex& slots() const { return point_attributes_.slots(); }
+
+    // Writes the attributes, e.g. next to an index written by saveIndex
+    void saveAttributes(const std::string& location) const;
+    // Replaces the attributes with those saved at location. Bitmaps are read-only
+    // views into the mapped file until the first add/remove copies them.
+    void loadAttributes(const std::string& location);
     
-    // Performance metrics
-    double getLastOperationTimeMs() const;
-    uint64_t getTotalOperations() const;
-    double getAverageOperationTimeMs() const;
+    // Sampled latency histograms; only populated when built with FILTERING_INSTRUMENTATION
+    FilterMetrics& metrics() { return metrics_; }
+    const FilterMetrics& metrics() const { return metrics_; }
     size_t getMemoryUsage() const;
 
 private:
-    // Data storage: point_id -> roaring bitmap of attributes
-    std::unordered_map<hnswlib::labeltype, roaring::Roaring> point_attributes_;
+    // Data storage: slot -> roaring bitmap of attributes
+    AttributeStore<roaring::Roaring> point_attributes_;
     
+    // Inverted index: attribute -> slots of the points that have it
+    std::unordered_map<unsigned int, roaring::Roaring> attribute_points_;
+    // Every labelled slot: what NOT and an empty conjunction start from
+    roaring::Roaring all_slots_;
+
+    // File the bitmaps are viewed from after loadAttributes, until they are copied
+    std::shared_ptr<MappedFile> mapped_file_;
+
     // Query bitmap
     roaring::Roaring query_bitmap_;
 
+    // Materialized query: allowed slots, also flattened to words for O(1) lookups
+    QueryMode query_mode_;
+    roaring::Roaring allowed_slots_;
+    std::vector<uint64_t> allowed_words_;
+
+    inline bool isAllowedSlot(hnswlib::tableint slot) const {
+        size_t word = slot >> 6;
+        return word < allowed_words_.size() && ((allowed_words_[word] >> (slot & 63)) & 1);
+    }
+    void materializeQuery();
+    void updateAllowedSlot(hnswlib::tableint slot);
+    void rebuildInvertedIndex();
+    void copyMappedBitmaps();
+    void rebuildAllSlots();
+    roaring::Roaring evaluateSlots(const FilterPlan& plan, uint32_t node) const;
+
     // Performance tracking
-    mutable std::chrono::high_resolution_clock::time_point last_operation_start_;
-    mutable double last_operation_time_ms_;
-    mutable uint64_t total_operations_;
-    mutable double total_time_ms_;
+    FilterMetrics metrics_;
+
+    friend class RoaringQuery;
+};
+
+// Immutable predicate for one query against a RoaringFilter. Any number of
+// queries can be evaluated from different threads at once, as long as the
+// filter's attributes are not modified meanwhile.
+class RoaringQuery {
+public:
+    RoaringQuery(const RoaringFilter& filter, const std::vector<unsigned int>& attributes);
+
+    bool matches(hnswlib::labeltype label_id) const;
+    bool matchesSlot(hnswlib::tableint slot) const {
+        if (materialized_) {
+            size_t word = slot >> 6;
+            return word < allowed_words_.size() && ((allowed_words_[word] >> (slot & 63)) & 1);
+        }
+        const auto& store = filter_.point_attributes_;
+        return slot < store.size() && query_bitmap_.isSubset(store.row(slot));
+    }
+    const SlotIndex& slots() const { return filter_.slots(); }
+
+private:
+    friend class RoaringFilter;
+    // Materialized query over the given allowed slots
+    RoaringQuery(const RoaringFilter& filter, const roaring::Roaring& allowed_slots);
+
+    const RoaringFilter& filter_;
+    roaring::Roaring query_bitmap_;
+    bool materialized_;
+    std::vector<uint64_t> allowed_words_;
 };
 
 } // namespace filtering
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "workload.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <random>
+#include <stdexcept>
+
+namespace filtering {
+
+namespace {
+
+// Draws ranks 0 .. n - 1 with probability proportional to 1 / (rank + 1)^s
+class ZipfSampler {
+public:
+    ZipfSampler(size_t n, double exponent) : cdf_(n) {
+        double total = 0.0;
+        for (size_t rank = 0; rank < n; rank++) {
+            total += 1.0 / std::pow(double(rank + 1), exponent);
+            cdf_[rank] = total;
+        }
+        for (double& p : cdf_) p /= total;
+    }
+
+    size_t operator()(std::mt19937& gen) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+        size_t rank = std::upper_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return std::min(rank, cdf_.size() - 1);
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+} // namespace
+
+Workload::Workload(const WorkloadOptions& options) : options_(options) {
+    if (options_.dim == 0 || options_.num_clusters == 0) {
+        throw std::invalid_argument("Workload needs a dimension and at least one cluster");
+    }
+    const size_t dim = options_.dim;
+    const size_t num_clusters = options_.num_clusters;
+    const size_t num_attributes = options_.num_attributes;
+    const size_t per_point = std::min(options_.attributes_per_point, num_attributes);
+
+    std::mt19937 gen(options_.seed);
+    std::uniform_real_distribution<float> dis_center(-options_.center_range, options_.center_range);
+    std::normal_distribution<float> dis_offset(0.0f, options_.cluster_stddev);
+    std::uniform_int_distribution<size_t> dis_cluster(0, num_clusters - 1);
+    std::uniform_real_distribution<double> dis_unit(0.0, 1.0);
+
+    centers_.resize(num_clusters * dim);
+    for (float& x : centers_) x = dis_center(gen);
+
+    // Attributes homed at cluster c are c, c + num_clusters, ...; the local
+    // sampler ranks them in that order, so global popularity carries over
+    ZipfSampler global(std::max<size_t>(num_attributes, 1), options_.zipf_exponent);
+    ZipfSampler local(std::max<size_t>((num_attributes + num_clusters - 1) / num_clusters, 1),
+                      options_.zipf_exponent);
+
+    vectors_.resize(options_.num_points * dim);
+    cluster_of_.resize(options_.num_points);
+    labels_.resize(options_.num_points);
+    offsets_.assign(1, 0);
+    attributes_.reserve(options_.num_points * per_point);
+    attribute_counts_.assign(num_attributes, 0);
+
+    std::vector<unsigned int> point_attributes;
+    for (size_t i = 0; i < options_.num_points; i++) {
+        const size_t cluster = dis_cluster(gen);
+        cluster_of_[i] = cluster;
+        labels_[i] = i;
+        for (size_t j = 0; j < dim; j++) {
+            vectors_[i * dim + j] = centers_[cluster * dim + j] + dis_offset(gen);
+        }
+
+        // Duplicates are redrawn; after a bounded number of tries the point
+        // keeps fewer attributes rather than looping on a skewed law
+        point_attributes.clear();
+        for (size_t tries = 0; point_attributes.size() < per_point && tries < 20 * per_point; tries++) {
+            size_t attr;
+            if (cluster < num_attributes && dis_unit(gen) < options_.cluster_correlation) {
+                attr = cluster + local(gen) * num_clusters;
+                if (attr >= num_attributes) continue;
+            } else {
+                attr = global(gen);
+            }
+            if (std::find(point_attributes.begin(), point_attributes.end(), attr) == point_attributes.end()) {
+                point_attributes.push_back(attr);
+            }
+        }
+        std::sort(point_attributes.begin(), point_attributes.end());
+        for (unsigned int attr : point_attributes) attribute_counts_[attr]++;
+        attributes_.insert(attributes_.end(), point_attributes.begin(), point_attributes.end());
+        offsets_.push_back(attributes_.size());
+    }
+}
+
+std::vector<unsigned int> Workload::attributes(size_t i) const {
+    return std::vector<unsigned int>(attributes_.begin() + offsets_[i], attributes_.begin() + offsets_[i + 1]);
+}
+
+bool Workload::hasAttributes(size_t i, const std::vector<unsigned int>& attributes) const {
+    auto begin = attributes_.begin() + offsets_[i], end = attributes_.begin() + offsets_[i + 1];
+    for (unsigned int attr : attributes) {
+        if (!std::binary_search(begin, end, attr)) return false;
+    }
+    return true;
+}
+
+AttributeBatch Workload::attributeBatch(size_t begin, size_t end) const {
+    end = std::min(end, size());
+    begin = std::min(begin, end);
+    return AttributeBatch{labels_.data() + begin, end - begin, offsets_.data() + begin, attributes_.data()};
+}
+
+double Workload::selectivity(unsigned int attribute) const {
+    return attribute < attribute_counts_.size() && size() > 0 ? double(attribute_counts_[attribute]) / size() : 0.0;
+}
+
+std::vector<WorkloadQuery> Workload::generateQueries(const std::vector<QueryClass>& mix, size_t count,
+                                                     uint32_t seed) const {
+    if (mix.empty()) {
+        throw std::invalid_argument("Query mix is empty");
+    }
+    // Candidate first attributes per class
+    std::vector<double> weights;
+    std::vector<std::vector<unsigned int>> candidates(mix.size());
+    for (size_t c = 0; c < mix.size(); c++) {
+        weights.push_back(mix[c].weight);
+        if (mix[c].num_attributes == 0) continue;
+        for (unsigned int attr = 0; attr < attribute_counts_.size(); attr++) {
+            double s = selectivity(attr);
+            if (attribute_counts_[attr] > 0 && s >= mix[c].min_selectivity && s <= mix[c].max_selectivity) {
+                candidates[c].push_back(attr);
+            }
+        }
+        if (candidates[c].empty() && mix[c].weight > 0) {
+            throw std::invalid_argument("No attribute in the selectivity range of a query class");
+        }
+    }
+
+    const size_t dim = options_.dim;
+    const size_t num_clusters = options_.num_clusters;
+    std::mt19937 gen(seed);
+    std::discrete_distribution<size_t> dis_class(weights.begin(), weights.end());
+    std::uniform_int_distribution<size_t> dis_cluster(0, num_clusters - 1);
+    std::normal_distribution<float> dis_offset(0.0f, options_.cluster_stddev);
+
+    std::vector<WorkloadQuery> queries(count);
+    std::vector<size_t> matches;
+    std::vector<size_t> matches_per_cluster(num_clusters);
+    for (WorkloadQuery& query : queries) {
+        const size_t c = dis_class(gen);
+        const QueryClass& query_class = mix[c];
+        query.locality = query_class.locality;
+        matches.clear();
+
+        if (query_class.num_attributes > 0) {
+            unsigned int attr = candidates[c][std::uniform_int_distribution<size_t>(0, candidates[c].size() - 1)(gen)];
+            query.attributes.push_back(attr);
+            for (size_t i = 0; i < size(); i++) {
+                if (hasAttributes(i, query.attributes)) matches.push_back(i);
+            }
+            // The rest come from one matching point
+            std::vector<unsigned int> extra = attributes(matches[gen() % matches.size()]);
+            extra.erase(std::find(extra.begin(), extra.end(), attr));
+            std::shuffle(extra.begin(), extra.end(), gen);
+            extra.resize(std::min(extra.size(), query_class.num_attributes - 1));
+            if (!extra.empty()) {
+                query.attributes.insert(query.attributes.end(), extra.begin(), extra.end());
+                std::sort(query.attributes.begin(), query.attributes.end());
+                matches.erase(std::remove_if(matches.begin(), matches.end(),
+                                             [&](size_t i) { return !hasAttributes(i, query.attributes); }),
+                              matches.end());
+            }
+            query.selectivity = double(matches.size()) / size();
+        } else {
+            query.selectivity = 1.0;
+        }
+
+        size_t cluster = dis_cluster(gen);
+        if (!matches.empty() && query.locality == QueryLocality::Correlated) {
+            cluster = cluster_of_[matches[gen() % matches.size()]];
+        } else if (!matches.empty() && query.locality == QueryLocality::AntiCorrelated) {
+            // Fewest matches, ties broken from a random start
+            std::fill(matches_per_cluster.begin(), matches_per_cluster.end(), 0);
+            for (size_t i : matches) matches_per_cluster[cluster_of_[i]]++;
+            const size_t start = cluster;
+            for (size_t step = 1; step < num_clusters; step++) {
+                size_t candidate = (start + step) % num_clusters;
+                if (matches_per_cluster[candidate] < matches_per_cluster[cluster]) cluster = candidate;
+            }
+        }
+        query.vector.resize(dim);
+        for (size_t j = 0; j < dim; j++) query.vector[j] = centers_[cluster * dim + j] + dis_offset(gen);
+    }
+    return queries;
+}
+
+std::vector<hnswlib::labeltype> Workload::exactKnn(const float* query, const std::vector<unsigned int>& attributes,
+                                                   size_t k) const {
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> nearest;
+    for (size_t i = 0; i < size(); i++) {
+        if (!hasAttributes(i, attributes)) continue;
+        const float* point = vector(i);
+        float dist = 0.0f;
+        for (size_t j = 0; j < options_.dim; j++) {
+            float diff = query[j] - point[j];
+            dist += diff * diff;
+        }
+        if (nearest.size() < k || dist < nearest.top().first) {
+            nearest.emplace(dist, labels_[i]);
+            if (nearest.size() > k) nearest.pop();
+        }
+    }
+    std::vector<hnswlib::labeltype> labels(nearest.size());
+    for (size_t i = labels.size(); i > 0; i--, nearest.pop()) labels[i - 1] = nearest.top().second;
+    return labels;
+}
+
+} // namespace filtering
\ No newline at end of file
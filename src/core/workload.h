@@ -0,0 +1,110 @@
+#pragma once
+#include "filter_interface.h"
+#include <cstdint>
+#include <vector>
+
+namespace filtering {
+
+// Where a query vector lies relative to the points its filter matches
+enum class QueryLocality {
+    Correlated,     // In the cluster of a matching point
+    Uncorrelated,   // In a random cluster, regardless of the filter
+    AntiCorrelated  // In the cluster with the fewest matches, so the matches are far away
+};
+
+// One kind of query in a mix
+struct QueryClass {
+    // Relative frequency of the class in the mix
+    double weight = 1.0;
+    // Range for the fraction of points matching the query's first attribute
+    double min_selectivity = 0.0;
+    double max_selectivity = 1.0;
+    // Attributes a match must have (0: unfiltered). Those after the first are
+    // taken from one matching point, so the conjunction never comes out empty.
+    size_t num_attributes = 1;
+    QueryLocality locality = QueryLocality::Uncorrelated;
+};
+
+struct WorkloadOptions {
+    size_t dim = 32;
+    size_t num_points = 10000;
+    size_t num_clusters = 50;
+    // Cluster centers are uniform in [-center_range, center_range] per
+    // component; points are normally distributed around them
+    float center_range = 10.0f;
+    float cluster_stddev = 1.0f;
+    size_t num_attributes = 1000;
+    // Distinct attributes per point, capped at num_attributes
+    size_t attributes_per_point = 5;
+    // Attribute a is drawn with probability proportional to 1 / (a + 1)^s;
+    // 0 makes attribute popularity uniform
+    double zipf_exponent = 1.0;
+    // Attribute a has home cluster a % num_clusters. Each attribute of a
+    // point comes, with this probability, from those homed at the point's
+    // cluster (by the same Zipf law) and otherwise from all attributes; 0
+    // spreads attributes independently of the vectors.
+    double cluster_correlation = 0.5;
+    uint32_t seed = 42;
+};
+
+struct WorkloadQuery {
+    std::vector<float> vector;
+    std::vector<unsigned int> attributes;
+    // Fraction of points having every attribute of the query
+    double selectivity;
+    QueryLocality locality;
+};
+
+// Synthetic filtered-search workload: clustered vectors with Zipfian
+// attribute popularity and attributes correlated to cluster membership, plus
+// query mixes of controlled selectivity and locality. Uniform vectors with
+// independent attributes hide the hard case where a filter's matches sit far
+// from the query; this generator produces it on purpose. Deterministic for a
+// given seed. Point i has label i.
+class Workload {
+public:
+    explicit Workload(const WorkloadOptions& options = WorkloadOptions());
+
+    const WorkloadOptions& options() const { return options_; }
+    size_t size() const { return options_.num_points; }
+    size_t dim() const { return options_.dim; }
+
+    const float* vector(size_t i) const { return vectors_.data() + i * options_.dim; }
+    // All vectors back to back
+    const std::vector<float>& vectors() const { return vectors_; }
+    const std::vector<hnswlib::labeltype>& labels() const { return labels_; }
+    size_t clusterOf(size_t i) const { return cluster_of_[i]; }
+
+    // Attributes of point i, sorted
+    std::vector<unsigned int> attributes(size_t i) const;
+    bool hasAttributes(size_t i, const std::vector<unsigned int>& attributes) const;
+    // Points [begin, end) for BaseFilter::addPoints or ParallelIndexBuilder::add;
+    // refers to the workload's storage
+    AttributeBatch attributeBatch(size_t begin = 0, size_t end = size_t(-1)) const;
+    // Fraction of points that have the attribute
+    double selectivity(unsigned int attribute) const;
+
+    // Draws count queries, each from a class of the mix picked with
+    // probability proportional to its weight. Throws std::invalid_argument
+    // if the mix is empty or a class has no attribute in its selectivity range.
+    std::vector<WorkloadQuery> generateQueries(const std::vector<QueryClass>& mix, size_t count,
+                                               uint32_t seed = 7) const;
+
+    // Exact k nearest points by L2 among those with all the attributes,
+    // nearest first
+    std::vector<hnswlib::labeltype> exactKnn(const float* query, const std::vector<unsigned int>& attributes,
+                                             size_t k) const;
+
+private:
+    WorkloadOptions options_;
+    std::vector<float> centers_;
+    std::vector<float> vectors_;
+    std::vector<size_t> cluster_of_;
+    std::vector<hnswlib::labeltype> labels_;
+    // CSR point x attribute matrix
+    std::vector<size_t> offsets_;
+    std::vector<unsigned int> attributes_;
+    std::vector<size_t> attribute_counts_;
+};
+
+} // namespace filtering
\ No newline at end of file
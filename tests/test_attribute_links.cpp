@@ -0,0 +1,135 @@
+#include <iostream>
+#include <cassert>
+#include "../src/core/attribute_links.h"
+#include "test_common.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 16;
+const size_t num_points = 5000;
+const size_t num_clusters = 50;
+const unsigned int common_attr = 1;     // Every other point
+const unsigned int rare_attr = 2;       // On 1% of the points, spread over all clusters
+const size_t k = 10;
+
+// Tight clusters, so that the regular graph links points of the same cluster
+filtering::WorkloadOptions clusteredOptions() {
+    filtering::WorkloadOptions options = pointOptions(dim, num_points, 3);
+    options.num_clusters = num_clusters;
+    options.center_range = 10.0f;
+    options.cluster_stddev = 0.3f;
+    return options;
+}
+
+struct Fixture : WorkloadIndex {
+    filtering::RoaringFilter filter;
+
+    Fixture() : WorkloadIndex(clusteredOptions(), num_clusters, 8, 100) {
+        for (size_t i = 0; i < num_points; i++) {
+            if (i % 2 == 0) filter.addAttribute(i, common_attr);
+            if (i % 100 == 7) filter.addAttribute(i, rare_attr);
+        }
+        filter.alignWith(index);
+        index.setEf(k);
+    }
+
+    // Average fraction of the exact filtered k-NN found, over queries near the clusters
+    double recall(unsigned int attr, hnswlib::FilterTraversal traversal = hnswlib::FilterTraversal::ScoreAll) {
+        filtering::RoaringQuery attr_query = filter.makeQuery({attr});
+        filtering::InternalIdFilter<filtering::RoaringQuery> internal_filter(attr_query, index);
+        size_t found = 0, expected = 0;
+        for (size_t q = 0; q < num_clusters; q++) {
+            std::vector<std::pair<float, hnswlib::labeltype>> exact;
+            for (size_t i = 0; i < num_points; i++) {
+                if (!filter.hasAttribute(i, attr)) continue;
+                exact.emplace_back(hnswlib::L2Sqr(query(q), point(i), space.get_dist_func_param()), i);
+            }
+            std::sort(exact.begin(), exact.end());
+            auto result = index.searchKnnWithFilter(query(q), k, &internal_filter, traversal);
+            for (; !result.empty(); result.pop()) {
+                EXPECT_TRUE(filter.hasAttribute(result.top().second, attr));
+                for (size_t j = 0; j < k; j++) {
+                    if (exact[j].second == result.top().second) found++;
+                }
+            }
+            expected += k;
+        }
+        return double(found) / expected;
+    }
+};
+
+TEST(testLinksRaiseRecall) {
+    Fixture f;
+    double recall_before = f.recall(rare_attr);
+
+    auto report = filtering::addAttributeLinks(f.index, f.filter);
+    double recall_after = f.recall(rare_attr);
+
+    // The common attribute is too frequent to be linked
+    EXPECT_EQ(report.linked_attributes.size(), size_t(1));
+    EXPECT_EQ(report.linked_attributes[0], rare_attr);
+    EXPECT_TRUE(report.links_added > 0);
+    EXPECT_EQ(f.index.getNumExtraLinks(), report.links_added);
+    EXPECT_TRUE(recall_after > recall_before);
+    EXPECT_TRUE(recall_after > 0.9);
+
+    // The links keep the matches connected on their own
+    EXPECT_TRUE(f.recall(rare_attr, hnswlib::FilterTraversal::AllowedSubgraph) > 0.9);
+
+    std::cout << "Recall on a 1% attribute: " << recall_before << " -> " << recall_after << "\n";
+    std::cout << "Links raise recall test passed\n";
+}
+
+TEST(testLinksBoundedPerAttribute) {
+    Fixture f;
+    filtering::AttributeLinkOptions options;
+    options.max_links_per_attribute = 100;   // 2 per point of the rare attribute
+    options.max_selectivity = 1.0;           // The common attribute would need 2500 links
+    auto report = filtering::addAttributeLinks(f.index, f.filter, options);
+
+    EXPECT_EQ(report.linked_attributes.size(), size_t(1));
+    EXPECT_TRUE(report.links_added <= options.max_links_per_attribute);
+
+    options.max_links_per_attribute = 10000;
+    options.exact_scan_limit = 10;           // Neighbours from filtered searches instead
+    report = filtering::addAttributeLinks(f.index, f.filter, options);
+    EXPECT_EQ(report.linked_attributes.size(), size_t(2));
+    EXPECT_TRUE(report.links_added <= 2 * options.max_links_per_attribute);
+    EXPECT_EQ(f.index.getNumExtraLinks(), report.links_added);
+
+    std::cout << "Bounded links test passed\n";
+}
+
+TEST(testUnfilteredSearchIgnoresLinks) {
+    Fixture f;
+    std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>> before;
+    for (size_t q = 0; q < 20; q++) before.push_back(f.index.searchKnn(f.point(q), k));
+
+    filtering::addAttributeLinks(f.index, f.filter);
+    for (size_t q = 0; q < 20; q++) {
+        auto after = f.index.searchKnn(f.point(q), k);
+        EXPECT_EQ(after.size(), before[q].size());
+        for (; !after.empty(); after.pop(), before[q].pop()) {
+            EXPECT_EQ(after.top().second, before[q].top().second);
+        }
+    }
+
+    f.index.clearExtraLinks();
+    EXPECT_EQ(f.index.getNumExtraLinks(), size_t(0));
+
+    std::cout << "Unfiltered search test passed\n";
+}
+
+int main() {
+    std::cout << "Running attribute link tests...\n\n";
+
+    testLinksRaiseRecall();
+    testLinksBoundedPerAttribute();
+    testUnfilteredSearchIgnoresLinks();
+
+    std::cout << "\nAll attribute link tests passed!\n";
+    return 0;
+}
\ No newline at end of file
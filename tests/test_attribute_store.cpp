@@ -0,0 +1,227 @@
+#include <iostream>
+#include <cassert>
+#include <stdexcept>
+#include "../src/core/attribute_store.h"
+#include "../src/core/bitset_filter.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+TEST(testSlotAssignment) {
+    filtering::SlotIndex slots;
+
+    EXPECT_EQ(slots.assign(7), 0u);
+    EXPECT_EQ(slots.assign(3), 1u);
+    EXPECT_EQ(slots.assign(7), 0u);       // Existing label keeps its slot
+    EXPECT_EQ(slots.find(3), 1u);
+    EXPECT_EQ(slots.find(4), filtering::SlotIndex::NO_SLOT);
+    EXPECT_EQ(slots.labelAt(1), 3u);
+    EXPECT_EQ(slots.numLabels(), 2u);
+
+    // Gap slots hold no label and are not counted
+    const hnswlib::labeltype gap = filtering::SlotIndex::NO_LABEL;
+    slots.rebind({3, gap, 7, gap});
+    EXPECT_EQ(slots.size(), 4u);
+    EXPECT_EQ(slots.numLabels(), 2u);
+    EXPECT_EQ(slots.find(7), 2u);
+    EXPECT_EQ(slots.assign(9), 4u);
+    EXPECT_EQ(slots.numLabels(), 3u);
+
+    std::cout << "Slot assignment test passed\n";
+}
+
+TEST(testSparseLabels) {
+    filtering::SlotIndex slots;
+
+    hnswlib::labeltype huge = 1ull << 40;
+    EXPECT_EQ(slots.assign(huge), 0u);
+    EXPECT_EQ(slots.assign(1), 1u);
+    EXPECT_EQ(slots.find(huge), 0u);
+    EXPECT_EQ(slots.find(huge + 1), filtering::SlotIndex::NO_SLOT);
+    EXPECT_EQ(slots.find(1), 1u);
+
+    std::cout << "Sparse labels test passed\n";
+}
+
+TEST(testAlignWithIndex) {
+    const size_t dim = 4;
+    const size_t num_points = 32;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+
+    filtering::AttributeStore<int> store;
+    // Attributes arrive in reverse order of insertion into the graph
+    for (size_t i = 0; i < num_points; i++) {
+        hnswlib::labeltype label = 100 + (num_points - 1 - i);
+        store.getOrCreate(label) = static_cast<int>(label);
+    }
+    store.getOrCreate(5000) = 5000;  // Not in the index
+
+    std::vector<float> vec(dim);
+    for (size_t i = 0; i < num_points; i++) {
+        for (size_t j = 0; j < dim; j++) vec[j] = static_cast<float>(i * dim + j);
+        index.addPoint(vec.data(), 100 + i);
+    }
+
+    store.alignWith(index);
+    for (auto& entry : index.label_lookup_) {
+        EXPECT_EQ(store.slots().find(entry.first), entry.second);
+        EXPECT_EQ(store.row(entry.second), static_cast<int>(entry.first));
+    }
+    EXPECT_EQ(store.slots().find(5000), num_points);
+    EXPECT_EQ(*store.find(5000), 5000);
+
+    std::cout << "Align with index test passed\n";
+}
+
+TEST(testFilterAfterAlign) {
+    const size_t dim = 4;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, 8);
+
+    filtering::BitsetFilter filter;
+    filter.addAttribute(3, 100);
+    filter.addAttribute(1, 200);
+
+    std::vector<float> vec(dim, 0.0f);
+    for (hnswlib::labeltype label = 0; label < 4; label++) {
+        vec[0] = static_cast<float>(label);
+        index.addPoint(vec.data(), label);
+    }
+    filter.alignWith(index);
+
+    filter.setQueryAttributes({100});
+    EXPECT_TRUE(filter(3));
+    EXPECT_FALSE(filter(1));
+    EXPECT_EQ(filter.getNumAttributes(1), 1u);
+    EXPECT_EQ(filter.store().slots().find(3), 3u);
+
+    std::cout << "Filter after align test passed\n";
+}
+
+TEST(testAlignmentCheck) {
+    const size_t dim = 4;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, 8);
+
+    filtering::BitsetFilter filter;
+    std::vector<float> vec(dim, 0.0f);
+    for (hnswlib::labeltype label = 0; label < 4; label++) {
+        filter.addAttribute(3 - label, 100);
+        vec[0] = static_cast<float>(label);
+        index.addPoint(vec.data(), label);
+    }
+
+    auto throwsUnaligned = [&]() {
+        try {
+            filtering::InternalIdFilter<filtering::BitsetFilter> internal_filter(filter, index);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    EXPECT_FALSE(filter.slots().isAlignedWith(index));
+    EXPECT_TRUE(throwsUnaligned());
+
+    filter.alignWith(index);
+    EXPECT_TRUE(filter.slots().isAlignedWith(index));
+    EXPECT_FALSE(throwsUnaligned());
+
+    // A point added after alignWith gets an internal id the filter has no slot for
+    vec[0] = 4.0f;
+    index.addPoint(vec.data(), 4);
+    EXPECT_FALSE(filter.slots().isAlignedWith(index));
+    EXPECT_TRUE(throwsUnaligned());
+
+    filter.alignWith(index);
+    EXPECT_TRUE(filter.slots().isAlignedWith(index));
+
+    std::cout << "Alignment check test passed\n";
+}
+
+TEST(testAlignmentCheckAfterReorder) {
+    const size_t dim = 4;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, 8);
+
+    // The filter holds labels 0, 1, 2 in that order; the index gets 1, 0, 2
+    filtering::BitsetFilter filter;
+    for (hnswlib::labeltype label = 0; label < 3; label++) {
+        filter.addAttribute(label, 100 + label);
+    }
+    EXPECT_FALSE(filter.slots().isAlignedWith(index));
+
+    std::vector<float> vec(dim, 0.0f);
+    for (hnswlib::labeltype label : {1, 0, 2}) {
+        vec[0] = static_cast<float>(label);
+        index.addPoint(vec.data(), label);
+    }
+    EXPECT_FALSE(filter.slots().isAlignedWith(index));
+
+    filter.alignWith(index);
+    EXPECT_TRUE(filter.slots().isAlignedWith(index));
+    EXPECT_EQ(filter.store().slots().find(1), 0u);
+
+    // Growth after alignWith passes only while each new slot matches its internal id
+    filter.addAttribute(3, 103);
+    vec[0] = 3.0f;
+    index.addPoint(vec.data(), 3);
+    EXPECT_TRUE(filter.slots().isAlignedWith(index));
+
+    filter.addAttribute(5, 105);
+    filter.addAttribute(4, 104);
+    for (hnswlib::labeltype label : {4, 5}) {
+        vec[0] = static_cast<float>(label);
+        index.addPoint(vec.data(), label);
+    }
+    EXPECT_FALSE(filter.slots().isAlignedWith(index));
+
+    std::cout << "Alignment check after reorder test passed\n";
+}
+
+TEST(testAlignmentCheckAfterReplace) {
+    const size_t dim = 4;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, 8, 16, 200, 100, true);
+
+    filtering::BitsetFilter filter;
+    std::vector<float> vec(dim, 0.0f);
+    for (hnswlib::labeltype label = 0; label < 4; label++) {
+        filter.addAttribute(label, 100);
+        vec[0] = static_cast<float>(label);
+        index.addPoint(vec.data(), label);
+    }
+    filter.alignWith(index);
+    EXPECT_TRUE(filter.slots().isAlignedWith(index));
+
+    // Label 5 takes over the internal id of deleted label 1; the last id still agrees
+    index.markDelete(1);
+    filter.addAttribute(5, 200);
+    vec[0] = 5.0f;
+    index.addPoint(vec.data(), 5, true);
+    EXPECT_EQ(index.label_lookup_.at(5), 1u);
+    EXPECT_FALSE(filter.slots().isAlignedWith(index));
+
+    filter.alignWith(index);
+    EXPECT_TRUE(filter.slots().isAlignedWith(index));
+    EXPECT_EQ(filter.store().slots().find(5), 1u);
+
+    std::cout << "Alignment check after replace test passed\n";
+}
+
+int main() {
+    std::cout << "Running attribute store tests...\n\n";
+
+    testSlotAssignment();
+    testSparseLabels();
+    testAlignWithIndex();
+    testFilterAfterAlign();
+    testAlignmentCheck();
+    testAlignmentCheckAfterReorder();
+    testAlignmentCheckAfterReplace();
+
+    std::cout << "\nAll attribute store tests passed!\n";
+    return 0;
+}
\ No newline at end of file
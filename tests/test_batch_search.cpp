@@ -0,0 +1,172 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include "test_common.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 16;
+const size_t num_points = 5000;
+const size_t num_queries = 100;
+const size_t k = 10;
+
+struct Fixture : WorkloadIndex {
+    Fixture() : WorkloadIndex(pointOptions(dim, num_points, 11), num_queries, 16, 100) { index.setEf(50); }
+};
+
+TEST(testUpperLayersBatch) {
+    Fixture f;
+    std::vector<hnswlib::tableint> entry_points;
+    f.index.searchUpperLayersBatch(f.query_ptrs.data(), num_queries, entry_points);
+    EXPECT_EQ(entry_points.size(), num_queries);
+    for (size_t q = 0; q < num_queries; q++) {
+        EXPECT_EQ(entry_points[q], f.index.searchUpperLayers(f.query_ptrs[q]));
+    }
+
+    std::cout << "Upper layers batch test passed\n";
+}
+
+TEST(testBatchMatchesSingle) {
+    Fixture f;
+    for (size_t threads : {1, 3}) {
+        auto results = f.index.searchKnnBatch(f.query_ptrs, k, {}, threads);
+        EXPECT_EQ(results.size(), num_queries);
+        for (size_t q = 0; q < num_queries; q++) {
+            EXPECT_TRUE(sameResult(results[q], f.index.searchKnn(f.query_ptrs[q], k)));
+        }
+    }
+
+    // Deleted points are skipped as in single searches
+    for (hnswlib::labeltype label = 0; label < num_points; label += 7) f.index.markDelete(label);
+    auto results = f.index.searchKnnBatch(f.query_ptrs, k, {}, 2);
+    for (size_t q = 0; q < num_queries; q++) {
+        EXPECT_TRUE(sameResult(results[q], f.index.searchKnn(f.query_ptrs[q], k)));
+        for (; !results[q].empty(); results[q].pop()) EXPECT_TRUE(results[q].top().second % 7 != 0);
+    }
+
+    std::cout << "Batch matches single test passed\n";
+}
+
+TEST(testPerQueryFilters) {
+    Fixture f;
+    ModuloFilter even(2, 0), rare(50, 3);
+    std::vector<hnswlib::BaseFilterFunctor*> filters;
+    for (size_t q = 0; q < num_queries; q++) {
+        filters.push_back(q % 3 == 0 ? nullptr : q % 3 == 1 ? &even : &rare);
+    }
+
+    auto results = f.index.searchKnnBatch(f.query_ptrs, k, filters, 2);
+    for (size_t q = 0; q < num_queries; q++) {
+        EXPECT_TRUE(sameResult(results[q], f.index.searchKnn(f.query_ptrs[q], k, filters[q])));
+        EXPECT_EQ(results[q].size(), k);
+        for (; !results[q].empty(); results[q].pop()) {
+            if (filters[q]) EXPECT_TRUE((*filters[q])(results[q].top().second));
+        }
+    }
+
+    auto two_hop = f.index.searchKnnBatch(f.query_ptrs, k, filters, 1, hnswlib::FilterTraversal::TwoHop);
+    for (size_t q = 0; q < num_queries; q++) {
+        EXPECT_TRUE(sameResult(two_hop[q], f.index.searchKnnWithFilter(f.query_ptrs[q], k, filters[q],
+                                                                       hnswlib::FilterTraversal::TwoHop)));
+    }
+
+    bool thrown = false;
+    filters.pop_back();
+    try {
+        f.index.searchKnnBatch(f.query_ptrs, k, filters);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    std::cout << "Per-query filter test passed\n";
+}
+
+TEST(testRepeatedBatches) {
+    Fixture f;
+    std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>> expected;
+    for (const void* query : f.query_ptrs) expected.push_back(f.index.searchKnn(query, k));
+
+    // Batches of any thread count run on the shared pool, one after another
+    for (size_t threads : {2, 2, 4, 1}) {
+        auto results = f.index.searchKnnBatch(f.query_ptrs, k, {}, threads);
+        for (size_t q = 0; q < num_queries; q++) EXPECT_TRUE(sameResult(results[q], expected[q]));
+    }
+
+    // Batches from several callers share the pool at the same time
+    std::vector<std::thread> callers;
+    for (size_t c = 0; c < 3; c++) {
+        callers.emplace_back([&]() {
+            for (size_t round = 0; round < 5; round++) {
+                auto results = f.index.searchKnnBatch(f.query_ptrs, k, {}, 2);
+                for (size_t q = 0; q < num_queries; q++) EXPECT_TRUE(sameResult(results[q], expected[q]));
+            }
+        });
+    }
+    for (auto& caller : callers) caller.join();
+
+    std::cout << "Repeated batches test passed\n";
+}
+
+TEST(testThreadPool) {
+    hnswlib::BatchThreadPool pool(3);
+    EXPECT_EQ(pool.size(), size_t(3));
+
+    // Every worker that runs gets its own index; worker 0 always runs on the caller
+    std::vector<std::thread> callers;
+    for (size_t c = 0; c < 4; c++) {
+        callers.emplace_back([&]() {
+            for (size_t round = 0; round < 50; round++) {
+                std::vector<std::atomic<int>> calls(6);
+                std::thread::id caller = std::this_thread::get_id();
+                bool on_caller = false;
+                pool.run(6, [&](size_t worker) {
+                    calls[worker]++;
+                    if (worker == 0) on_caller = std::this_thread::get_id() == caller;
+                });
+                EXPECT_TRUE(on_caller);
+                EXPECT_EQ(calls[0].load(), 1);
+                for (size_t w = 1; w < 6; w++) EXPECT_TRUE(calls[w].load() <= (w <= 3 ? 1 : 0));
+            }
+        });
+    }
+    for (auto& caller : callers) caller.join();
+
+    std::cout << "Thread pool test passed\n";
+}
+
+TEST(testEdgeCases) {
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> empty(&space, 10);
+    std::vector<float> query(dim, 0.0f);
+    auto results = empty.searchKnnBatch({query.data(), query.data()}, k);
+    EXPECT_EQ(results.size(), size_t(2));
+    EXPECT_TRUE(results[0].empty());
+
+    // Scratch visited lists follow the index size after a resize
+    Fixture f;
+    f.index.resizeIndex(num_points * 2);
+    std::vector<float> point(dim, 0.5f);
+    f.index.addPoint(point.data(), num_points + 1);
+    auto found = f.index.searchKnnBatch({point.data()}, 1);
+    EXPECT_EQ(found[0].top().second, num_points + 1);
+
+    std::cout << "Edge case test passed\n";
+}
+
+int main() {
+    std::cout << "Running batch search tests...\n\n";
+
+    testUpperLayersBatch();
+    testBatchMatchesSingle();
+    testPerQueryFilters();
+    testRepeatedBatches();
+    testThreadPool();
+    testEdgeCases();
+
+    std::cout << "\nAll batch search tests passed!\n";
+    return 0;
+}
\ No newline at end of file
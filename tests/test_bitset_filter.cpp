@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cassert>
+#include <random>
 #include "../src/core/bitset_filter.h"
 
 #define TEST(name) void name()
@@ -35,6 +36,11 @@ TEST(testMultipleAttributesMatch) {
     EXPECT_TRUE(filter(1));   // Has both attributes
     EXPECT_FALSE(filter(2));  // Only has attribute 100
     EXPECT_FALSE(filter(3));  // Has neither attribute
+
+    EXPECT_TRUE(filter.hasAttributes(1, {200, 100, 200}));
+    EXPECT_FALSE(filter.hasAttributes(2, {100, 200}));
+    EXPECT_TRUE(filter.hasAttributes(3, {}));
+    EXPECT_FALSE(filter.hasAttributes(4, {}));  // Unknown point
     
     std::cout << "Multiple attributes match test passed\n";
 }
@@ -81,6 +87,141 @@ TEST(testInvalidAttribute) {
     std::cout << "Invalid attribute test passed\n";
 }
 
+TEST(testRuntimeWidth) {
+    const size_t max_attributes = 100000;
+    filtering::BitsetFilter filter({}, max_attributes);
+    EXPECT_EQ(filter.getMaxAttributes(), max_attributes);
+
+    filter.addAttribute(1, 5);
+    filter.addAttribute(1, 99999);
+    filter.addAttribute(2, 99999);
+
+    filter.setQueryAttributes({5, 99999});
+    EXPECT_TRUE(filter(1));
+    EXPECT_FALSE(filter(2));
+    EXPECT_TRUE(filter.hasAttribute(2, 99999));
+    EXPECT_EQ(filter.getNumAttributes(1), 2u);
+
+    bool caught_exception = false;
+    try {
+        filter.addAttribute(1, max_attributes);
+    } catch (const std::out_of_range&) {
+        caught_exception = true;
+    }
+    EXPECT_TRUE(caught_exception);
+
+    // Narrow filters pay for their width only
+    filtering::BitsetFilter narrow({}, 64);
+    narrow.addAttribute(1, 63);
+    EXPECT_EQ(narrow.store().wordsPerRow(), 1u);
+    EXPECT_EQ(filter.store().wordsPerRow() % 8, 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(filter.store().row(1)) % 64, 0u);
+
+    std::cout << "Runtime width test passed\n";
+}
+
+TEST(testSubsetKernel) {
+    filtering::SubsetKernel is_subset = filtering::selectSubsetKernel();
+    std::mt19937_64 gen(3);
+
+    for (size_t num_words : {1, 3, 4, 8, 13, 16, 1563}) {
+        filtering::AlignedWords row(num_words), query(num_words);
+        for (int trial = 0; trial < 50; trial++) {
+            for (size_t i = 0; i < num_words; i++) {
+                row.data()[i] = gen();
+                query.data()[i] = row.data()[i] & gen() & gen();
+            }
+            // Flip one query bit on outside the row in half of the trials
+            if (trial % 2) {
+                size_t word = gen() % num_words;
+                uint64_t outside = ~row.data()[word];
+                if (outside) query.data()[word] |= outside & (~outside + 1);
+            }
+            EXPECT_EQ(is_subset(row.data(), query.data(), num_words),
+                      filtering::isSubsetScalar(row.data(), query.data(), num_words));
+        }
+    }
+
+    std::cout << "Subset kernel test passed\n";
+}
+
+TEST(testCompiledQuery) {
+    filtering::SubsetKernel is_subset = filtering::selectSubsetKernel();
+    const size_t words_per_row = 16;
+    filtering::AlignedWords row(words_per_row);
+    for (unsigned int attr = 0; attr < 1024; attr += 3) {
+        row.data()[attr >> 6] |= uint64_t(1) << (attr & 63);
+    }
+
+    // Two words touched: compiled to (word, mask) pairs
+    filtering::CompiledBitsetQuery few({3, 6, 900}, words_per_row, is_subset);
+    EXPECT_TRUE(few.isSparse());
+    EXPECT_EQ(few.numWords(), 2u);
+    EXPECT_TRUE(few.matches(row.data()));
+    EXPECT_FALSE(filtering::CompiledBitsetQuery({3, 901}, words_per_row, is_subset).matches(row.data()));
+
+    // Every word touched: falls back to the full-row kernel
+    std::vector<unsigned int> many;
+    for (unsigned int attr = 0; attr < 1024; attr += 66) many.push_back(attr);
+    filtering::CompiledBitsetQuery dense(many, words_per_row, is_subset);
+    EXPECT_FALSE(dense.isSparse());
+    EXPECT_TRUE(dense.matches(row.data()));
+    many.push_back(1);
+    EXPECT_FALSE(filtering::CompiledBitsetQuery(many, words_per_row, is_subset).matches(row.data()));
+
+    // The empty query matches everything
+    EXPECT_TRUE(filtering::CompiledBitsetQuery({}, words_per_row, is_subset).matches(row.data()));
+
+    std::cout << "Compiled query test passed\n";
+}
+
+TEST(testBulkAddPoints) {
+    // Labels 10..509; point 10 + i has attributes i % 7, i % 300 and 700 (listed twice)
+    std::vector<hnswlib::labeltype> labels;
+    std::vector<size_t> offsets = {0};
+    std::vector<unsigned int> attributes;
+    for (size_t i = 0; i < 500; i++) {
+        labels.push_back(10 + i);
+        for (unsigned int attr : {unsigned(i % 7), unsigned(i % 300), 700u, 700u}) attributes.push_back(attr);
+        offsets.push_back(attributes.size());
+    }
+    filtering::AttributeBatch batch{labels.data(), labels.size(), offsets.data(), attributes.data()};
+
+    filtering::BitsetFilter expected;
+    expected.addAttribute(10, 900);
+    for (size_t i = 0; i < labels.size(); i++) {
+        for (size_t j = offsets[i]; j < offsets[i + 1]; j++) expected.addAttribute(labels[i], attributes[j]);
+    }
+
+    for (size_t num_threads : {1, 4}) {
+        filtering::BitsetFilter filter;
+        filter.addAttribute(10, 900);  // Existing points keep their attributes
+        filter.addPoints(batch, num_threads);
+        for (hnswlib::labeltype label = 0; label < 520; label++) {
+            for (unsigned int attr : {0u, 3u, 6u, 299u, 700u, 900u}) {
+                EXPECT_EQ(filter.hasAttribute(label, attr), expected.hasAttribute(label, attr));
+            }
+        }
+        for (unsigned int attr = 0; attr < filtering::MAX_ATTRIBUTES; attr++) {
+            EXPECT_EQ(filter.getAttributeCardinality(attr), expected.getAttributeCardinality(attr));
+        }
+    }
+
+    // Invalid attributes are rejected before anything is added
+    attributes[5] = filtering::MAX_ATTRIBUTES;
+    filtering::BitsetFilter filter;
+    bool caught = false;
+    try {
+        filter.addPoints(batch);
+    } catch (const std::out_of_range&) {
+        caught = true;
+    }
+    EXPECT_TRUE(caught);
+    EXPECT_EQ(filter.getAttributeCardinality(700), 0u);
+
+    std::cout << "Bulk add points test passed\n";
+}
+
 int main() {
     std::cout << "Running bitset filter tests...\n\n";
     
@@ -89,6 +230,10 @@ int main() {
     testAttributeRemoval();
     testAttributeCount();
     testInvalidAttribute();
+    testRuntimeWidth();
+    testSubsetKernel();
+    testCompiledQuery();
+    testBulkAddPoints();
     
     std::cout << "\nAll bitset filter tests passed!\n";
     return 0;
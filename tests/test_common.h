@@ -0,0 +1,66 @@
+#pragma once
+#include <algorithm>
+#include <queue>
+#include "../src/core/workload.h"
+
+// Fixtures and helpers shared by the search tests
+
+// Clustered points without attributes; tests attach their own by label
+inline filtering::WorkloadOptions pointOptions(size_t dim, size_t num_points, uint32_t seed) {
+    filtering::WorkloadOptions options;
+    options.dim = dim;
+    options.num_points = num_points;
+    options.num_clusters = 20;
+    options.center_range = 1.0f;
+    options.cluster_stddev = 0.5f;
+    options.num_attributes = 0;
+    options.seed = seed;
+    return options;
+}
+
+// An L2 index over the points of a filtering::Workload, point i under label
+// i, plus unfiltered queries near its clusters. max_elements leaves room for
+// points the test adds later.
+struct WorkloadIndex {
+    filtering::Workload workload;
+    hnswlib::L2Space space;
+    hnswlib::HierarchicalNSW<float> index;
+    std::vector<filtering::WorkloadQuery> queries;
+    std::vector<const void*> query_ptrs;
+
+    WorkloadIndex(const filtering::WorkloadOptions& options, size_t num_queries, size_t M = 16,
+                  size_t ef_construction = 200, size_t max_elements = 0)
+        : workload(options),
+          space(options.dim),
+          index(&space, std::max(max_elements, options.num_points), M, ef_construction) {
+        for (size_t i = 0; i < workload.size(); i++) index.addPoint(workload.vector(i), i);
+        filtering::QueryClass unfiltered;
+        unfiltered.num_attributes = 0;
+        if (num_queries > 0) queries = workload.generateQueries({unfiltered}, num_queries, options.seed + 1);
+        for (const auto& query : queries) query_ptrs.push_back(query.vector.data());
+    }
+
+    const float* point(size_t i) const { return workload.vector(i); }
+    const float* query(size_t q) const { return queries[q].vector.data(); }
+};
+
+// Accepts the labels congruent to remainder modulo modulus
+class ModuloFilter : public hnswlib::BaseFilterFunctor {
+public:
+    explicit ModuloFilter(size_t modulus, size_t remainder = 0) : modulus_(modulus), remainder_(remainder) {}
+    bool operator()(hnswlib::labeltype label) override { return label % modulus_ == remainder_; }
+
+private:
+    size_t modulus_;
+    size_t remainder_;
+};
+
+// Same labels at the same distances, in the same order
+inline bool sameResult(std::priority_queue<std::pair<float, hnswlib::labeltype>> a,
+                       std::priority_queue<std::pair<float, hnswlib::labeltype>> b) {
+    if (a.size() != b.size()) return false;
+    for (; !a.empty(); a.pop(), b.pop()) {
+        if (a.top() != b.top()) return false;
+    }
+    return true;
+}
\ No newline at end of file
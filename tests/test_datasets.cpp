@@ -0,0 +1,232 @@
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include "../src/core/datasets.h"
+#include "../src/core/index_builder.h"
+#include "../src/core/roaring_filter.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 8;
+const size_t num_points = 1000;
+
+std::vector<float> randomVectors(size_t count) {
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> dis(0, 255);
+    std::vector<float> vectors(count * dim);
+    // Small integers, so every format holds them exactly
+    for (float& x : vectors) x = dis(gen);
+    return vectors;
+}
+
+template <typename T>
+void writeVecs(const std::string& path, const std::vector<float>& vectors) {
+    std::ofstream out(path, std::ios::binary);
+    int32_t d = dim;
+    for (size_t i = 0; i < vectors.size() / dim; i++) {
+        out.write((const char*) &d, sizeof(d));
+        for (size_t j = 0; j < dim; j++) {
+            T value = static_cast<T>(vectors[i * dim + j]);
+            out.write((const char*) &value, sizeof(value));
+        }
+    }
+}
+
+template <typename T>
+void writeBin(const std::string& path, const std::vector<float>& vectors) {
+    std::ofstream out(path, std::ios::binary);
+    uint32_t header[2] = {uint32_t(vectors.size() / dim), uint32_t(dim)};
+    out.write((const char*) header, sizeof(header));
+    for (float x : vectors) {
+        T value = static_cast<T>(x);
+        out.write((const char*) &value, sizeof(value));
+    }
+}
+
+// Point i has attributes i % 7 and 7 + i % 3, and point 5 none
+void writeSpmat(const std::string& path, size_t rows) {
+    std::vector<int64_t> offsets{0};
+    std::vector<int32_t> indices;
+    for (size_t i = 0; i < rows; i++) {
+        if (i != 5) {
+            indices.push_back(i % 7);
+            indices.push_back(7 + i % 3);
+        }
+        offsets.push_back(indices.size());
+    }
+    std::vector<float> values(indices.size(), 1.0f);
+    std::ofstream out(path, std::ios::binary);
+    int64_t header[3] = {int64_t(rows), 10, int64_t(indices.size())};
+    out.write((const char*) header, sizeof(header));
+    out.write((const char*) offsets.data(), offsets.size() * sizeof(int64_t));
+    out.write((const char*) indices.data(), indices.size() * sizeof(int32_t));
+    out.write((const char*) values.data(), values.size() * sizeof(float));
+}
+
+TEST(testVectorFormats) {
+    auto vectors = randomVectors(num_points);
+    writeVecs<float>("test_vectors.fvecs", vectors);
+    writeVecs<uint8_t>("test_vectors.bvecs", vectors);
+    writeVecs<int32_t>("test_vectors.ivecs", vectors);
+    writeBin<float>("test_vectors.fbin", vectors);
+    writeBin<uint8_t>("test_vectors.u8bin", vectors);
+    writeBin<int32_t>("test_vectors.ibin", vectors);
+
+    std::vector<float> rows(num_points * dim);
+    for (const char* path : {"test_vectors.fvecs", "test_vectors.bvecs", "test_vectors.ivecs",
+                             "test_vectors.fbin", "test_vectors.u8bin", "test_vectors.ibin"}) {
+        filtering::VectorFile file(path);
+        EXPECT_EQ(file.size(), num_points);
+        EXPECT_EQ(file.dim(), dim);
+        file.copyRows(0, num_points, rows.data());
+        EXPECT_TRUE(rows == vectors);
+        file.copyRows(3, 4, rows.data());
+        EXPECT_EQ(rows[0], vectors[3 * dim]);
+    }
+
+    // Float rows are usable in place
+    filtering::VectorFile fvecs("test_vectors.fvecs");
+    EXPECT_TRUE(fvecs.elementType() == filtering::ElementType::Float32);
+    EXPECT_EQ(fvecs.stride(), sizeof(int32_t) + dim * sizeof(float));
+    EXPECT_EQ(static_cast<const float*>(fvecs.row(9))[2], vectors[9 * dim + 2]);
+
+    std::cout << "Vector format test passed\n";
+}
+
+TEST(testMalformedFiles) {
+    {
+        std::ofstream out("test_vectors.fvecs", std::ios::binary | std::ios::app);
+        out.put(0);
+    }
+    bool thrown = false;
+    try {
+        filtering::VectorFile file("test_vectors.fvecs");
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    thrown = false;
+    try {
+        filtering::VectorFile file("test_vectors.txt");
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    // The header claims more vectors than the file holds
+    {
+        std::fstream out("test_vectors.fbin", std::ios::binary | std::ios::in | std::ios::out);
+        uint32_t count = num_points + 1;
+        out.write((const char*) &count, sizeof(count));
+    }
+    thrown = false;
+    try {
+        filtering::VectorFile file("test_vectors.fbin");
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    writeSpmat("test_attributes.spmat", num_points);
+    {
+        std::fstream out("test_attributes.spmat", std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(3 * sizeof(int64_t) + 2 * sizeof(int64_t));
+        int64_t offset = 1000000;
+        out.write((const char*) &offset, sizeof(offset));
+    }
+    thrown = false;
+    try {
+        filtering::AttributeMatrixFile file("test_attributes.spmat");
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    std::cout << "Malformed file test passed\n";
+}
+
+TEST(testAttributeMatrix) {
+    writeSpmat("test_attributes.spmat", num_points);
+    filtering::AttributeMatrixFile matrix("test_attributes.spmat");
+    EXPECT_EQ(matrix.numPoints(), num_points);
+    EXPECT_EQ(matrix.numAttributes(), size_t(10));
+    EXPECT_EQ(matrix.numEntries(), 2 * (num_points - 1));
+    EXPECT_TRUE(matrix.row(5).empty());
+    EXPECT_TRUE(matrix.row(11) == std::vector<unsigned int>({4, 9}));
+
+    // A range of rows, loaded under labels of its own
+    std::vector<hnswlib::labeltype> labels{100, 101, 102};
+    filtering::RoaringFilter filter;
+    filter.addPoints(matrix.batch(labels.data(), 10, 13));
+    EXPECT_TRUE(filter.hasAttribute(100, 3));
+    EXPECT_TRUE(filter.hasAttribute(100, 8));
+    EXPECT_TRUE(filter.hasAttribute(102, 5));
+    EXPECT_FALSE(filter.hasAttribute(102, 3));
+    EXPECT_EQ(matrix.batch(labels.data(), 990).num_points, size_t(10));
+
+    std::cout << "Attribute matrix test passed\n";
+}
+
+TEST(testBuildFromFiles) {
+    auto vectors = randomVectors(num_points);
+    writeVecs<float>("test_vectors.fvecs", vectors);
+    writeSpmat("test_attributes.spmat", num_points);
+    filtering::VectorFile file("test_vectors.fvecs");
+    filtering::AttributeMatrixFile matrix("test_attributes.spmat");
+
+    std::vector<hnswlib::labeltype> labels(num_points);
+    for (size_t i = 0; i < num_points; i++) labels[i] = i;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, 100);
+    filtering::RoaringFilter filter;
+    filtering::BuildOptions options;
+    options.num_threads = 2;
+    filtering::ParallelIndexBuilder<float> builder(index, &filter, options);
+
+    // Streamed in two batches straight from the mappings
+    const size_t half = num_points / 2;
+    auto first = matrix.batch(labels.data(), 0, half);
+    auto second = matrix.batch(labels.data() + half, half);
+    builder.add(file.row(0), labels.data(), half, &first, file.stride());
+    builder.add(file.row(half), labels.data() + half, num_points - half, &second, file.stride());
+    EXPECT_EQ(index.getCurrentElementCount(), num_points);
+
+    for (size_t i : {size_t(0), size_t(17), num_points - 1}) {
+        auto result = index.searchKnn(vectors.data() + i * dim, 1);
+        EXPECT_EQ(result.top().first, 0.0f);
+        EXPECT_TRUE(filter.hasAttribute(i, i % 7));
+    }
+
+    bool thrown = false;
+    try {
+        builder.add(file.row(0), labels.data(), 1, nullptr, dim);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    std::cout << "Build from files test passed\n";
+}
+
+int main() {
+    std::cout << "Running dataset loader tests...\n\n";
+
+    testVectorFormats();
+    testMalformedFiles();
+    testAttributeMatrix();
+    testBuildFromFiles();
+
+    for (const char* path : {"test_vectors.fvecs", "test_vectors.bvecs", "test_vectors.ivecs", "test_vectors.fbin",
+                             "test_vectors.u8bin", "test_vectors.ibin", "test_attributes.spmat"}) {
+        std::remove(path);
+    }
+
+    std::cout << "\nAll dataset loader tests passed!\n";
+    return 0;
+}
\ No newline at end of file
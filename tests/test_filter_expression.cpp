@@ -0,0 +1,223 @@
+#include <iostream>
+#include <cassert>
+#include <random>
+#include <set>
+#include "../src/core/bitset_filter.h"
+#include "../src/core/roaring_filter.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+using filtering::FilterExpression;
+using filtering::FilterPlan;
+using filtering::PlanNode;
+
+static FilterExpression attr(unsigned int id) {
+    return FilterExpression::attribute(id);
+}
+
+TEST(testPlanFlattening) {
+    // Nested conjunctions of attributes collapse into a single AllOf
+    FilterPlan all = FilterPlan::compile(attr(1) && (attr(2) && attr(3)));
+    EXPECT_EQ(all.nodes().size(), 1);
+    EXPECT_TRUE(all.root().op == PlanNode::Op::AllOf);
+    EXPECT_EQ(all.root().attributes, (std::vector<unsigned int>{1, 2, 3}));
+
+    // Double negation disappears
+    FilterPlan single = FilterPlan::compile(!!attr(5));
+    EXPECT_EQ(single.nodes().size(), 1);
+    EXPECT_TRUE(single.root().op == PlanNode::Op::AllOf);
+
+    // (1 || 2) && !3 && 4: And over AnyOf{1,2}, Not(AllOf{3}) and AllOf{4}
+    FilterPlan mixed = FilterPlan::compile((attr(1) || attr(2)) && !attr(3) && attr(4));
+    const auto& nodes = mixed.nodes();
+    EXPECT_TRUE(nodes[0].op == PlanNode::Op::And);
+    EXPECT_EQ(nodes[0].end, nodes.size());
+    size_t num_children = 0;
+    for (uint32_t child = 1; child < nodes[0].end; child = nodes[child].end) {
+        num_children++;
+        if (nodes[child].op == PlanNode::Op::AnyOf) {
+            EXPECT_EQ(nodes[child].attributes, (std::vector<unsigned int>{1, 2}));
+        } else if (nodes[child].op == PlanNode::Op::Not) {
+            EXPECT_EQ(nodes[child + 1].attributes, (std::vector<unsigned int>{3}));
+        } else {
+            EXPECT_TRUE(nodes[child].op == PlanNode::Op::AllOf);
+            EXPECT_EQ(nodes[child].attributes, (std::vector<unsigned int>{4}));
+        }
+    }
+    EXPECT_EQ(num_children, 3);
+
+    std::cout << "Plan flattening test passed\n";
+}
+
+TEST(testPlanOrdering) {
+    filtering::BitsetFilter filter;
+    // Attributes 0 and 2 on every point, 1 and 3 on every 50th
+    for (size_t i = 0; i < 1000; i++) {
+        filter.addAttribute(i, 0);
+        filter.addAttribute(i, 2);
+        if (i % 50 == 0) {
+            filter.addAttribute(i, 1);
+            filter.addAttribute(i, 3);
+        }
+    }
+    EXPECT_EQ(filter.getAttributeCardinality(1), 20);
+
+    // The rare clause decides an And more often, so it runs first
+    FilterPlan plan = filter.compilePlan((attr(0) || attr(2)) && (attr(1) || attr(3)));
+    const auto& nodes = plan.nodes();
+    EXPECT_TRUE(nodes[0].op == PlanNode::Op::And);
+    EXPECT_TRUE(nodes[1].attributes == (std::vector<unsigned int>{1, 3}) ||
+                nodes[1].attributes == (std::vector<unsigned int>{3, 1}));
+    EXPECT_TRUE(plan.estimatedSelectivity() < 0.05);
+
+    // Within an AllOf, the rarest attribute is tested first
+    FilterPlan all = filter.compilePlan(FilterExpression::allOf({0, 1}));
+    EXPECT_EQ(all.root().attributes[0], 1u);
+
+    std::cout << "Plan ordering test passed\n";
+}
+
+TEST(testFiltersMatchReference) {
+    const size_t num_points = 2000;
+    const unsigned int num_attributes = 200;
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<unsigned int> dis_attr(0, num_attributes - 1);
+
+    filtering::BitsetFilter bitset_filter({}, num_attributes);
+    filtering::RoaringFilter roaring_filter;
+    std::vector<std::set<unsigned int>> point_attributes(num_points);
+    for (size_t i = 0; i < num_points; i++) {
+        for (int j = 0; j < 20; j++) {
+            unsigned int a = dis_attr(gen);
+            point_attributes[i].insert(a);
+            bitset_filter.addAttribute(i, a);
+            roaring_filter.addAttribute(i, a);
+        }
+    }
+
+    // Attributes 0 and 130 share no word, so AnyOf spans several
+    std::vector<std::pair<FilterExpression, std::function<bool(const std::set<unsigned int>&)>>> cases = {
+        {(attr(0) || attr(130)) && !attr(7),
+         [](const std::set<unsigned int>& s) { return (s.count(0) || s.count(130)) && !s.count(7); }},
+        {!(attr(1) && attr(2)),
+         [](const std::set<unsigned int>& s) { return !(s.count(1) && s.count(2)); }},
+        {(attr(3) && attr(4)) || (attr(5) && !attr(6)) || attr(199),
+         [](const std::set<unsigned int>& s) { return (s.count(3) && s.count(4)) || (s.count(5) && !s.count(6)) || s.count(199); }},
+        {FilterExpression::anyOf({10, 20, 30}) && FilterExpression::anyOf({40, 150}),
+         [](const std::set<unsigned int>& s) { return (s.count(10) || s.count(20) || s.count(30)) && (s.count(40) || s.count(150)); }},
+        {!attr(8) && !attr(9),
+         [](const std::set<unsigned int>& s) { return !s.count(8) && !s.count(9); }},
+    };
+
+    for (const auto& test_case : cases) {
+        filtering::BitsetExpressionQuery bitset_query = bitset_filter.makeQuery(test_case.first);
+        filtering::RoaringQuery roaring_query = roaring_filter.makeQuery(test_case.first);
+        size_t expected_count = 0;
+        for (size_t i = 0; i < num_points; i++) {
+            bool expected = test_case.second(point_attributes[i]);
+            expected_count += expected;
+            EXPECT_EQ(bitset_query.matches(i), expected);
+            EXPECT_EQ(roaring_query.matches(i), expected);
+        }
+        EXPECT_EQ(roaring_filter.matchingSlots(test_case.first).cardinality(), expected_count);
+    }
+
+    std::cout << "Reference agreement test passed\n";
+}
+
+TEST(testNegationUniverse) {
+    const size_t dim = 4;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, 20);
+    filtering::RoaringFilter filter;
+    FilterExpression none_of_1 = !attr(1);
+
+    // Attribute 1 on even labels
+    for (hnswlib::labeltype label = 0; label < 10; label++) {
+        filter.addAttribute(label, label % 2 == 0 ? 1 : 2);
+    }
+    EXPECT_EQ(filter.matchingSlots(none_of_1).cardinality(), 5u);
+    EXPECT_EQ(filter.matchingSlots(std::vector<unsigned int>{}).cardinality(), 10u);
+
+    std::vector<hnswlib::labeltype> labels = {10, 11, 12};
+    std::vector<size_t> offsets = {0, 1, 2, 3};
+    std::vector<unsigned int> attributes = {1, 2, 2};
+    filter.addPoints({labels.data(), labels.size(), offsets.data(), attributes.data()});
+    EXPECT_EQ(filter.matchingSlots(none_of_1).cardinality(), 7u);
+
+    // Index points the filter has no attributes for still match a negation
+    std::vector<float> vec(dim, 0.0f);
+    for (hnswlib::labeltype label = 0; label < 15; label++) {
+        vec[0] = static_cast<float>(label);
+        index.addPoint(vec.data(), label);
+    }
+    filter.alignWith(index);
+    EXPECT_EQ(filter.matchingSlots(none_of_1).cardinality(), 9u);
+
+    filter.saveAttributes("test_negation_attributes.bin");
+    filtering::RoaringFilter loaded;
+    loaded.loadAttributes("test_negation_attributes.bin");
+    EXPECT_EQ(loaded.matchingSlots(none_of_1).cardinality(), 9u);
+    EXPECT_EQ(loaded.matchingSlots(std::vector<unsigned int>{}).cardinality(), 15u);
+    std::remove("test_negation_attributes.bin");
+
+    std::cout << "Negation universe test passed\n";
+}
+
+TEST(testExpressionSearch) {
+    const size_t dim = 8;
+    const size_t num_points = 2000;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    filtering::BitsetFilter bitset_filter;
+    filtering::RoaringFilter roaring_filter;
+
+    // Attribute i % 4 on every point, attribute 4 on every 10th
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    std::vector<float> point(dim);
+    for (size_t i = 0; i < num_points; i++) {
+        for (auto& x : point) x = dis(gen);
+        index.addPoint(point.data(), i);
+        for (auto* filter : std::initializer_list<filtering::BaseFilter*>{&bitset_filter, &roaring_filter}) {
+            filter->addAttribute(i, i % 4);
+            if (i % 10 == 0) filter->addAttribute(i, 4);
+        }
+    }
+    bitset_filter.alignWith(index);
+    roaring_filter.alignWith(index);
+
+    // Labels 1 or 3 mod 4, excluding multiples of 10: none of them is even
+    FilterExpression expr = (attr(1) || attr(3)) && !attr(4);
+    auto bitset_query = bitset_filter.makeQuery(expr);
+    auto roaring_query = roaring_filter.makeQuery(expr);
+    filtering::InternalIdFilter<filtering::BitsetExpressionQuery> bitset_internal(bitset_query, index);
+    filtering::InternalIdFilter<filtering::RoaringQuery> roaring_internal(roaring_query, index);
+
+    for (auto* internal_filter : std::initializer_list<hnswlib::BaseInternalFilterFunctor*>{&bitset_internal, &roaring_internal}) {
+        auto result = index.searchKnn(point.data(), 10, internal_filter);
+        EXPECT_EQ(result.size(), 10);
+        while (!result.empty()) {
+            EXPECT_TRUE(result.top().second % 2 == 1);
+            result.pop();
+        }
+    }
+
+    std::cout << "Expression search test passed\n";
+}
+
+int main() {
+    std::cout << "Running filter expression tests...\n\n";
+
+    testPlanFlattening();
+    testPlanOrdering();
+    testFiltersMatchReference();
+    testNegationUniverse();
+    testExpressionSearch();
+
+    std::cout << "\nAll filter expression tests passed!\n";
+    return 0;
+}
\ No newline at end of file
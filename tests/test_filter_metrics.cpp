@@ -0,0 +1,113 @@
+#include <iostream>
+#include <cassert>
+#include <memory>
+#include <thread>
+#include "../src/core/bitset_filter.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+TEST(testHistogramBuckets) {
+    filtering::LatencyHistogram histogram;
+    EXPECT_EQ(filtering::LatencyHistogram::bucketOf(0), 0u);
+    EXPECT_EQ(filtering::LatencyHistogram::bucketOf(1), 1u);
+    EXPECT_EQ(filtering::LatencyHistogram::bucketOf(100), 7u);   // [64, 128)
+
+    for (int i = 0; i < 99; i++) histogram.record(100);
+    histogram.record(5000);
+    EXPECT_EQ(histogram.count(), 100u);
+    EXPECT_EQ(histogram.percentileNs(50), 127u);
+    EXPECT_EQ(histogram.percentileNs(100), 8191u);
+    EXPECT_TRUE(histogram.meanNs() == 149.0);
+
+    std::cout << "Histogram buckets test passed\n";
+}
+
+TEST(testSampleRate) {
+    filtering::FilterMetrics metrics;
+    metrics.setSampleRate(4);
+    size_t sampled = 0;
+    for (int i = 0; i < 400; i++) {
+        if (metrics.shouldSample()) sampled++;
+    }
+    EXPECT_EQ(sampled, 100u);
+
+    metrics.setSampleRate(0);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_FALSE(metrics.shouldSample());
+    }
+
+    std::cout << "Sample rate test passed\n";
+}
+
+TEST(testPerThreadAggregation) {
+    filtering::FilterMetrics metrics;
+    const size_t num_threads = 4;
+    const size_t per_thread = 1000;
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([&metrics]() {
+            for (size_t i = 0; i < per_thread; i++) {
+                metrics.record(filtering::FilterOp::Query, 50);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    metrics.record(filtering::FilterOp::AddAttribute, 10);
+
+    EXPECT_EQ(metrics.histogram(filtering::FilterOp::Query).count(), num_threads * per_thread);
+    EXPECT_EQ(metrics.getSampledOperations(), num_threads * per_thread + 1);
+
+    metrics.reset();
+    EXPECT_EQ(metrics.getSampledOperations(), 0u);
+
+    std::cout << "Per-thread aggregation test passed\n";
+}
+
+TEST(testSlotsReleased) {
+    size_t before = filtering::FilterMetrics::threadSlotCount();
+    for (int i = 0; i < 100; i++) {
+        filtering::FilterMetrics metrics;
+        metrics.record(filtering::FilterOp::Query, 50);
+        EXPECT_EQ(filtering::FilterMetrics::threadSlotCount(), before + 1);
+    }
+    EXPECT_EQ(filtering::FilterMetrics::threadSlotCount(), before);
+
+    // A metrics object outliving the threads that recorded into it
+    auto metrics = std::make_unique<filtering::FilterMetrics>();
+    std::thread([&metrics]() { metrics->record(filtering::FilterOp::Query, 50); }).join();
+    EXPECT_EQ(metrics->histogram(filtering::FilterOp::Query).count(), 1u);
+    metrics.reset();
+
+    std::cout << "Slots released test passed\n";
+}
+
+TEST(testFilterInstrumentation) {
+    filtering::BitsetFilter filter({1});
+    filter.metrics().setSampleRate(1);
+    filter.addAttribute(0, 1);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(filter(0));
+    }
+
+    uint64_t expected = filtering::FilterMetrics::ENABLED ? 10 : 0;
+    EXPECT_EQ(filter.metrics().histogram(filtering::FilterOp::Query).count(), expected);
+
+    std::cout << "Filter instrumentation test passed\n";
+}
+
+int main() {
+    std::cout << "Running filter metrics tests...\n\n";
+
+    testHistogramBuckets();
+    testSampleRate();
+    testPerThreadAggregation();
+    testSlotsReleased();
+    testFilterInstrumentation();
+
+    std::cout << "\nAll filter metrics tests passed!\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include "../src/core/bitset_filter.h"
+#include "../src/core/roaring_filter.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t num_points = 3000;
+const unsigned int num_attributes = 300;
+
+// Random attributes, plus a few labels far past the dense range
+std::vector<std::vector<unsigned int>> makeAttributes() {
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<unsigned int> dis_attr(0, num_attributes - 1);
+    std::vector<std::vector<unsigned int>> attributes(num_points);
+    for (auto& point : attributes) {
+        for (int j = 0; j < 15; j++) point.push_back(dis_attr(gen));
+    }
+    return attributes;
+}
+
+hnswlib::labeltype labelOf(size_t i) {
+    return i % 1000 == 999 ? (hnswlib::labeltype(1) << 40) + i : i;
+}
+
+template <typename Filter>
+void fill(Filter& filter, const std::vector<std::vector<unsigned int>>& attributes) {
+    for (size_t i = 0; i < attributes.size(); i++) {
+        for (unsigned int attr : attributes[i]) filter.addAttribute(labelOf(i), attr);
+    }
+}
+
+template <typename Filter>
+bool sameAttributes(const Filter& a, const Filter& b) {
+    for (size_t i = 0; i < num_points; i++) {
+        for (unsigned int attr = 0; attr < num_attributes; attr++) {
+            if (a.hasAttribute(labelOf(i), attr) != b.hasAttribute(labelOf(i), attr)) return false;
+        }
+    }
+    return true;
+}
+
+TEST(testBitsetRoundTrip) {
+    auto attributes = makeAttributes();
+    filtering::BitsetFilter original({}, num_attributes);
+    fill(original, attributes);
+    original.saveAttributes("test_bitset_attributes.bin");
+
+    filtering::BitsetFilter loaded;
+    loaded.loadAttributes("test_bitset_attributes.bin");
+    EXPECT_EQ(loaded.getMaxAttributes(), num_attributes);
+    EXPECT_TRUE(sameAttributes(original, loaded));
+    for (unsigned int attr = 0; attr < num_attributes; attr++) {
+        EXPECT_EQ(loaded.getAttributeCardinality(attr), original.getAttributeCardinality(attr));
+    }
+
+    // Writes to the mapped slab are private to this filter
+    loaded.addAttribute(labelOf(0), 299);
+    loaded.removeAttribute(labelOf(1), attributes[1][0]);
+    filtering::BitsetFilter reloaded;
+    reloaded.loadAttributes("test_bitset_attributes.bin");
+    EXPECT_TRUE(sameAttributes(original, reloaded));
+    EXPECT_EQ(loaded.hasAttribute(labelOf(0), 299), true);
+    EXPECT_FALSE(loaded.hasAttribute(labelOf(1), attributes[1][0]));
+
+    // Growing past the mapped rows moves the slab to the heap
+    for (size_t i = num_points; i < num_points + 500; i++) loaded.addAttribute(i, 7);
+    EXPECT_TRUE(loaded.hasAttribute(num_points + 499, 7));
+    EXPECT_TRUE(loaded.hasAttribute(labelOf(0), 299));
+    EXPECT_EQ(loaded.getAttributeCardinality(7), reloaded.getAttributeCardinality(7) + 500);
+
+    std::remove("test_bitset_attributes.bin");
+    std::cout << "Bitset round trip test passed\n";
+}
+
+TEST(testRoaringRoundTrip) {
+    auto attributes = makeAttributes();
+    filtering::RoaringFilter original;
+    fill(original, attributes);
+    original.saveAttributes("test_roaring_attributes.bin");
+
+    filtering::RoaringFilter loaded;
+    loaded.setQueryMode(filtering::QueryMode::Materialized);
+    loaded.setQueryAttributes({3, 4});
+    loaded.loadAttributes("test_roaring_attributes.bin");
+    EXPECT_TRUE(sameAttributes(original, loaded));
+    for (unsigned int attr = 0; attr < num_attributes; attr++) {
+        EXPECT_EQ(loaded.getAttributeCardinality(attr), original.getAttributeCardinality(attr));
+    }
+    // The current query is kept and re-materialized against the loaded points
+    EXPECT_EQ(loaded.getAllowedSlots().cardinality(), original.matchingSlots({3, 4}).cardinality());
+
+    // The first write copies the mapped bitmaps
+    loaded.addAttribute(labelOf(0), 299);
+    loaded.removeAttribute(labelOf(1), attributes[1][0]);
+    EXPECT_TRUE(loaded.hasAttribute(labelOf(0), 299));
+    EXPECT_FALSE(loaded.hasAttribute(labelOf(1), attributes[1][0]));
+    filtering::RoaringFilter reloaded;
+    reloaded.loadAttributes("test_roaring_attributes.bin");
+    EXPECT_TRUE(sameAttributes(original, reloaded));
+
+    std::remove("test_roaring_attributes.bin");
+    std::cout << "Roaring round trip test passed\n";
+}
+
+TEST(testSearchAfterLoad) {
+    const size_t dim = 8;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    std::mt19937 gen(9);
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    std::vector<float> point(dim);
+
+    filtering::BitsetFilter bitset_filter({}, num_attributes);
+    filtering::RoaringFilter roaring_filter;
+    for (size_t i = 0; i < num_points; i++) {
+        for (auto& x : point) x = dis(gen);
+        index.addPoint(point.data(), i);
+        bitset_filter.addAttribute(i, i % 7);
+        roaring_filter.addAttribute(i, i % 7);
+    }
+    bitset_filter.alignWith(index);
+    roaring_filter.alignWith(index);
+    bitset_filter.saveAttributes("test_bitset_attributes.bin");
+    roaring_filter.saveAttributes("test_roaring_attributes.bin");
+
+    // Loaded stores must be aligned again before searching by internal id
+    filtering::BitsetFilter bitset_loaded;
+    filtering::RoaringFilter roaring_loaded;
+    bitset_loaded.loadAttributes("test_bitset_attributes.bin");
+    roaring_loaded.loadAttributes("test_roaring_attributes.bin");
+    EXPECT_FALSE(bitset_loaded.slots().isAlignedWith(index));
+    bitset_loaded.alignWith(index);
+    roaring_loaded.alignWith(index);
+
+    auto bitset_query = bitset_loaded.makeQuery(std::vector<unsigned int>{3});
+    auto roaring_query = roaring_loaded.makeQuery(std::vector<unsigned int>{3});
+    filtering::InternalIdFilter<filtering::BitsetQuery> bitset_internal(bitset_query, index);
+    filtering::InternalIdFilter<filtering::RoaringQuery> roaring_internal(roaring_query, index);
+    for (auto* internal_filter : std::initializer_list<hnswlib::BaseInternalFilterFunctor*>{&bitset_internal, &roaring_internal}) {
+        auto result = index.searchKnn(point.data(), 10, internal_filter);
+        EXPECT_EQ(result.size(), 10);
+        while (!result.empty()) {
+            EXPECT_EQ(result.top().second % 7, 3);
+            result.pop();
+        }
+    }
+
+    std::remove("test_bitset_attributes.bin");
+    std::remove("test_roaring_attributes.bin");
+    std::cout << "Search after load test passed\n";
+}
+
+std::vector<std::pair<float, hnswlib::labeltype>> toVector(std::priority_queue<std::pair<float, hnswlib::labeltype>> result) {
+    std::vector<std::pair<float, hnswlib::labeltype>> items;
+    for (; !result.empty(); result.pop()) items.push_back(result.top());
+    return items;
+}
+
+TEST(testMappedIndex) {
+    const size_t dim = 16;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    std::vector<std::vector<float>> points(num_points, std::vector<float>(dim));
+    filtering::BitsetFilter filter({}, num_attributes);
+    for (size_t i = 0; i < num_points; i++) {
+        for (auto& x : points[i]) x = dis(gen);
+        index.addPoint(points[i].data(), labelOf(i));
+        filter.addAttribute(labelOf(i), i % 5);
+    }
+    index.markDelete(labelOf(10));
+    filter.alignWith(index);
+    index.saveMappableIndex("test_mapped_index.bin");
+    filter.saveAttributes("test_bitset_attributes.bin");
+
+    hnswlib::HierarchicalNSW<float> mapped(&space);
+    mapped.loadMappedIndex("test_mapped_index.bin", &space);
+    filtering::BitsetFilter mapped_filter;
+    mapped_filter.loadAttributes("test_bitset_attributes.bin");
+    EXPECT_TRUE(mapped.isReadOnly());
+    EXPECT_EQ(mapped.getCurrentElementCount(), num_points);
+    EXPECT_EQ(mapped.getDeletedCount(), 1);
+    EXPECT_EQ(mapped.getDataByLabel<float>(labelOf(999)), points[999]);
+    // A loaded store is not trusted to match the loaded index until aligned again
+    EXPECT_FALSE(mapped_filter.slots().isAlignedWith(mapped));
+    mapped_filter.alignWith(mapped);
+    EXPECT_TRUE(mapped_filter.slots().isAlignedWith(mapped));
+
+    // Same graph, same results, with or without a filter
+    index.setEf(50);
+    mapped.setEf(50);
+    auto query = filter.makeQuery(std::vector<unsigned int>{2});
+    auto mapped_query = mapped_filter.makeQuery(std::vector<unsigned int>{2});
+    filtering::InternalIdFilter<filtering::BitsetQuery> internal_filter(query, index);
+    filtering::InternalIdFilter<filtering::BitsetQuery> mapped_internal_filter(mapped_query, mapped);
+    for (size_t q = 0; q < 50; q++) {
+        const float* target = points[q * 37].data();
+        EXPECT_TRUE(index.searchKnnCloserFirst(target, 10) == mapped.searchKnnCloserFirst(target, 10));
+        EXPECT_TRUE(toVector(index.searchKnn(target, 10, &internal_filter)) ==
+                    toVector(mapped.searchKnn(target, 10, &mapped_internal_filter)));
+    }
+
+    auto throws = [](auto&& operation) {
+        try {
+            operation();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    EXPECT_TRUE(throws([&] { mapped.addPoint(points[0].data(), num_points); }));
+    EXPECT_TRUE(throws([&] { mapped.markDelete(labelOf(0)); }));
+    EXPECT_TRUE(throws([&] { mapped.resizeIndex(2 * num_points); }));
+    EXPECT_TRUE(throws([&] { mapped.updatePoint(points[0].data(), 0, 1.0f); }));
+
+    // The regular format is not mappable
+    index.saveIndex("test_index.bin");
+    hnswlib::HierarchicalNSW<float> other(&space);
+    EXPECT_TRUE(throws([&] { other.loadMappedIndex("test_index.bin", &space); }));
+
+    std::remove("test_mapped_index.bin");
+    std::remove("test_index.bin");
+    std::remove("test_bitset_attributes.bin");
+    std::cout << "Mapped index test passed\n";
+}
+
+TEST(testRejectsBadMappedIndex) {
+    const size_t dim = 8, count = 500;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, count);
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    std::vector<float> point(dim);
+    for (size_t i = 0; i < count; i++) {
+        for (auto& x : point) x = dis(gen);
+        index.addPoint(point.data(), i);
+    }
+    index.saveMappableIndex("test_mapped_index.bin");
+
+    std::ifstream input("test_mapped_index.bin", std::ios::binary);
+    std::string good((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+
+    hnswlib::HierarchicalNSW<float> mapped(&space);
+    mapped.loadMappedIndex("test_mapped_index.bin", &space);
+    auto expected = mapped.searchKnnCloserFirst(point.data(), 10);
+
+    // Header fields at their byte offsets, then level 0 from byte 128
+    const size_t enterpoint_at = 64, size_data_at = 36, first_link_at = 128 + sizeof(hnswlib::linklistsizeint);
+    auto withBytes = [&](size_t at, const void* bytes, size_t num_bytes) {
+        std::string bad = good;
+        bad.replace(at, num_bytes, static_cast<const char*>(bytes), num_bytes);
+        return bad;
+    };
+    const hnswlib::tableint past_end = count + 7;
+    const size_t odd_size = index.size_data_per_element_ + 4;
+    std::vector<std::string> bad_files = {
+        good.substr(0, good.size() / 2),
+        good.substr(0, good.size() - 1),
+        withBytes(enterpoint_at, &past_end, sizeof(past_end)),
+        withBytes(size_data_at, &odd_size, sizeof(odd_size)),
+        withBytes(first_link_at, &past_end, sizeof(past_end)),
+    };
+    for (const std::string& bad : bad_files) {
+        std::ofstream output("test_bad_mapped_index.bin", std::ios::binary);
+        output.write(bad.data(), bad.size());
+        output.close();
+
+        bool thrown = false;
+        try {
+            mapped.loadMappedIndex("test_bad_mapped_index.bin", &space);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        EXPECT_TRUE(thrown);
+        // The index loaded before is untouched
+        EXPECT_EQ(mapped.getCurrentElementCount(), count);
+        EXPECT_TRUE(mapped.searchKnnCloserFirst(point.data(), 10) == expected);
+    }
+
+    std::remove("test_mapped_index.bin");
+    std::remove("test_bad_mapped_index.bin");
+    std::cout << "Bad mapped index test passed\n";
+}
+
+TEST(testRejectsBadFiles) {
+    filtering::RoaringFilter roaring_filter;
+    roaring_filter.addAttribute(1, 2);
+    roaring_filter.saveAttributes("test_roaring_attributes.bin");
+
+    auto throws = [](auto& filter, const std::string& location) {
+        try {
+            filter.loadAttributes(location);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+
+    // Wrong filter type
+    filtering::BitsetFilter bitset_filter;
+    EXPECT_TRUE(throws(bitset_filter, "test_roaring_attributes.bin"));
+    // Missing file
+    EXPECT_TRUE(throws(bitset_filter, "missing_attributes.bin"));
+
+    // Truncated file
+    std::ifstream input("test_roaring_attributes.bin", std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+    std::ofstream("test_truncated_attributes.bin", std::ios::binary).write(contents.data(), contents.size() - 3);
+    filtering::RoaringFilter truncated;
+    EXPECT_TRUE(throws(truncated, "test_truncated_attributes.bin"));
+
+    // Other format version
+    contents[8] = 99;
+    std::ofstream("test_truncated_attributes.bin", std::ios::binary).write(contents.data(), contents.size());
+    EXPECT_TRUE(throws(truncated, "test_truncated_attributes.bin"));
+
+    std::remove("test_roaring_attributes.bin");
+    std::remove("test_truncated_attributes.bin");
+    std::cout << "Bad file test passed\n";
+}
+
+int main() {
+    std::cout << "Running filter persistence tests...\n\n";
+
+    testBitsetRoundTrip();
+    testRoaringRoundTrip();
+    testSearchAfterLoad();
+    testMappedIndex();
+    testRejectsBadMappedIndex();
+    testRejectsBadFiles();
+
+    std::cout << "\nAll filter persistence tests passed!\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include "../src/core/bitset_filter.h"
+#include "../src/core/roaring_filter.h"
+#include "test_common.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 16;
+const size_t num_points = 5000;
+const unsigned int common_attr = 1;
+const unsigned int rare_attr = 2;   // On every 500th point
+const unsigned int tenth_attr = 3;  // On every 10th point
+
+struct Fixture : WorkloadIndex {
+    filtering::BitsetFilter filter;
+
+    Fixture() : WorkloadIndex(pointOptions(dim, num_points, 11), 0) {
+        for (size_t i = 0; i < num_points; i++) {
+            filter.addAttribute(i, common_attr);
+            if (i % 500 == 0) filter.addAttribute(i, rare_attr);
+            if (i % 10 == 3) filter.addAttribute(i, tenth_attr);
+        }
+        filter.alignWith(index);
+    }
+};
+
+TEST(testInternalIdPathMatchesLabelPath) {
+    Fixture f;
+    filtering::InternalIdFilter<filtering::BitsetFilter> internal_filter(f.filter, f.index);
+
+    for (unsigned int attr : {common_attr, rare_attr}) {
+        f.filter.setQueryAttributes({attr});
+        for (size_t q = 0; q < 20; q++) {
+            auto by_label = f.index.searchKnn(f.point(q), 10, &f.filter);
+            auto by_internal_id = f.index.searchKnn(f.point(q), 10, &internal_filter);
+            EXPECT_EQ(by_label.size(), by_internal_id.size());
+            while (!by_label.empty()) {
+                EXPECT_EQ(by_label.top().second, by_internal_id.top().second);
+                by_label.pop();
+                by_internal_id.pop();
+            }
+        }
+    }
+
+    // A null filter still picks the unfiltered search
+    EXPECT_TRUE(sameResult(f.index.searchKnn(f.point(0), 10, nullptr), f.index.searchKnn(f.point(0), 10)));
+
+    std::cout << "Internal id path test passed\n";
+}
+
+TEST(testAdaptiveSearchFillsK) {
+    Fixture f;
+    filtering::InternalIdFilter<filtering::BitsetFilter> internal_filter(f.filter, f.index);
+    f.filter.setQueryAttributes({rare_attr});
+    const size_t k = num_points / 500;
+
+    for (size_t q = 0; q < 20; q++) {
+        auto result = f.index.searchKnnAdaptive(f.point(q), k, &internal_filter);
+        EXPECT_EQ(result.size(), k);
+        while (!result.empty()) {
+            EXPECT_EQ(result.top().second % 500, 0u);
+            result.pop();
+        }
+    }
+
+    std::cout << "Adaptive search test passed\n";
+}
+
+TEST(testAdaptiveSearchBudget) {
+    Fixture f;
+    filtering::InternalIdFilter<filtering::BitsetFilter> internal_filter(f.filter, f.index);
+    f.filter.setQueryAttributes({rare_attr});
+    const size_t k = num_points / 500;
+
+    // The base layer stops within one neighbour list (and the entry point) of the budget,
+    // also inside the first round. The fixture sets no extra links, which would add to it.
+    for (size_t budget : {size_t(1), size_t(100), size_t(1000)}) {
+        for (size_t q = 0; q < 20; q++) {
+            hnswlib::SearchStats upper, stats;
+            f.index.searchUpperLayers(f.point(q), &upper);
+            auto capped = f.index.searchKnnAdaptive(f.point(q), k, &internal_filter, budget, &stats);
+            EXPECT_TRUE(capped.size() <= k);
+            EXPECT_TRUE(stats.distance_computations - upper.distance_computations <= budget + f.index.maxM0_ + 1);
+        }
+    }
+
+    // A budget the search never reaches changes nothing
+    for (size_t q = 0; q < 20; q++) {
+        auto capped = f.index.searchKnnAdaptive(f.point(q), k, &internal_filter, num_points * 100);
+        auto uncapped = f.index.searchKnnAdaptive(f.point(q), k, &internal_filter);
+        EXPECT_TRUE(sameResult(capped, uncapped));
+    }
+
+    std::cout << "Adaptive search budget test passed\n";
+}
+
+TEST(testTwoHopTraversal) {
+    Fixture f;
+    filtering::InternalIdFilter<filtering::BitsetFilter> internal_filter(f.filter, f.index);
+    f.filter.setQueryAttributes({tenth_attr});
+    const size_t k = 10;
+    f.index.setEf(50);
+
+    size_t found = 0;
+    long computations[2] = {0, 0};
+    for (size_t q = 0; q < 50; q++) {
+        std::vector<std::pair<float, hnswlib::labeltype>> exact;
+        for (size_t i = 3; i < num_points; i += 10) {
+            exact.emplace_back(hnswlib::L2Sqr(f.point(q), f.point(i), f.space.get_dist_func_param()), i);
+        }
+        std::sort(exact.begin(), exact.end());
+
+        for (int two_hop = 0; two_hop < 2; two_hop++) {
+            auto traversal = two_hop ? hnswlib::FilterTraversal::TwoHop : hnswlib::FilterTraversal::ScoreAll;
+            hnswlib::SearchStats stats;
+            auto ids = f.index.searchBaseLayerST<false, true>(f.index.searchUpperLayers(f.point(q), &stats),
+                                                              f.point(q), 50, &internal_filter,
+                                                              nullptr, traversal, nullptr, &stats);
+            computations[two_hop] += stats.distance_computations;
+            if (!two_hop) continue;
+
+            auto result = f.index.searchKnnWithFilter(f.point(q), k, &internal_filter, traversal);
+            EXPECT_EQ(result.size(), k);
+            for (; !result.empty(); result.pop()) {
+                EXPECT_EQ(result.top().second % 10, 3u);
+                for (size_t j = 0; j < k; j++) {
+                    if (exact[j].second == result.top().second) found++;
+                }
+            }
+        }
+    }
+
+    // Rejected neighbours are not scored, and their allowed neighbours keep recall up
+    EXPECT_TRUE(computations[1] * 2 < computations[0]);
+    EXPECT_TRUE(found >= 50 * k * 9 / 10);
+
+    std::cout << "Two-hop traversal test passed\n";
+}
+
+TEST(testBruteforceFilteredGroundTruth) {
+    Fixture f;
+    hnswlib::BruteforceSearch<float> bruteforce(&f.space, num_points);
+    for (size_t i = 0; i < num_points; i++) bruteforce.addPoint(f.point(i), i);
+    f.filter.setQueryAttributes({rare_attr});
+    const size_t k = 5;
+
+    // Fewer than k of the first k points pass the filter; the rest must still be scanned
+    for (size_t q = 0; q < 20; q++) {
+        std::vector<std::pair<float, hnswlib::labeltype>> exact;
+        for (size_t i = 0; i < num_points; i += 500) {
+            exact.emplace_back(hnswlib::L2Sqr(f.point(q), f.point(i), f.space.get_dist_func_param()), i);
+        }
+        std::sort(exact.begin(), exact.end());
+
+        auto result = bruteforce.searchKnn(f.point(q), k, &f.filter);
+        EXPECT_EQ(result.size(), k);
+        for (size_t j = k; j-- > 0; result.pop()) {
+            EXPECT_EQ(result.top().second, exact[j].second);
+        }
+    }
+
+    std::cout << "Bruteforce filtered test passed\n";
+}
+
+std::vector<hnswlib::labeltype> toLabels(std::priority_queue<std::pair<float, hnswlib::labeltype>> result) {
+    std::vector<hnswlib::labeltype> labels;
+    while (!result.empty()) {
+        labels.push_back(result.top().second);
+        result.pop();
+    }
+    return labels;
+}
+
+TEST(testConcurrentQueries) {
+    Fixture f;
+    filtering::RoaringFilter roaring;
+    for (size_t i = 0; i < num_points; i++) {
+        roaring.addAttribute(i, common_attr);
+        if (i % 500 == 0) roaring.addAttribute(i, rare_attr);
+    }
+    roaring.alignWith(f.index);
+
+    // Reference results from the stateful filters, one query at a time
+    const size_t num_queries = 64;
+    std::vector<std::vector<hnswlib::labeltype>> expected(num_queries);
+    for (size_t q = 0; q < num_queries; q++) {
+        f.filter.setQueryAttributes({q % 2 ? rare_attr : common_attr});
+        expected[q] = toLabels(f.index.searchKnn(f.point(q), 10, &f.filter));
+    }
+
+    // Each thread builds its own predicates over the shared, unmodified filters
+    std::vector<size_t> mismatches(4, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < mismatches.size(); t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t q = t; q < num_queries; q += mismatches.size()) {
+                std::vector<unsigned int> attrs = {q % 2 ? rare_attr : common_attr};
+                auto bitset_query = f.filter.makeQuery(attrs);
+                auto roaring_query = roaring.makeQuery(attrs);
+                filtering::QueryFilter<filtering::BitsetQuery> by_label(bitset_query);
+                filtering::InternalIdFilter<filtering::RoaringQuery> by_internal_id(roaring_query, f.index);
+
+                if (toLabels(f.index.searchKnn(f.point(q), 10, &by_label)) != expected[q]) {
+                    mismatches[t]++;
+                }
+                if (toLabels(f.index.searchKnn(f.point(q), 10, &by_internal_id)) != expected[q]) {
+                    mismatches[t]++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    for (size_t count : mismatches) {
+        EXPECT_EQ(count, 0u);
+    }
+
+    std::cout << "Concurrent queries test passed\n";
+}
+
+int main() {
+    std::cout << "Running filtered search tests...\n\n";
+
+    testInternalIdPathMatchesLabelPath();
+    testAdaptiveSearchFillsK();
+    testAdaptiveSearchBudget();
+    testTwoHopTraversal();
+    testBruteforceFilteredGroundTruth();
+    testConcurrentQueries();
+
+    std::cout << "\nAll filtered search tests passed!\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include <iostream>
+#include <cassert>
+#include <random>
+#include "../src/core/bitset_filter.h"
+#include "../src/core/index_builder.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 16;
+const size_t num_points = 4000;
+const unsigned int num_attributes = 20;
+
+// Points stored back to back, with attribute i % num_attributes on point i
+struct Dataset {
+    std::vector<float> vectors;
+    std::vector<hnswlib::labeltype> labels;
+    std::vector<size_t> offsets;
+    std::vector<unsigned int> attributes;
+
+    Dataset() {
+        std::mt19937 gen(5);
+        std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+        vectors.resize(num_points * dim);
+        for (float& x : vectors) x = dis(gen);
+        offsets.push_back(0);
+        for (size_t i = 0; i < num_points; i++) {
+            labels.push_back(1000 + i);
+            attributes.push_back(i % num_attributes);
+            offsets.push_back(attributes.size());
+        }
+    }
+
+    const float* vector(size_t i) const { return vectors.data() + i * dim; }
+
+    filtering::AttributeBatch batch(size_t begin, size_t end) const {
+        return {labels.data() + begin, end - begin, offsets.data() + begin, attributes.data()};
+    }
+};
+
+// Fraction of exact nearest neighbours found by the index, over a few queries
+static double recall(hnswlib::HierarchicalNSW<float>& index, const Dataset& data) {
+    hnswlib::L2Space space(dim);
+    size_t found = 0, expected = 0;
+    for (size_t q = 0; q < 20; q++) {
+        std::vector<std::pair<float, hnswlib::labeltype>> exact;
+        for (size_t i = 0; i < num_points; i++) {
+            exact.emplace_back(hnswlib::L2Sqr(data.vector(q), data.vector(i), space.get_dist_func_param()),
+                               data.labels[i]);
+        }
+        std::partial_sort(exact.begin(), exact.begin() + 10, exact.end());
+        auto result = index.searchKnn(data.vector(q), 10);
+        while (!result.empty()) {
+            for (size_t j = 0; j < 10; j++) {
+                if (exact[j].second == result.top().second) found++;
+            }
+            result.pop();
+        }
+        expected += 10;
+    }
+    return double(found) / expected;
+}
+
+TEST(testParallelBuild) {
+    Dataset data;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    filtering::BitsetFilter filter({}, num_attributes);
+
+    filtering::BuildOptions options;
+    options.num_threads = 4;
+    options.chunk_size = 64;
+    filtering::ParallelIndexBuilder<float> builder(index, &filter, options);
+    auto batch = data.batch(0, num_points);
+    auto report = builder.add(data.vectors.data(), data.labels.data(), num_points, &batch);
+
+    EXPECT_EQ(report.points_inserted, num_points);
+    EXPECT_EQ(report.index_resizes, size_t(0));
+    EXPECT_EQ(index.getCurrentElementCount(), num_points);
+    for (size_t i = 0; i < num_points; i += 97) {
+        auto stored = index.getDataByLabel<float>(data.labels[i]);
+        EXPECT_TRUE(std::equal(stored.begin(), stored.end(), data.vector(i)));
+        EXPECT_TRUE(filter.hasAttribute(data.labels[i], i % num_attributes));
+    }
+    EXPECT_EQ(filter.getAttributeCardinality(3), num_points / num_attributes);
+    EXPECT_TRUE(recall(index, data) > 0.9);
+
+    std::cout << "Parallel build test passed\n";
+}
+
+TEST(testBuildAlignsFilter) {
+    Dataset data;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    filtering::BitsetFilter filter({}, num_attributes);
+
+    filtering::BuildOptions options;
+    options.num_threads = 4;
+    options.chunk_size = 16;
+    filtering::ParallelIndexBuilder<float> builder(index, &filter, options);
+    const size_t half = num_points / 2;
+    auto first = data.batch(0, half);
+    auto second = data.batch(half, num_points);
+    builder.add(data.vectors.data(), data.labels.data(), half, &first);
+    builder.add(data.vector(half), data.labels.data() + half, num_points - half, &second);
+
+    // Inserts land in any order, yet every slot is the internal id of its label
+    EXPECT_TRUE(filter.slots().isAlignedWith(index));
+    for (size_t i = 0; i < num_points; i++) {
+        EXPECT_EQ(filter.slots().find(data.labels[i]), index.label_lookup_.at(data.labels[i]));
+    }
+
+    auto query = filter.makeQuery(std::vector<unsigned int>{7});
+    filtering::InternalIdFilter<filtering::BitsetQuery> internal_filter(query, index);
+    for (size_t q = 0; q < 20; q++) {
+        auto result = index.searchKnn(data.vector(q * 101), 10, &internal_filter);
+        EXPECT_EQ(result.size(), size_t(10));
+        for (; !result.empty(); result.pop()) {
+            EXPECT_EQ((result.top().second - 1000) % num_attributes, size_t(7));
+        }
+    }
+
+    std::cout << "Build aligns filter test passed\n";
+}
+
+TEST(testStreamingBuildResizes) {
+    Dataset data;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, 100);
+    filtering::BitsetFilter filter({}, num_attributes);
+
+    filtering::BuildOptions options;
+    options.num_threads = 3;
+    filtering::ParallelIndexBuilder<float> builder(index, &filter, options);
+
+    const size_t batch_size = 500;
+    for (size_t begin = 0; begin < num_points; begin += batch_size) {
+        auto batch = data.batch(begin, begin + batch_size);
+        builder.add(data.vector(begin), data.labels.data() + begin, batch_size, &batch);
+    }
+
+    // 100 -> 500 -> 1000 -> 2000 -> 4000
+    EXPECT_EQ(builder.totals().points_inserted, num_points);
+    EXPECT_EQ(builder.totals().index_resizes, size_t(4));
+    EXPECT_EQ(index.getMaxElements(), num_points);
+    EXPECT_EQ(index.getCurrentElementCount(), num_points);
+    EXPECT_TRUE(filter.hasAttribute(data.labels[num_points - 1], (num_points - 1) % num_attributes));
+    EXPECT_TRUE(recall(index, data) > 0.9);
+
+    std::cout << "Streaming build test passed\n";
+}
+
+TEST(testProgressReports) {
+    Dataset data;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+
+    std::vector<size_t> reported;
+    filtering::BuildOptions options;
+    options.num_threads = 4;
+    options.chunk_size = 50;
+    options.progress_interval = 1000;
+    options.on_progress = [&](const filtering::BuildProgress& progress) {
+        EXPECT_EQ(progress.points_total, num_points);
+        reported.push_back(progress.points_inserted);
+    };
+    filtering::ParallelIndexBuilder<float> builder(index, nullptr, options);
+    builder.add(data.vectors.data(), data.labels.data(), num_points);
+
+    EXPECT_FALSE(reported.empty());
+    EXPECT_TRUE(reported.size() <= num_points / options.progress_interval);
+    EXPECT_TRUE(std::is_sorted(reported.begin(), reported.end()));
+    EXPECT_EQ(reported.back(), num_points);
+
+    std::cout << "Progress report test passed\n";
+}
+
+TEST(testBuildErrors) {
+    Dataset data;
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    filtering::ParallelIndexBuilder<float> no_filter(index);
+
+    auto batch = data.batch(0, 10);
+    bool thrown = false;
+    try {
+        no_filter.add(data.vectors.data(), data.labels.data(), 10, &batch);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+    EXPECT_EQ(index.getCurrentElementCount(), size_t(0));
+
+    std::cout << "Build error test passed\n";
+}
+
+int main() {
+    std::cout << "Running index builder tests...\n\n";
+
+    testParallelBuild();
+    testBuildAlignsFilter();
+    testStreamingBuildResizes();
+    testProgressReports();
+    testBuildErrors();
+
+    std::cout << "\nAll index builder tests passed!\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <cassert>
+#include "../src/core/partitioned_index.h"
+#include "test_common.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 16;
+const size_t num_points = 3000;
+const unsigned int hot_attr = 1;    // Every third point
+const unsigned int even_attr = 2;   // Every other point
+const unsigned int rare_attr = 3;   // Every 100th point
+const size_t k = 10;
+const size_t num_added = 50;
+
+// Queries double as the points testMaintenance adds
+struct Fixture : WorkloadIndex {
+    filtering::RoaringFilter filter;
+
+    Fixture() : WorkloadIndex(pointOptions(dim, num_points, 9), num_added, 16, 200, num_points + 100) {
+        for (size_t i = 0; i < num_points; i++) {
+            if (i % 3 == 0) filter.addAttribute(i, hot_attr);
+            if (i % 2 == 0) filter.addAttribute(i, even_attr);
+            if (i % 100 == 0) filter.addAttribute(i, rare_attr);
+        }
+        index.setEf(50);
+    }
+};
+
+TEST(testRouting) {
+    Fixture f;
+    filtering::PartitionedIndex<float> partitioned(&f.space, f.index, f.filter);
+    partitioned.addPartition(hot_attr);
+    EXPECT_TRUE(partitioned.isPartitioned(hot_attr));
+    EXPECT_EQ(partitioned.partition(hot_attr)->getCurrentElementCount(), num_points / 3);
+
+    filtering::SearchRoute route;
+    for (size_t q = 0; q < 20; q++) {
+        auto result = partitioned.searchKnn(f.point(q), k, {hot_attr}, &route);
+        EXPECT_TRUE(route == filtering::SearchRoute::Partition);
+        EXPECT_EQ(result.size(), k);
+        for (; !result.empty(); result.pop()) EXPECT_EQ(result.top().second % 3, 0u);
+
+        result = partitioned.searchKnn(f.point(q), k, {even_attr, hot_attr}, &route);
+        EXPECT_TRUE(route == filtering::SearchRoute::FilteredPartition);
+        EXPECT_EQ(result.size(), k);
+        for (; !result.empty(); result.pop()) EXPECT_EQ(result.top().second % 6, 0u);
+
+        result = partitioned.searchKnn(f.point(q), k, {even_attr}, &route);
+        EXPECT_TRUE(route == filtering::SearchRoute::Global);
+        for (; !result.empty(); result.pop()) EXPECT_EQ(result.top().second % 2, 0u);
+    }
+
+    // A partitioned attribute's own points find themselves
+    auto self = partitioned.searchKnn(f.point(3), 1, {hot_attr});
+    EXPECT_EQ(self.top().second, 3u);
+
+    std::cout << "Routing test passed\n";
+}
+
+TEST(testSmallestPartitionWins) {
+    Fixture f;
+    filtering::PartitionedIndex<float> partitioned(&f.space, f.index, f.filter);
+    partitioned.addPartition(hot_attr);
+    partitioned.addPartition(even_attr);
+
+    filtering::SearchRoute route;
+    auto result = partitioned.searchKnn(f.point(0), k, {even_attr, hot_attr}, &route);
+    EXPECT_TRUE(route == filtering::SearchRoute::FilteredPartition);
+    for (; !result.empty(); result.pop()) EXPECT_EQ(result.top().second % 6, 0u);
+
+    // Partition size follows the attribute's cardinality
+    auto stats = partitioned.partitionStats();
+    EXPECT_EQ(stats.size(), size_t(2));
+    EXPECT_EQ(stats[0].attribute, hot_attr);
+    EXPECT_EQ(stats[0].num_points, num_points / 3);
+    EXPECT_EQ(stats[1].num_points, num_points / 2);
+    EXPECT_TRUE(stats[0].memory_bytes > 0);
+    EXPECT_TRUE(stats[0].memory_bytes < stats[1].memory_bytes);
+    EXPECT_TRUE(stats[1].memory_bytes < f.index.memoryUsage());
+
+    std::cout << "Smallest partition test passed\n";
+}
+
+TEST(testMaintenance) {
+    Fixture f;
+    filtering::PartitionedIndex<float> partitioned(&f.space, f.index, f.filter);
+    partitioned.addPartition(hot_attr);
+
+    // New points reach the partition, which grows as needed
+    for (size_t i = 0; i < num_added; i++) {
+        partitioned.addPoint(f.query(i), num_points + i, {hot_attr});
+    }
+    EXPECT_EQ(partitioned.partitionStats()[0].num_points, num_points / 3 + num_added);
+    auto added = partitioned.searchKnn(f.query(7), 1, {hot_attr});
+    EXPECT_EQ(added.top().second, num_points + 7);
+
+    // Deletes, and attribute changes made on the filter directly after a refresh
+    partitioned.markDelete(num_points + 7);
+    f.filter.removeAttribute(0, hot_attr);
+    f.filter.addAttribute(1, hot_attr);
+    partitioned.refresh();
+    EXPECT_EQ(partitioned.partitionStats()[0].num_points, num_points / 3 + num_added - 1);
+    for (const float* query : {f.point(0), f.point(1), f.query(7)}) {
+        auto result = partitioned.searchKnn(query, k, {hot_attr});
+        for (; !result.empty(); result.pop()) {
+            EXPECT_TRUE(result.top().second != 0);
+            EXPECT_TRUE(result.top().second != num_points + 7);
+            EXPECT_TRUE(f.filter.hasAttribute(result.top().second, hot_attr));
+        }
+    }
+    auto regained = partitioned.searchKnn(f.point(1), 1, {hot_attr});
+    EXPECT_EQ(regained.top().second, 1u);
+
+    partitioned.removePartition(hot_attr);
+    filtering::SearchRoute route;
+    partitioned.searchKnn(f.point(0), k, {hot_attr}, &route);
+    EXPECT_TRUE(route == filtering::SearchRoute::Global);
+
+    std::cout << "Maintenance test passed\n";
+}
+
+int main() {
+    std::cout << "Running partitioned index tests...\n\n";
+
+    testRouting();
+    testSmallestPartitionWins();
+    testMaintenance();
+
+    std::cout << "\nAll partitioned index tests passed!\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include <iostream>
+#include <cassert>
+#include <random>
+#include "../src/core/query_planner.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 8;
+const size_t num_points = 2000;
+
+// Attribute 0 on every point, attribute 1 on every 100th point
+void buildIndex(hnswlib::HierarchicalNSW<float>& index, filtering::RoaringFilter& filter,
+                std::vector<std::vector<float>>& points) {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    points.assign(num_points, std::vector<float>(dim));
+    for (size_t i = 0; i < num_points; i++) {
+        for (size_t j = 0; j < dim; j++) points[i][j] = dis(gen);
+        index.addPoint(points[i].data(), i);
+        filter.addAttribute(i, 0);
+        if (i % 100 == 0) filter.addAttribute(i, 1);
+    }
+    filter.alignWith(index);
+}
+
+TEST(testSelectivityEstimate) {
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    filtering::RoaringFilter filter;
+    std::vector<std::vector<float>> points;
+    buildIndex(index, filter, points);
+
+    EXPECT_EQ(filter.getAttributeCardinality(1), num_points / 100);
+    EXPECT_TRUE(filter.estimateSelectivity({0}) == 1.0);
+    EXPECT_TRUE(filter.estimateSelectivity({1}) == 0.01);
+    EXPECT_TRUE(filter.estimateSelectivity({2}) == 0.0);
+
+    std::cout << "Selectivity estimate test passed\n";
+}
+
+TEST(testPlanChoice) {
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    filtering::RoaringFilter filter;
+    std::vector<std::vector<float>> points;
+    buildIndex(index, filter, points);
+
+    filtering::QueryPlanner<float> planner(index, filter, 0.05);
+    filtering::PlanReport report;
+
+    auto common = planner.searchKnn(points[5].data(), 10, {0}, &report);
+    EXPECT_TRUE(report.plan == filtering::SearchPlan::FilteredHnsw);
+    EXPECT_EQ(common.size(), 10u);
+
+    auto rare = planner.searchKnn(points[5].data(), 10, {0, 1}, &report);
+    EXPECT_TRUE(report.plan == filtering::SearchPlan::BruteForce);
+    EXPECT_EQ(report.matching_points, num_points / 100);
+    EXPECT_EQ(rare.size(), 10u);
+
+    EXPECT_EQ(planner.getNumHnswPlans(), 1u);
+    EXPECT_EQ(planner.getNumBruteForcePlans(), 1u);
+
+    std::cout << "Plan choice test passed\n";
+}
+
+TEST(testUnderfilledSearchFallsBack) {
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    filtering::RoaringFilter filter;
+    std::vector<std::vector<float>> points;
+    buildIndex(index, filter, points);
+
+    // Drop every link to the rare points (label == internal id here), so the graph
+    // search can reach at most the entry point among them
+    for (hnswlib::tableint id = 0; id < num_points; id++) {
+        for (int level = 0; level <= index.element_levels_[id]; level++) {
+            hnswlib::linklistsizeint* list = index.get_linklist_at_level(id, level);
+            hnswlib::tableint* links = (hnswlib::tableint*) (list + 1);
+            unsigned short kept = 0;
+            for (unsigned short j = 0; j < index.getListCount(list); j++) {
+                if (links[j] % 100 != 0) links[kept++] = links[j];
+            }
+            index.setListCount(list, kept);
+        }
+    }
+
+    // Never brute force up front, so only the fallback can find the rare points
+    filtering::QueryPlanner<float> planner(index, filter, 0.0);
+    filtering::PlanReport report;
+    const size_t k = 10;
+    auto result = planner.searchKnn(points[5].data(), k, {1}, &report);
+    EXPECT_TRUE(report.plan == filtering::SearchPlan::FilteredHnsw);
+    EXPECT_TRUE(report.fell_back);
+    EXPECT_EQ(report.matching_points, num_points / 100);
+    EXPECT_EQ(report.num_results, k);
+    EXPECT_EQ(result.size(), k);
+    for (; !result.empty(); result.pop()) EXPECT_EQ(result.top().second % 100, 0u);
+    EXPECT_EQ(planner.getNumFallbacks(), 1u);
+
+    // A filled search is returned as is
+    planner.searchKnn(points[5].data(), k, {0}, &report);
+    EXPECT_FALSE(report.fell_back);
+    EXPECT_EQ(planner.getNumFallbacks(), 1u);
+
+    // Asking for more than match returns every match
+    auto all = planner.searchKnn(points[5].data(), num_points, {1}, &report);
+    EXPECT_TRUE(report.fell_back);
+    EXPECT_EQ(all.size(), num_points / 100);
+
+    // An underfilled search that found every match is not redone
+    auto none = planner.searchKnn(points[5].data(), k, {2}, &report);
+    EXPECT_FALSE(report.fell_back);
+    EXPECT_EQ(none.size(), 0u);
+    EXPECT_EQ(planner.getNumFallbacks(), 2u);
+
+    std::cout << "Underfilled search fallback test passed\n";
+}
+
+TEST(testBruteForceIsExact) {
+    hnswlib::L2Space space(dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    filtering::RoaringFilter filter;
+    std::vector<std::vector<float>> points;
+    buildIndex(index, filter, points);
+
+    filtering::QueryPlanner<float> planner(index, filter, 0.05);
+    const size_t k = 5;
+    auto result = planner.searchKnn(points[42].data(), k, {1});
+
+    // Reference: exact scan over the labels that carry attribute 1
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> expected;
+    for (size_t i = 0; i < num_points; i += 100) {
+        expected.emplace(hnswlib::L2Sqr(points[42].data(), points[i].data(), &dim), i);
+        if (expected.size() > k) expected.pop();
+    }
+
+    EXPECT_EQ(result.size(), expected.size());
+    while (!expected.empty()) {
+        EXPECT_EQ(result.top().second, expected.top().second);
+        result.pop();
+        expected.pop();
+    }
+
+    std::cout << "Brute force exactness test passed\n";
+}
+
+int main() {
+    std::cout << "Running query planner tests...\n\n";
+
+    testSelectivityEstimate();
+    testPlanChoice();
+    testUnderfilledSearchFallsBack();
+    testBruteForceIsExact();
+
+    std::cout << "\nAll query planner tests passed!\n";
+    return 0;
+}
\ No newline at end of file
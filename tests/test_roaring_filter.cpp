@@ -67,6 +67,73 @@ TEST(testAttributeCount) {
     std::cout << "Attribute count test passed\n";
 }
 
+TEST(testMaterializedQuery) {
+    filtering::RoaringFilter filter;
+    filter.setQueryMode(filtering::QueryMode::Materialized);
+    
+    filter.addAttribute(1, 100);
+    filter.addAttribute(1, 200);
+    filter.addAttribute(2, 100);
+    filter.addAttribute(3, 300);
+
+    filter.setQueryAttributes({100, 200});
+    EXPECT_TRUE(filter(1));
+    EXPECT_FALSE(filter(2));
+    EXPECT_FALSE(filter(3));
+    EXPECT_FALSE(filter(4));  // Unknown point
+    EXPECT_EQ(filter.getAllowedSlots().cardinality(), 1);
+
+    // Updates after the query was set are reflected
+    filter.addAttribute(2, 200);
+    EXPECT_TRUE(filter(2));
+    filter.removeAttribute(1, 100);
+    EXPECT_FALSE(filter(1));
+
+    filter.setQueryAttributes({400});
+    EXPECT_FALSE(filter(1));
+    EXPECT_FALSE(filter(2));
+
+    filter.setQueryAttributes({});
+    EXPECT_TRUE(filter(3));
+    
+    std::cout << "Materialized query test passed\n";
+}
+
+TEST(testBulkAddPoints) {
+    // Labels 10..509; point 10 + i has attributes i % 7, 1000 + i and 70000 (listed twice)
+    std::vector<hnswlib::labeltype> labels;
+    std::vector<size_t> offsets = {0};
+    std::vector<unsigned int> attributes;
+    for (size_t i = 0; i < 500; i++) {
+        labels.push_back(10 + i);
+        for (unsigned int attr : {unsigned(i % 7), unsigned(1000 + i), 70000u, 70000u}) attributes.push_back(attr);
+        offsets.push_back(attributes.size());
+    }
+    filtering::AttributeBatch batch{labels.data(), labels.size(), offsets.data(), attributes.data()};
+
+    for (size_t num_threads : {1, 4}) {
+        filtering::RoaringFilter filter;
+        filter.setQueryMode(filtering::QueryMode::Materialized);
+        filter.setQueryAttributes({3, 70000});
+        filter.addAttribute(10, 5);  // Existing points keep their attributes
+        filter.addPoints(batch, num_threads);
+
+        EXPECT_TRUE(filter.hasAttributes(10, {0, 5, 1000, 70000}));
+        EXPECT_TRUE(filter.hasAttributes(509, {499 % 7, 1499, 70000}));
+        EXPECT_FALSE(filter.hasAttribute(509, 1498));
+        EXPECT_EQ(filter.getNumAttributes(11), 3u);
+        EXPECT_EQ(filter.getAttributeCardinality(70000), 500u);
+        EXPECT_EQ(filter.getAttributeCardinality(3), 71u);
+        EXPECT_EQ(filter.getAttributeCardinality(5), 72u);
+        // The materialized query sees the new points
+        EXPECT_EQ(filter.getAllowedSlots().cardinality(), 71u);
+        EXPECT_TRUE(filter(13));
+        EXPECT_FALSE(filter(12));
+    }
+
+    std::cout << "Bulk add points test passed\n";
+}
+
 // Add this line to specify the subsystem
 #ifdef _WIN32
 #include <windows.h>
@@ -80,6 +147,8 @@ int main() {
     testMultipleAttributesMatch();
     testAttributeRemoval();
     testAttributeCount();
+    testMaterializedQuery();
+    testBulkAddPoints();
     
     std::cout << "\nAll roaring filter tests passed!\n";
     return 0;
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include "test_common.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 16;
+const size_t num_points = 5000;
+const size_t k = 10;
+
+// Counts its calls and rejections, to check the stats against
+class CountingFilter : public hnswlib::BaseFilterFunctor {
+public:
+    explicit CountingFilter(size_t modulus) : modulus_(modulus) {}
+    bool operator()(hnswlib::labeltype label) override {
+        calls++;
+        bool allowed = label % modulus_ == 0;
+        if (!allowed) rejections++;
+        return allowed;
+    }
+
+    size_t calls = 0;
+    size_t rejections = 0;
+
+private:
+    size_t modulus_;
+};
+
+struct Fixture : WorkloadIndex {
+    Fixture() : WorkloadIndex(pointOptions(dim, num_points, 3), 20, 16, 100) { index.setEf(50); }
+};
+
+TEST(testUnfilteredStats) {
+    Fixture f;
+    hnswlib::SearchStats stats;
+    auto result = f.index.searchKnnWithFilter(f.query(0), k, (hnswlib::BaseFilterFunctor*) nullptr,
+                                              hnswlib::FilterTraversal::ScoreAll, &stats);
+    EXPECT_EQ(result.size(), k);
+    EXPECT_TRUE(stats.hops > 0);
+    EXPECT_TRUE(stats.visited >= 50);
+    // Every visited base-layer node is scored without a filter
+    EXPECT_TRUE(stats.distance_computations > stats.visited);
+    EXPECT_TRUE(stats.heap_pushes >= 50);
+    EXPECT_EQ(stats.filter_rejections, size_t(0));
+    EXPECT_EQ(stats.layer_seconds.size(), size_t(f.index.maxlevel_ + 1));
+    for (double seconds : stats.layer_seconds) EXPECT_TRUE(seconds >= 0.0);
+
+    // Stats do not change the result
+    auto plain = f.index.searchKnn(f.query(0), k);
+    for (; !plain.empty(); plain.pop(), result.pop()) EXPECT_TRUE(plain.top() == result.top());
+
+    // Counts add up until reset
+    hnswlib::SearchStats first = stats;
+    f.index.searchKnnWithFilter(f.query(0), k, (hnswlib::BaseFilterFunctor*) nullptr,
+                                hnswlib::FilterTraversal::ScoreAll, &stats);
+    EXPECT_EQ(stats.distance_computations, 2 * first.distance_computations);
+    stats.reset();
+    EXPECT_EQ(stats.hops, size_t(0));
+    EXPECT_TRUE(stats.layer_seconds.empty());
+
+    std::cout << "Unfiltered stats test passed\n";
+}
+
+TEST(testFilterRejections) {
+    Fixture f;
+    for (auto traversal : {hnswlib::FilterTraversal::ScoreAll, hnswlib::FilterTraversal::TwoHop}) {
+        CountingFilter filter(7);
+        hnswlib::SearchStats stats;
+        auto result = f.index.searchKnnWithFilter(f.query(1), k, &filter, traversal, &stats);
+        EXPECT_EQ(result.size(), k);
+        EXPECT_TRUE(stats.filter_rejections > 0);
+        EXPECT_EQ(stats.filter_rejections, filter.rejections);
+        // Rejected candidates are not scored, so each visited node is checked once
+        if (traversal != hnswlib::FilterTraversal::ScoreAll) {
+            EXPECT_TRUE(filter.calls <= stats.visited);
+        }
+    }
+
+    std::cout << "Filter rejection test passed\n";
+}
+
+TEST(testConcurrentStats) {
+    Fixture f;
+    std::vector<hnswlib::SearchStats> expected(20);
+    for (size_t q = 0; q < 20; q++) {
+        f.index.searchKnnWithFilter(f.query(q), k, (hnswlib::BaseFilterFunctor*) nullptr,
+                                    hnswlib::FilterTraversal::ScoreAll, &expected[q]);
+    }
+
+    // Searches on other threads do not leak into a query's stats
+    std::vector<hnswlib::SearchStats> concurrent(20);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t q = t; q < 20; q += 4) {
+                f.index.searchKnnWithFilter(f.query(q), k, (hnswlib::BaseFilterFunctor*) nullptr,
+                                            hnswlib::FilterTraversal::ScoreAll, &concurrent[q]);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    for (size_t q = 0; q < 20; q++) {
+        EXPECT_EQ(concurrent[q].distance_computations, expected[q].distance_computations);
+        EXPECT_EQ(concurrent[q].hops, expected[q].hops);
+        EXPECT_EQ(concurrent[q].visited, expected[q].visited);
+    }
+
+    std::cout << "Concurrent stats test passed\n";
+}
+
+TEST(testAdaptiveStats) {
+    Fixture f;
+    // Only 5 points pass, so ef keeps doubling up to the index size
+    CountingFilter filter(1000);
+    hnswlib::SearchStats stats;
+    auto result = f.index.searchKnnAdaptive(f.query(2), k, &filter, 0, &stats);
+    EXPECT_EQ(result.size(), size_t(5));
+    EXPECT_TRUE(stats.filter_rejections > 0);
+    EXPECT_EQ(stats.filter_rejections, filter.rejections);
+
+    // The budget only counts this query's computations
+    hnswlib::SearchStats capped;
+    f.index.searchKnnAdaptive(f.query(2), k, &filter, 1, &capped);
+    EXPECT_TRUE(capped.distance_computations < stats.distance_computations);
+
+    std::cout << "Adaptive stats test passed\n";
+}
+
+int main() {
+    std::cout << "Running search stats tests...\n\n";
+
+    testUnfilteredStats();
+    testFilterRejections();
+    testConcurrentStats();
+    testAdaptiveStats();
+
+    std::cout << "\nAll search stats tests passed!\n";
+    return 0;
+}
\ No newline at end of file
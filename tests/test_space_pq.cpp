@@ -0,0 +1,159 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include "../external/hnswlib/hnswlib.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+// Points around a few dozen cluster centers
+std::vector<float> clusteredVectors(size_t dim, size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::mt19937 center_gen(5);
+    std::uniform_real_distribution<float> dis_center(-1.0f, 1.0f);
+    std::normal_distribution<float> dis_offset(0.0f, 0.1f);
+    std::vector<float> centers(32 * dim);
+    for (float& x : centers) x = dis_center(center_gen);
+    std::uniform_int_distribution<size_t> dis_cluster(0, 31);
+    std::vector<float> vectors(dim * count);
+    for (size_t i = 0; i < count; i++) {
+        size_t cluster = dis_cluster(gen);
+        for (size_t j = 0; j < dim; j++) vectors[i * dim + j] = centers[cluster * dim + j] + dis_offset(gen);
+    }
+    return vectors;
+}
+
+TEST(testTrainEncode) {
+    const size_t dim = 32, m = 8, n = 2000;
+    auto vectors = clusteredVectors(dim, n, 1);
+    auto space = hnswlib::PQSpace::train(dim, m, vectors.data(), n);
+    // Tag and codes, padded to whole tableints so level 0 stays aligned
+    EXPECT_EQ(space.get_data_size(), m + sizeof(hnswlib::tableint));
+
+    // Reconstruction error well below the spread of the data
+    std::vector<unsigned char> code(space.get_data_size());
+    std::vector<float> decoded(dim);
+    double error = 0, spread = 0;
+    for (size_t i = 0; i < n; i++) {
+        space.encode(vectors.data() + i * dim, code.data());
+        EXPECT_EQ(code[0], hnswlib::PQ_CODE_TAG);
+        space.decode(code.data(), decoded.data());
+        for (size_t j = 0; j < dim; j++) {
+            error += (decoded[j] - vectors[i * dim + j]) * (decoded[j] - vectors[i * dim + j]);
+            spread += vectors[i * dim + j] * vectors[i * dim + j];
+        }
+    }
+    EXPECT_TRUE(error < 0.05 * spread);
+
+    bool thrown = false;
+    try {
+        hnswlib::PQSpace::train(30, 8, vectors.data(), n);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    std::cout << "Train/encode test passed\n";
+}
+
+TEST(testDistances) {
+    // Below, at and above the SIMD block of subspaces, with residuals
+    for (size_t m : {4, 8, 16, 20, 32}) {
+        const size_t dim = 2 * m, n = 500;
+        auto vectors = clusteredVectors(dim, n, 2);
+        auto space = hnswlib::PQSpace::train(dim, m, vectors.data(), n, 4);
+        auto dist_func = space.get_dist_func();
+        void* param = space.get_dist_func_param();
+        const size_t code_size = space.get_data_size();
+        EXPECT_EQ(code_size % sizeof(hnswlib::tableint), 0u);
+
+        std::vector<unsigned char> codes(n * code_size);
+        for (size_t i = 0; i < n; i++) space.encode(vectors.data() + i * dim, codes.data() + i * code_size);
+        std::vector<float> decoded_a(dim), decoded_b(dim);
+        for (size_t i = 0; i < 20; i++) {
+            auto table = space.makeQuery(vectors.data() + i * dim);
+            space.decode(codes.data() + i * code_size, decoded_a.data());
+            for (size_t j = 0; j < 20; j++) {
+                const unsigned char* code = codes.data() + j * code_size;
+                space.decode(code, decoded_b.data());
+                float to_decoded = 0, between_decoded = 0;
+                for (size_t d = 0; d < dim; d++) {
+                    to_decoded += (vectors[i * dim + d] - decoded_b[d]) * (vectors[i * dim + d] - decoded_b[d]);
+                    between_decoded += (decoded_a[d] - decoded_b[d]) * (decoded_a[d] - decoded_b[d]);
+                }
+                // Asymmetric: query against the decoded point
+                float adc = dist_func(table.data(), code, param);
+                EXPECT_TRUE(std::fabs(adc - to_decoded) <= 1e-4f * (1 + to_decoded));
+                // Symmetric: decoded point against decoded point
+                float sdc = dist_func(codes.data() + i * code_size, code, param);
+                EXPECT_TRUE(std::fabs(sdc - between_decoded) <= 1e-4f * (1 + between_decoded));
+            }
+        }
+    }
+
+    std::cout << "Distance test passed\n";
+}
+
+TEST(testIndexSearch) {
+    const size_t dim = 32, m = 16, n = 3000, k = 10;
+    auto vectors = clusteredVectors(dim, n, 3);
+    auto space = hnswlib::PQSpace::train(dim, m, vectors.data(), n);
+    hnswlib::HierarchicalNSW<float> index(&space, n);
+    std::vector<unsigned char> code(space.get_data_size());
+    for (size_t i = 0; i < n; i++) {
+        space.encode(vectors.data() + i * dim, code.data());
+        index.addPoint(code.data(), i);
+    }
+    index.setEf(100);
+
+    struct EvenLabels : hnswlib::BaseFilterFunctor {
+        bool operator()(hnswlib::labeltype label) override { return label % 2 == 0; }
+    } even;
+
+    hnswlib::L2Space float_space(dim);
+    auto vector_of = [&](hnswlib::labeltype label) { return vectors.data() + label * dim; };
+    size_t found = 0, found_filtered = 0;
+    for (size_t q = 0; q < 30; q++) {
+        const float* query = vectors.data() + q * dim;
+        std::vector<std::pair<float, hnswlib::labeltype>> exact, exact_even;
+        for (size_t i = 0; i < n; i++) {
+            float dist = hnswlib::L2Sqr(query, vectors.data() + i * dim, float_space.get_dist_func_param());
+            exact.emplace_back(dist, i);
+            if (i % 2 == 0) exact_even.emplace_back(dist, i);
+        }
+        std::partial_sort(exact.begin(), exact.begin() + k, exact.end());
+        std::partial_sort(exact_even.begin(), exact_even.begin() + k, exact_even.end());
+
+        auto table = space.makeQuery(query);
+        auto result = hnswlib::rerankL2(index.searchKnn(table.data(), 4 * k), query, dim, k, vector_of);
+        EXPECT_EQ(result.size(), k);
+        for (; !result.empty(); result.pop()) {
+            for (size_t j = 0; j < k; j++) found += exact[j].second == result.top().second;
+        }
+
+        result = hnswlib::rerankL2(index.searchKnnWithFilter(table.data(), 4 * k, &even), query, dim, k, vector_of);
+        EXPECT_EQ(result.size(), k);
+        for (; !result.empty(); result.pop()) {
+            EXPECT_EQ(result.top().second % 2, 0u);
+            for (size_t j = 0; j < k; j++) found_filtered += exact_even[j].second == result.top().second;
+        }
+    }
+    EXPECT_TRUE(found >= 30 * k * 90 / 100);
+    EXPECT_TRUE(found_filtered >= 30 * k * 90 / 100);
+
+    std::cout << "Index search test passed\n";
+}
+
+int main() {
+    std::cout << "Running PQ space tests...\n\n";
+
+    testTrainEncode();
+    testDistances();
+    testIndexSearch();
+
+    std::cout << "\nAll PQ space tests passed!\n";
+    return 0;
+}
\ No newline at end of file
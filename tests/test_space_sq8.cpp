@@ -0,0 +1,129 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include "../external/hnswlib/hnswlib.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+std::vector<float> randomVectors(size_t dim, size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    std::vector<float> vectors(dim * count);
+    for (float& x : vectors) x = dis(gen);
+    return vectors;
+}
+
+TEST(testEncodeDecode) {
+    const size_t dim = 40;
+    auto vectors = randomVectors(dim, 100, 1);
+    auto space = hnswlib::SQ8Space::train(dim, vectors.data(), 100);
+
+    EXPECT_EQ(space.get_data_size(), dim);
+    std::vector<unsigned char> code(dim);
+    std::vector<float> decoded(dim);
+    const float half_step = 2.0f / 255 / 2 + 1e-6f;
+    for (size_t i = 0; i < 100; i++) {
+        space.encode(vectors.data() + i * dim, code.data());
+        space.decode(code.data(), decoded.data());
+        for (size_t j = 0; j < dim; j++) {
+            EXPECT_TRUE(std::fabs(decoded[j] - vectors[i * dim + j]) <= half_step);
+        }
+    }
+
+    // Out of range components are clamped
+    std::vector<float> outlier(dim, 5.0f);
+    space.encode(outlier.data(), code.data());
+    EXPECT_EQ(code[0], 255);
+
+    std::cout << "Encode/decode test passed\n";
+}
+
+TEST(testKernelMatchesScalar) {
+    // Below, at and above the 32-component SIMD block, with residuals
+    for (size_t dim : {7, 32, 45, 128, 131}) {
+        auto vectors = randomVectors(dim, 20, 2);
+        auto space = hnswlib::SQ8Space::train(dim, vectors.data(), 20);
+        // Codes are padded to whole tableints, so level 0 stays aligned
+        const size_t code_size = space.get_data_size();
+        EXPECT_EQ(code_size % sizeof(hnswlib::tableint), 0u);
+        EXPECT_TRUE(code_size >= dim && code_size < dim + sizeof(hnswlib::tableint));
+        std::vector<unsigned char> codes(code_size * 20);
+        for (size_t i = 0; i < 20; i++) space.encode(vectors.data() + i * dim, codes.data() + i * code_size);
+
+        auto dist_func = space.get_dist_func();
+        for (size_t i = 0; i < 20; i++) {
+            for (size_t j = 0; j < 20; j++) {
+                float scalar = hnswlib::SQ8L2Sqr(codes.data() + i * code_size, codes.data() + j * code_size,
+                                                 space.get_dist_func_param());
+                float simd = dist_func(codes.data() + i * code_size, codes.data() + j * code_size,
+                                       space.get_dist_func_param());
+                EXPECT_EQ(scalar, simd);
+
+                // Close to the float distance
+                float exact = 0;
+                for (size_t d = 0; d < dim; d++) {
+                    float t = vectors[i * dim + d] - vectors[j * dim + d];
+                    exact += t * t;
+                }
+                EXPECT_TRUE(std::fabs(simd - exact) <= 0.04f * dim);
+            }
+        }
+    }
+
+    std::cout << "Kernel test passed\n";
+}
+
+TEST(testQuantizedIndexWithRerank) {
+    const size_t dim = 64, num_points = 3000, k = 10;
+    auto vectors = randomVectors(dim, num_points, 3);
+    auto space = hnswlib::SQ8Space::train(dim, vectors.data(), num_points);
+    hnswlib::HierarchicalNSW<float> index(&space, num_points);
+    std::vector<unsigned char> code(dim);
+    for (size_t i = 0; i < num_points; i++) {
+        space.encode(vectors.data() + i * dim, code.data());
+        index.addPoint(code.data(), i);
+    }
+    EXPECT_EQ(index.data_size_, dim);
+    index.setEf(100);
+
+    hnswlib::L2Space float_space(dim);
+    size_t found = 0;
+    for (size_t q = 0; q < 30; q++) {
+        const float* query = vectors.data() + q * dim;
+        std::vector<std::pair<float, hnswlib::labeltype>> exact;
+        for (size_t i = 0; i < num_points; i++) {
+            exact.emplace_back(hnswlib::L2Sqr(query, vectors.data() + i * dim, float_space.get_dist_func_param()), i);
+        }
+        std::partial_sort(exact.begin(), exact.begin() + k, exact.end());
+
+        space.encode(query, code.data());
+        auto result = hnswlib::rerankL2(index.searchKnn(code.data(), 4 * k), query, dim, k,
+                                        [&](hnswlib::labeltype label) { return vectors.data() + label * dim; });
+        EXPECT_EQ(result.size(), k);
+        // Re-ranked distances are exact, up to the SIMD summation order
+        EXPECT_TRUE(result.top().first >= exact[k - 1].first * (1 - 1e-5f));
+        for (; !result.empty(); result.pop()) {
+            for (size_t j = 0; j < k; j++) {
+                if (exact[j].second == result.top().second) found++;
+            }
+        }
+    }
+    EXPECT_TRUE(found >= 30 * k * 95 / 100);
+
+    std::cout << "Quantized index test passed\n";
+}
+
+int main() {
+    std::cout << "Running SQ8 space tests...\n\n";
+
+    testEncodeDecode();
+    testKernelMatchesScalar();
+    testQuantizedIndexWithRerank();
+
+    std::cout << "\nAll SQ8 space tests passed!\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include "test_common.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+const size_t dim = 16;
+const size_t num_points = 5000;
+const size_t k = 10;
+
+TEST(testHashSet) {
+    hnswlib::VisitedHashSet set;
+    EXPECT_FALSE(set.contains(7));
+    EXPECT_TRUE(set.insert(7));
+    EXPECT_FALSE(set.insert(7));
+    EXPECT_TRUE(set.contains(7));
+
+    // Well past the first capacity, with ids that only differ in high bits
+    set.reset(10);
+    for (unsigned int i = 0; i < 5000; i++) EXPECT_TRUE(set.insert(i << 16));
+    EXPECT_EQ(set.size(), size_t(5000));
+    for (unsigned int i = 0; i < 5000; i++) EXPECT_TRUE(set.contains(i << 16));
+    EXPECT_FALSE(set.contains(1));
+
+    set.reset(10);
+    EXPECT_EQ(set.size(), size_t(0));
+    EXPECT_FALSE(set.contains(0));
+
+    // A thread reuses its cached set; a nested lease gets another, a given set is lent as is
+    hnswlib::VisitedHashSet* cached;
+    {
+        hnswlib::VisitedHashSetLease lease;
+        cached = &lease.set();
+        hnswlib::VisitedHashSetLease nested;
+        EXPECT_TRUE(&nested.set() != cached);
+        hnswlib::VisitedHashSetLease given(&set);
+        EXPECT_TRUE(&given.set() == &set);
+    }
+    {
+        hnswlib::VisitedHashSetLease again;
+        EXPECT_TRUE(&again.set() == cached);
+        std::thread([&]() {
+            hnswlib::VisitedHashSetLease other;
+            EXPECT_TRUE(&other.set() != cached);
+        }).join();
+    }
+
+    std::cout << "Hash set test passed\n";
+}
+
+TEST(testThreadCachedLists) {
+    hnswlib::VisitedListPool pool(1, 1000);
+    // A thread gets back the list it released, without going through the pool
+    hnswlib::VisitedList* first = pool.getFreeVisitedList();
+    pool.releaseVisitedList(first);
+    EXPECT_TRUE(pool.getFreeVisitedList() == first);
+
+    // Nested use on one thread gets distinct lists
+    hnswlib::VisitedList* second = pool.getFreeVisitedList();
+    EXPECT_TRUE(second != first);
+    pool.releaseVisitedList(second);
+    pool.releaseVisitedList(first);
+
+    // Another pool never sees this pool's lists
+    hnswlib::VisitedListPool other(0, 1000);
+    hnswlib::VisitedList* foreign = other.getFreeVisitedList();
+    EXPECT_TRUE(foreign != first && foreign != second);
+    other.releaseVisitedList(foreign);
+
+    // Lists cached by a thread return to their pool when it exits
+    hnswlib::VisitedList* from_thread = nullptr;
+    std::thread([&]() {
+        from_thread = pool.getFreeVisitedList();
+        pool.releaseVisitedList(from_thread);
+    }).join();
+    std::thread([&]() {
+        hnswlib::VisitedList* reused = pool.getFreeVisitedList();
+        EXPECT_TRUE(reused == from_thread || reused == first || reused == second);
+        pool.releaseVisitedList(reused);
+    }).join();
+
+    // A pool may go away while threads still cache its lists
+    {
+        hnswlib::VisitedListPool short_lived(0, 1000);
+        short_lived.releaseVisitedList(short_lived.getFreeVisitedList());
+    }
+    hnswlib::VisitedListPool after(0, 1000);
+    after.releaseVisitedList(after.getFreeVisitedList());
+
+    // A dead pool's lists are freed on the thread's next access, even a cache hit
+    std::thread([&]() {
+        after.releaseVisitedList(after.getFreeVisitedList());
+        {
+            hnswlib::VisitedListPool rebuilt(0, 1000);
+            rebuilt.releaseVisitedList(rebuilt.getFreeVisitedList());
+        }
+        EXPECT_EQ(hnswlib::VisitedListPool::threadCachedLists(), 2);
+        hnswlib::VisitedList* hit = after.getFreeVisitedList();
+        EXPECT_EQ(hnswlib::VisitedListPool::threadCachedLists(), 0);
+        after.releaseVisitedList(hit);
+    }).join();
+
+    std::cout << "Thread cached list test passed\n";
+}
+
+TEST(testCompactSearch) {
+    WorkloadIndex f(pointOptions(dim, num_points, 9), 50, 16, 100);
+    f.index.setEf(50);
+
+    ModuloFilter filter(3);
+    std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>> dense, dense_filtered;
+    f.index.setVisitedSetMode(hnswlib::VisitedSetMode::Dense);
+    for (const void* query : f.query_ptrs) {
+        dense.push_back(f.index.searchKnn(query, k));
+        dense_filtered.push_back(f.index.searchKnn(query, k, &filter));
+    }
+
+    // Same results with the hash set, single and batched
+    f.index.setVisitedSetMode(hnswlib::VisitedSetMode::Compact);
+    auto batch = f.index.searchKnnBatch(f.query_ptrs, k, {}, 2);
+    for (size_t q = 0; q < f.query_ptrs.size(); q++) {
+        EXPECT_TRUE(sameResult(f.index.searchKnn(f.query_ptrs[q], k), dense[q]));
+        EXPECT_TRUE(sameResult(f.index.searchKnn(f.query_ptrs[q], k, &filter), dense_filtered[q]));
+        EXPECT_TRUE(sameResult(batch[q], dense[q]));
+    }
+    hnswlib::SearchStats stats;
+    f.index.searchKnnWithFilter(f.query_ptrs[0], k, (hnswlib::BaseFilterFunctor*) nullptr,
+                                hnswlib::FilterTraversal::ScoreAll, &stats);
+    EXPECT_TRUE(stats.visited >= 50);
+
+    // Auto only picks the hash set for unfiltered searches on a sliver of a large index
+    f.index.setVisitedSetMode(hnswlib::VisitedSetMode::Auto);
+    EXPECT_FALSE(f.index.useCompactVisitedSet(2, false));
+    hnswlib::HierarchicalNSW<float> large(&f.space, 1 << 20, 16, 100);
+    EXPECT_TRUE(large.useCompactVisitedSet(50, false));
+    EXPECT_FALSE(large.useCompactVisitedSet(50, true));
+    EXPECT_FALSE(large.useCompactVisitedSet(5000, false));
+
+    // Searches still work once resizeIndex replaced the cached lists' pool
+    f.index.resizeIndex(num_points * 2);
+    EXPECT_TRUE(sameResult(f.index.searchKnn(f.query_ptrs[0], k), dense[0]));
+
+    std::cout << "Compact search test passed\n";
+}
+
+int main() {
+    std::cout << "Running visited set tests...\n\n";
+
+    testHashSet();
+    testThreadCachedLists();
+    testCompactSearch();
+
+    std::cout << "\nAll visited set tests passed!\n";
+    return 0;
+}
\ No newline at end of file
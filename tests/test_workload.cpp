@@ -0,0 +1,168 @@
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include "../src/core/workload.h"
+#include "../src/core/roaring_filter.h"
+
+#define TEST(name) void name()
+#define EXPECT_TRUE(x) do { if (!(x)) { std::cout << "Test failed: " #x << std::endl; assert(x); } } while(0)
+#define EXPECT_FALSE(x) EXPECT_TRUE(!(x))
+#define EXPECT_EQ(a, b) do { if ((a) != (b)) { std::cout << "Test failed: " #a " == " #b << std::endl; assert((a) == (b)); } } while(0)
+
+filtering::WorkloadOptions smallOptions() {
+    filtering::WorkloadOptions options;
+    options.dim = 8;
+    options.num_points = 5000;
+    options.num_clusters = 10;
+    options.num_attributes = 200;
+    options.attributes_per_point = 3;
+    return options;
+}
+
+float squaredDistance(const float* a, const float* b, size_t dim) {
+    float dist = 0.0f;
+    for (size_t j = 0; j < dim; j++) dist += (a[j] - b[j]) * (a[j] - b[j]);
+    return dist;
+}
+
+TEST(testPoints) {
+    filtering::Workload workload(smallOptions());
+    EXPECT_EQ(workload.size(), size_t(5000));
+    EXPECT_EQ(workload.vectors().size(), size_t(5000 * 8));
+    for (size_t i = 0; i < workload.size(); i++) {
+        auto attributes = workload.attributes(i);
+        EXPECT_EQ(attributes.size(), size_t(3));
+        EXPECT_TRUE(std::is_sorted(attributes.begin(), attributes.end()));
+        EXPECT_TRUE(std::adjacent_find(attributes.begin(), attributes.end()) == attributes.end());
+        EXPECT_TRUE(workload.hasAttributes(i, attributes));
+    }
+
+    // Same seed, same workload
+    filtering::Workload again(smallOptions());
+    EXPECT_TRUE(again.vectors() == workload.vectors());
+    EXPECT_TRUE(again.attributes(123) == workload.attributes(123));
+
+    // Zipfian popularity: the head attributes dominate the tail
+    EXPECT_TRUE(workload.selectivity(0) > 10 * workload.selectivity(199));
+
+    // Fully correlated attributes are all homed at the point's cluster
+    auto options = smallOptions();
+    options.cluster_correlation = 1.0;
+    filtering::Workload correlated(options);
+    for (size_t i = 0; i < correlated.size(); i++) {
+        for (unsigned int attr : correlated.attributes(i)) {
+            EXPECT_EQ(attr % options.num_clusters, correlated.clusterOf(i));
+        }
+    }
+
+    std::cout << "Points test passed\n";
+}
+
+TEST(testAttributeBatch) {
+    filtering::Workload workload(smallOptions());
+    filtering::RoaringFilter filter;
+    filter.addPoints(workload.attributeBatch(0, 1000));
+    filter.addPoints(workload.attributeBatch(1000));
+    for (size_t i : {size_t(0), size_t(999), size_t(1000), size_t(4999)}) {
+        for (unsigned int attr : workload.attributes(i)) EXPECT_TRUE(filter.hasAttribute(i, attr));
+    }
+    EXPECT_EQ(workload.attributeBatch(4990, 6000).num_points, size_t(10));
+
+    std::cout << "Attribute batch test passed\n";
+}
+
+TEST(testQueryMix) {
+    filtering::Workload workload(smallOptions());
+    std::vector<filtering::QueryClass> mix(3);
+    mix[0].min_selectivity = 0.01;
+    mix[0].max_selectivity = 0.05;
+    mix[0].locality = filtering::QueryLocality::Correlated;
+    mix[1].min_selectivity = 0.01;
+    mix[1].max_selectivity = 0.05;
+    mix[1].locality = filtering::QueryLocality::AntiCorrelated;
+    mix[2].num_attributes = 0;
+    mix[2].weight = 0.5;
+
+    auto queries = workload.generateQueries(mix, 200);
+    EXPECT_EQ(queries.size(), size_t(200));
+    size_t unfiltered = 0;
+    double near_correlated = 0, near_anti = 0;
+    size_t num_correlated = 0, num_anti = 0;
+    for (const auto& query : queries) {
+        EXPECT_EQ(query.vector.size(), size_t(8));
+        if (query.attributes.empty()) {
+            unfiltered++;
+            EXPECT_EQ(query.selectivity, 1.0);
+            continue;
+        }
+        double s = workload.selectivity(query.attributes[0]);
+        EXPECT_TRUE(s >= 0.01 && s <= 0.05);
+        EXPECT_EQ(query.selectivity, s);
+
+        // Distance from the query to its nearest match
+        auto nearest = workload.exactKnn(query.vector.data(), query.attributes, 1);
+        EXPECT_EQ(nearest.size(), size_t(1));
+        double dist = squaredDistance(query.vector.data(), workload.vector(nearest[0]), 8);
+        if (query.locality == filtering::QueryLocality::Correlated) {
+            near_correlated += dist;
+            num_correlated++;
+        } else {
+            near_anti += dist;
+            num_anti++;
+        }
+    }
+    EXPECT_TRUE(unfiltered > 0 && num_correlated > 0 && num_anti > 0);
+    // Anti-correlated queries have their matches much further away
+    EXPECT_TRUE(near_anti / num_anti > 4 * (near_correlated / num_correlated));
+
+    // Conjunctions stay satisfiable
+    std::vector<filtering::QueryClass> pairs(1);
+    pairs[0].num_attributes = 2;
+    pairs[0].min_selectivity = 0.05;
+    for (const auto& query : workload.generateQueries(pairs, 50)) {
+        EXPECT_EQ(query.attributes.size(), size_t(2));
+        EXPECT_TRUE(query.selectivity > 0.0);
+        EXPECT_TRUE(query.selectivity <= workload.selectivity(query.attributes[0]));
+    }
+
+    bool thrown = false;
+    std::vector<filtering::QueryClass> impossible(1);
+    impossible[0].min_selectivity = 0.99;
+    try {
+        workload.generateQueries(impossible, 1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    std::cout << "Query mix test passed\n";
+}
+
+TEST(testExactKnn) {
+    filtering::Workload workload(smallOptions());
+    const float* query = workload.vector(42);
+    // The point's most popular attribute, so that there are k matches
+    std::vector<unsigned int> attributes{workload.attributes(42)[0]};
+    auto nearest = workload.exactKnn(query, attributes, 10);
+    EXPECT_EQ(nearest.size(), size_t(10));
+    EXPECT_EQ(nearest[0], hnswlib::labeltype(42));
+    for (size_t i = 1; i < nearest.size(); i++) {
+        EXPECT_TRUE(workload.hasAttributes(nearest[i], attributes));
+        EXPECT_TRUE(squaredDistance(query, workload.vector(nearest[i - 1]), 8) <=
+                    squaredDistance(query, workload.vector(nearest[i]), 8));
+    }
+
+    std::cout << "Exact k-NN test passed\n";
+}
+
+int main() {
+    std::cout << "Running workload generator tests...\n\n";
+
+    testPoints();
+    testAttributeBatch();
+    testQueryMix();
+    testExactKnn();
+
+    std::cout << "\nAll workload generator tests passed!\n";
+    return 0;
+}
\ No newline at end of file